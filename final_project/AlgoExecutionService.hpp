@@ -24,34 +24,40 @@ class AlgoExecution
 public:
     // Constructors
     AlgoExecution() = default;
-    AlgoExecution(const T& prod, PricingSide ps, std::string oid,
-                  OrderType ot, double pr, long visQty, long hidQty,
-                  std::string parentOid, bool childFlag);
+    AlgoExecution(const T& prod, PricingSide ps, std::string_view oid,
+                  OrderType ot, Tick256 pr, long visQty, long hidQty,
+                  std::string_view parentOid, bool childFlag);
 
     // Retrieve the associated ExecutionOrder
-    ExecutionOrder<T>* GetExecutionOrder() const;
+    ExecutionOrder<T>* GetExecutionOrder();
+    const ExecutionOrder<T>* GetExecutionOrder() const;
 
 private:
-    ExecutionOrder<T>* executionOrder;
+    // Held inline, so building or copying an AlgoExecution never allocates
+    ExecutionOrder<T> executionOrder;
 };
 
 // -------------------- Implementation of AlgoExecution<T> --------------------
 
 template <typename T>
 AlgoExecution<T>::AlgoExecution(const T& prod, PricingSide ps,
-                                std::string oid, OrderType ot,
-                                double pr, long visQty, long hidQty,
-                                std::string parentOid, bool childFlag)
+                                std::string_view oid, OrderType ot,
+                                Tick256 pr, long visQty, long hidQty,
+                                std::string_view parentOid, bool childFlag)
+    : executionOrder(prod, ps, oid, ot, pr, visQty, hidQty, parentOid, childFlag)
 {
-    executionOrder = new ExecutionOrder<T>(
-        prod, ps, oid, ot, pr, visQty, hidQty, parentOid, childFlag
-    );
 }
 
 template <typename T>
-ExecutionOrder<T>* AlgoExecution<T>::GetExecutionOrder() const
+ExecutionOrder<T>* AlgoExecution<T>::GetExecutionOrder()
+{
+    return &executionOrder;
+}
+
+template <typename T>
+const ExecutionOrder<T>* AlgoExecution<T>::GetExecutionOrder() const
 {
-    return executionOrder;
+    return &executionOrder;
 }
 
 // ---------------------------------------------------------------------------
@@ -90,11 +96,23 @@ public:
     // Perform an algo-based trade given an OrderBook
     void AlgoExecutionTrade(OrderBook<T>& orderBookObj);
 
+    // Perform an algo-based trade if the top of book has changed
+    void AlgoExecutionTrade(TopOfBook<T>& topOfBook);
+
+    // As above, passing any execution to sink(AlgoExecution<T>&) instead of the listeners
+    template <typename Sink>
+    void AlgoExecutionTrade(TopOfBook<T>& topOfBook, Sink&& sink);
+
+    // Prefix of the numbered order IDs ("AlgoExec" by default), so several
+    // services can hand out IDs that never collide
+    void SetOrderIdPrefix(std::string_view prefix);
+
 private:
-    std::map<std::string, AlgoExecution<T>> algoExecutions;
+    ProductStore<AlgoExecution<T>> algoExecutions;
     std::vector<ServiceListener<AlgoExecution<T>>*> listeners;
     AlgoExecutionServiceListener<T>* listener;
     long executionCount;
+    std::string orderIdPrefix;
 };
 
 // -------------------- Implementation of AlgoExecutionService<T> --------------------
@@ -102,10 +120,11 @@ private:
 template <typename T>
 AlgoExecutionService<T>::AlgoExecutionService()
 {
-    algoExecutions = std::map<std::string, AlgoExecution<T>>();
+    algoExecutions = ProductStore<AlgoExecution<T>>();
     listeners      = std::vector<ServiceListener<AlgoExecution<T>>*>();
     listener       = new AlgoExecutionServiceListener<T>(this);
     executionCount = 0;
+    orderIdPrefix  = "AlgoExec";
 }
 
 template <typename T>
@@ -117,15 +136,15 @@ AlgoExecutionService<T>::~AlgoExecutionService()
 template <typename T>
 AlgoExecution<T>& AlgoExecutionService<T>::GetData(std::string key)
 {
-    return algoExecutions[key];
+    return algoExecutions.Get(key);
 }
 
 template <typename T>
 void AlgoExecutionService<T>::OnMessage(AlgoExecution<T>& dataObj)
 {
     // Store or update the algo execution keyed by the product's ID
-    std::string prodId = dataObj.GetExecutionOrder()->GetProduct().GetProductId();
-    algoExecutions[prodId] = dataObj;
+    ProductIndex prodIndex = dataObj.GetExecutionOrder()->GetProduct().GetProductIndex();
+    algoExecutions[prodIndex] = dataObj;
 }
 
 template <typename T>
@@ -147,89 +166,99 @@ AlgoExecutionServiceListener<T>* AlgoExecutionService<T>::GetListener()
     return listener;
 }
 
+template <typename T>
+void AlgoExecutionService<T>::SetOrderIdPrefix(std::string_view prefix)
+{
+    orderIdPrefix = std::string(prefix);
+}
+
 /**
  * AlgoExecutionTrade
- * Only trades if the spread <= 1/128 to reduce cost of crossing the spread.
+ * Only trades if the spread <= 1/128 to reduce cost of crossing the spread,
+ * and only when the inside market has moved since the last book.
  * Chooses bid or offer side based on executionCount parity, then updates algoExec.
  */
 template <typename T>
 void AlgoExecutionService<T>::AlgoExecutionTrade(OrderBook<T>& orderBookObj)
 {
-    // Retrieve product ID
-    std::string prodId = orderBookObj.GetProduct().GetProductId();
+    // A whole book is always treated as new
+    TopOfBook<T> topOfBook(orderBookObj);
+    AlgoExecutionTrade(topOfBook);
+}
+
+template <typename T>
+void AlgoExecutionService<T>::AlgoExecutionTrade(TopOfBook<T>& topOfBook)
+{
+    // Notify all service listeners
+    AlgoExecutionTrade(topOfBook, ListenerSink<AlgoExecution<T>>(listeners));
+}
+
+template <typename T>
+template <typename Sink>
+void AlgoExecutionService<T>::AlgoExecutionTrade(TopOfBook<T>& topOfBook, Sink&& sink)
+{
+    // Nothing to do until the best bid or offer moves
+    if (!topOfBook.IsChanged()) return;
 
-    // Extract best bid and offer
-    Order bestBid   = orderBookObj.GetBidOffer().GetBidOrder();
-    Order bestOffer = orderBookObj.GetBidOffer().GetOfferOrder();
+    // Evaluate if spread <= 1/128, i.e. 2 ticks of 1/256
+    if (topOfBook.GetOfferPrice() - topOfBook.GetBidPrice() > Tick256(2)) return;
 
-    double bidPrice   = bestBid.GetPrice();
-    long   bidQty     = bestBid.GetQuantity();
-    double offerPrice = bestOffer.GetPrice();
-    long   offerQty   = bestOffer.GetQuantity();
+    Tick256 chosenPrice;
+    long chosenQty;
+    PricingSide chosenSide;
 
-    // Evaluate if spread <= 1/128
-    if ((offerPrice - bidPrice) <= 1.0 / 128.0)
+    if (executionCount % 2 == 1)
+    {
+        // Use bid side
+        chosenPrice = topOfBook.GetBidPrice();
+        chosenQty   = topOfBook.GetBidQuantity();
+        chosenSide  = BID;
+    }
+    else
     {
-        double chosenPrice;
-        long chosenQty;
-        PricingSide chosenSide;
-
-        if (executionCount % 2 == 1)
-        {
-            // Use bid side
-            chosenPrice = bidPrice;
-            chosenQty   = bidQty;
-            chosenSide  = BID;
-        }
-        else
-        {
-            // Use offer side
-            chosenPrice = offerPrice;
-            chosenQty   = offerQty;
-            chosenSide  = OFFER;
-        }
-        executionCount++;
-
-        // Construct the AlgoExecution
-        std::string oid = "AlgoExec" + std::to_string(executionCount);
-        AlgoExecution<T> algoExec(
-            orderBookObj.GetProduct(),
-            chosenSide,
-            oid,
-            MARKET,
-            chosenPrice,
-            chosenQty,
-            0,
-            "PARENT_ORDER_ID",
-            false
-        );
-        algoExecutions[prodId] = algoExec;
-
-        // Notify all service listeners
-        for (auto& ls : listeners)
-        {
-            ls->ProcessAdd(algoExec);
-        }
+        // Use offer side
+        chosenPrice = topOfBook.GetOfferPrice();
+        chosenQty   = topOfBook.GetOfferQuantity();
+        chosenSide  = OFFER;
     }
+    executionCount++;
+
+    // Construct the AlgoExecution
+    const T& productRef = topOfBook.GetProduct();
+    OrderId oid = MakeNumberedId<24>(orderIdPrefix, executionCount);
+    AlgoExecution<T> algoExec(
+        productRef,
+        chosenSide,
+        oid.View(),
+        MARKET,
+        chosenPrice,
+        chosenQty,
+        0,
+        "PARENT_ORDER_ID",
+        false
+    );
+    algoExecutions[productRef.GetProductIndex()] = algoExec;
+
+    sink(algoExec);
 }
 
 // ---------------------------------------------------------------------------
 // CLASS: AlgoExecutionServiceListener<T>
 /**
  * AlgoExecutionServiceListener
- * Receives OrderBook<T> from BondMarketDataService and triggers algo trades.
+ * Receives TopOfBook<T> events from BondMarketDataService and triggers algo trades.
  */
 template <typename T>
-class AlgoExecutionServiceListener : public ServiceListener<OrderBook<T>>
+class AlgoExecutionServiceListener : public ServiceListener<TopOfBook<T>>
 {
 public:
     // Constructor
     explicit AlgoExecutionServiceListener(AlgoExecutionService<T>* svc);
 
     // Listener callbacks
-    void ProcessAdd(OrderBook<T>& bookData) override;
-    void ProcessRemove(OrderBook<T>& bookData) override;
-    void ProcessUpdate(OrderBook<T>& bookData) override;
+    void ProcessAdd(TopOfBook<T>& topOfBook) override;
+    void ProcessRemove(TopOfBook<T>& topOfBook) override;
+    void ProcessUpdate(TopOfBook<T>& topOfBook) override;
 
 private:
     AlgoExecutionService<T>* service;
@@ -244,20 +273,20 @@ AlgoExecutionServiceListener<T>::AlgoExecutionServiceListener(AlgoExecutionServi
 }
 
 template <typename T>
-void AlgoExecutionServiceListener<T>::ProcessAdd(OrderBook<T>& bookData)
+void AlgoExecutionServiceListener<T>::ProcessAdd(TopOfBook<T>& topOfBook)
 {
     // Execute trade logic
-    service->AlgoExecutionTrade(bookData);
+    service->AlgoExecutionTrade(topOfBook);
 }
 
 template <typename T>
-void AlgoExecutionServiceListener<T>::ProcessRemove(OrderBook<T>& /*bookData*/)
+void AlgoExecutionServiceListener<T>::ProcessRemove(TopOfBook<T>& /*topOfBook*/)
 {
     // Not implemented
 }
 
 template <typename T>
-void AlgoExecutionServiceListener<T>::ProcessUpdate(OrderBook<T>& /*bookData*/)
+void AlgoExecutionServiceListener<T>::ProcessUpdate(TopOfBook<T>& /*topOfBook*/)
 {
     // Not implemented
 }
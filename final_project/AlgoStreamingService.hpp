@@ -26,24 +26,41 @@ public:
     AlgoStream(const T& prod, const PriceStreamOrder& bidOrd, const PriceStreamOrder& offerOrd);
 
     // Retrieve the underlying PriceStream
-    PriceStream<T>* GetPriceStream() const;
+    PriceStream<T>* GetPriceStream();
+    const PriceStream<T>* GetPriceStream() const;
+
+    // The product of the underlying PriceStream
+    const T& GetProduct() const;
 
 private:
-    PriceStream<T>* priceStream;
+    // Held inline, so building or copying an AlgoStream never allocates
+    PriceStream<T> priceStream;
 };
 
 // -------------------- Implementation of AlgoStream<T> --------------------
 
 template<typename T>
 AlgoStream<T>::AlgoStream(const T& prod, const PriceStreamOrder& bidOrd, const PriceStreamOrder& offerOrd)
+    : priceStream(prod, bidOrd, offerOrd)
+{
+}
+
+template<typename T>
+PriceStream<T>* AlgoStream<T>::GetPriceStream()
+{
+    return &priceStream;
+}
+
+template<typename T>
+const PriceStream<T>* AlgoStream<T>::GetPriceStream() const
 {
-    priceStream = new PriceStream<T>(prod, bidOrd, offerOrd);
+    return &priceStream;
 }
 
 template<typename T>
-PriceStream<T>* AlgoStream<T>::GetPriceStream() const
+const T& AlgoStream<T>::GetProduct() const
 {
-    return priceStream;
+    return priceStream.GetProduct();
 }
 
 // ---------------------------------------------------------------------------
@@ -82,11 +99,19 @@ public:
     // Publish a two-way price based on the input Price<T>
     void AlgoPublishPrice(Price<T>& priceObj);
 
+    // As above, passing the AlgoStream to sink(AlgoStream<T>&) instead of the listeners
+    template <typename Sink>
+    void AlgoPublishPrice(Price<T>& priceObj, Sink&& sink);
+
+    // Publish a batch of prices, notifying each listener once with all the AlgoStreams
+    void AlgoPublishPriceBatch(Span<Price<T>> priceBatch);
+
 private:
-    std::map<std::string, AlgoStream<T>> algoStreams;
+    ProductStore<AlgoStream<T>> algoStreams;
     std::vector<ServiceListener<AlgoStream<T>>*> listeners;
     ServiceListener<Price<T>>* listener;
     long pricePublishCount;
+    std::vector<AlgoStream<T>> publishBatch;
 };
 
 // -------------------- Implementation of AlgoStreamingService<T> --------------------
@@ -94,7 +119,7 @@ private:
 template<typename T>
 AlgoStreamingService<T>::AlgoStreamingService()
 {
-    algoStreams       = std::map<std::string, AlgoStream<T>>();
+    algoStreams       = ProductStore<AlgoStream<T>>();
     listeners         = std::vector<ServiceListener<AlgoStream<T>>*>();
     listener          = new AlgoStreamingServiceListener<T>(this);
     pricePublishCount = 0;
@@ -109,15 +134,15 @@ AlgoStreamingService<T>::~AlgoStreamingService()
 template<typename T>
 AlgoStream<T>& AlgoStreamingService<T>::GetData(std::string key)
 {
-    return algoStreams[key];
+    return algoStreams.Get(key);
 }
 
 template<typename T>
 void AlgoStreamingService<T>::OnMessage(AlgoStream<T>& dataObj)
 {
     // Update or store the AlgoStream keyed by the product ID
-    std::string prodId = dataObj.GetPriceStream()->GetProduct().GetProductId();
-    algoStreams[prodId] = dataObj;
+    ProductIndex prodIndex = dataObj.GetPriceStream()->GetProduct().GetProductIndex();
+    algoStreams[prodIndex] = dataObj;
 }
 
 template<typename T>
@@ -147,16 +172,21 @@ ServiceListener<Price<T>>* AlgoStreamingService<T>::GetListener()
 template<typename T>
 void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& priceObj)
 {
-    // Extract product
-    T productRef  = priceObj.GetProduct();
-    std::string prodId = productRef.GetProductId();
+    // Notify all listeners with new AlgoStream
+    AlgoPublishPrice(priceObj, ListenerSink<AlgoStream<T>>(listeners));
+}
 
-    double midVal    = priceObj.GetMid();
-    double spreadVal = priceObj.GetBidOfferSpread();
+template<typename T>
+template<typename Sink>
+void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& priceObj, Sink&& sink)
+{
+    // Extract product
+    const T& productRef = priceObj.GetProduct();
+    ProductIndex prodIndex = productRef.GetProductIndex();
 
-    // Calculate bid & offer
-    double bidVal   = midVal - spreadVal / 2.0;
-    double offerVal = midVal + spreadVal / 2.0;
+    // Quote the priced bid & offer
+    Tick256 bidVal   = priceObj.GetBid();
+    Tick256 offerVal = priceObj.GetOffer();
 
     // Alternate visible/hide quantities
     long visQty = (pricePublishCount % 2 + 1) * 1000000;
@@ -170,13 +200,22 @@ void AlgoStreamingService<T>::AlgoPublishPrice(Price<T>& priceObj)
 
     // Build AlgoStream
     AlgoStream<T> algoStr(productRef, bidOrd, offerOrd);
-    algoStreams[prodId] = algoStr;
+    algoStreams[prodIndex] = algoStr;
 
-    // Notify all listeners with new AlgoStream
-    for (auto& ls : listeners)
+    sink(algoStr);
+}
+
+template<typename T>
+void AlgoStreamingService<T>::AlgoPublishPriceBatch(Span<Price<T>> priceBatch)
+{
+    // Build every AlgoStream first, reusing the batch buffer
+    publishBatch.clear();
+    for (Price<T>& priceObj : priceBatch)
     {
-        ls->ProcessAdd(algoStr);
+        AlgoPublishPrice(priceObj, [this](AlgoStream<T>& algoStr) { publishBatch.push_back(algoStr); });
     }
+
+    for (auto* ls : listeners) ls->ProcessAddBatch(Span<AlgoStream<T>>(publishBatch));
 }
 
 /**
@@ -194,6 +233,7 @@ public:
     void ProcessAdd(Price<T>& dataObj) override;
     void ProcessRemove(Price<T>& dataObj) override;
     void ProcessUpdate(Price<T>& dataObj) override;
+    void ProcessAddBatch(Span<Price<T>> batch) override;
 
 private:
     AlgoStreamingService<T>* service;
@@ -214,6 +254,12 @@ void AlgoStreamingServiceListener<T>::ProcessAdd(Price<T>& dataObj)
     service->AlgoPublishPrice(dataObj);
 }
 
+template<typename T>
+void AlgoStreamingServiceListener<T>::ProcessAddBatch(Span<Price<T>> batch)
+{
+    service->AlgoPublishPriceBatch(batch);
+}
+
 template<typename T>
 void AlgoStreamingServiceListener<T>::ProcessRemove(Price<T>& /*dataObj*/)
 {
@@ -0,0 +1,384 @@
+//
+//  PipelineBenchmark.cpp
+//  TradingSystem
+//
+//  End-to-end benchmark of the main.cpp service topology. The four input
+//  feeds are generated in memory with the DataGenerator functions and then
+//  pushed line by line through the connectors, so no input file is read.
+//  For each feed it reports lines/sec and the per-line latency; for each hop
+//  (a service publishing to its listeners, or a historical sink finishing)
+//  it reports the latency since the feed line that caused it was read.
+//
+//  Build from final_project/:
+//    g++ -std=c++17 -O2 -I. Benchmark/PipelineBenchmark.cpp -o pipeline_benchmark -pthread
+//
+//  Run from a scratch directory, since the historical services and the GUI
+//  append to ./Data/Output (created if missing):
+//    ./pipeline_benchmark [DATASIZE] [--sync] [--batch N] [--seed N]
+//
+//  --sync persists on the listener thread instead of the background writers.
+//  --batch N hands prices and trades to their services N at a time
+//  (OnMessageBatch); per-line latency then falls mostly on the line that
+//  completes each batch. --seed picks the generated inputs (default 1), so
+//  repeated runs push identical feeds. The allocation columns count heap
+//  allocations on the feed thread; in async mode that excludes the writer
+//  threads formatting records.
+//
+//  @author Zixiuji Wang
+//
+
+#include "AlgoExecutionService.hpp"
+#include "AlgoStreamingService.hpp"
+#include "DataGenerator.hpp"
+#include "GUIservice.hpp"
+#include "executionservice.hpp"
+#include "historicaldataservice.hpp"
+#include "inquiryservice.hpp"
+#include "latencyhistogram.hpp"
+#include "marketdataservice.hpp"
+#include "positionservice.hpp"
+#include "pricingservice.hpp"
+#include "products.hpp"
+#include "riskservice.hpp"
+#include "soa.hpp"
+#include "streamingservice.hpp"
+#include "tradebookingservice.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using BenchClock = std::chrono::steady_clock;
+
+// Heap allocations made by the calling thread, counted by the global
+// allocation functions below; background writer threads keep their own
+// count. Every form is replaced, so each block is released by the
+// deallocation function matching the one that allocated it. The malloc and
+// free calls stay out of line: inlined into a new/delete pair, they would
+// look mismatched to -Wmismatched-new-delete.
+thread_local uint64_t threadAllocations = 0;
+
+__attribute__((noinline)) void* CountedAllocate(std::size_t size, std::size_t alignment) {
+    ++threadAllocations;
+    if (size == 0) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return std::malloc(size);
+    // aligned_alloc wants the size a multiple of the alignment
+    return std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+__attribute__((noinline)) void CountedRelease(void* block) {
+    std::free(block);
+}
+
+void* operator new(std::size_t size) {
+    if (void* block = CountedAllocate(size, 0)) return block;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    if (void* block = CountedAllocate(size, static_cast<std::size_t>(alignment))) return block;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size, 0);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return CountedAllocate(size, 0);
+}
+
+void operator delete(void* block) noexcept {
+    CountedRelease(block);
+}
+
+void operator delete[](void* block) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, std::size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, std::align_val_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, std::align_val_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, std::size_t, std::align_val_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, std::size_t, std::align_val_t) noexcept {
+    operator delete(block);
+}
+
+// When the feed line currently being processed was handed to its connector
+BenchClock::time_point lineStart;
+
+uint64_t NanosSince(BenchClock::time_point start) {
+    auto elapsed = BenchClock::now() - start;
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+// Latency distribution of one hop, labelled for the report
+struct HopReport {
+    std::string hop;
+    LatencyHistogram histogram;
+};
+
+/**
+ * Listener recording, for every message a service publishes, the time since
+ * the current feed line was read. Registered ahead of a service's real
+ * listeners it times the publish; registered after a sink it times the sink.
+ */
+template <typename V>
+class LatencyProbe : public ServiceListener<V> {
+public:
+    explicit LatencyProbe(HopReport& _report) : report(_report) {}
+
+    void ProcessAdd(V&) override { report.histogram.Record(NanosSince(lineStart)); }
+    void ProcessRemove(V&) override {}
+    void ProcessUpdate(V&) override {}
+
+private:
+    HopReport& report;
+};
+
+// Throughput, per-line latency and feed-thread allocations of one feed
+struct FeedReport {
+    std::string feed;
+    size_t lines = 0;
+    double seconds = 0.0;
+    LatencyHistogram histogram;
+    uint64_t allocations = 0;
+    // Allocations over the second half of the lines, once stores are warm
+    uint64_t steadyAllocations = 0;
+    size_t steadyLines = 0;
+};
+
+// Push every line of an in-memory feed through a connector's ProcessLine,
+// then call finish() (e.g. to flush a partial batch)
+template <typename C, typename F>
+FeedReport DriveFeed(const std::string& feed, const std::string& data, C* connector, F finish) {
+    FeedReport report;
+    report.feed = feed;
+
+    size_t halfway = data.size() / 2;
+    uint64_t allocationsAtStart = threadAllocations;
+    uint64_t allocationsAtHalfway = 0;
+    bool pastHalfway = false;
+
+    auto feedStart = BenchClock::now();
+    size_t position = 0;
+    while (position < data.size()) {
+        if (!pastHalfway && position >= halfway) {
+            pastHalfway = true;
+            allocationsAtHalfway = threadAllocations;
+        }
+        size_t end = data.find('\n', position);
+        if (end == std::string::npos) end = data.size();
+        std::string_view line(data.data() + position, end - position);
+        position = end + 1;
+        if (line.empty()) continue;
+
+        lineStart = BenchClock::now();
+        connector->ProcessLine(line);
+        report.histogram.Record(NanosSince(lineStart));
+        ++report.lines;
+        if (pastHalfway) ++report.steadyLines;
+    }
+    uint64_t allocationsAtEnd = threadAllocations;
+    finish();
+    report.seconds = std::chrono::duration<double>(BenchClock::now() - feedStart).count();
+    report.allocations = allocationsAtEnd - allocationsAtStart;
+    report.steadyAllocations = pastHalfway ? allocationsAtEnd - allocationsAtHalfway : 0;
+    return report;
+}
+
+// Generate one feed into memory with a DataGenerator function
+std::string GenerateFeed(vector<string> (*generator)(const GeneratorConfig&), const GeneratorConfig& config) {
+    std::string out;
+    for (const auto& chunk : generator(config)) out += chunk;
+    return out;
+}
+
+void PrintHistogramColumns(const LatencyHistogram& histogram) {
+    std::cout << std::setw(10) << histogram.GetCount()
+              << std::setw(10) << histogram.ValueAtPercentile(50.0)
+              << std::setw(10) << histogram.ValueAtPercentile(99.0)
+              << std::setw(10) << histogram.ValueAtPercentile(99.9)
+              << std::setw(12) << histogram.GetMax() << "\n";
+}
+
+void PrintHistogramHeader(const char* label) {
+    std::cout << std::left << std::setw(24) << label << std::right
+              << std::setw(10) << "count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+              << std::setw(10) << "p99.9" << std::setw(12) << "max" << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    bool async = true;
+    size_t batchSize = 1;
+    GeneratorConfig generatorConfig;
+    generatorConfig.seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sync") {
+            async = false;
+            continue;
+        }
+        bool isBatch = (arg == "--batch" && i + 1 < argc);
+        bool isSeed = (arg == "--seed" && i + 1 < argc);
+        if (isBatch || isSeed) arg = argv[++i];
+        char* end = nullptr;
+        long size = std::strtol(arg.c_str(), &end, 10);
+        if (*end != '\0' || size < (isSeed ? 0 : 1)) {
+            std::cerr << "Error: usage: " << argv[0] << " [DATASIZE] [--sync] [--batch N] [--seed N]" << std::endl;
+            return 1;
+        }
+        if (isBatch) batchSize = static_cast<size_t>(size);
+        else if (isSeed) generatorConfig.seed = static_cast<uint64_t>(size);
+        else generatorConfig.dataSize = static_cast<int>(size);
+    }
+
+    std::filesystem::create_directories("Data/Output");
+
+    // Generate the feeds up front so generation is not timed
+    std::string prices = GenerateFeed(GeneratePrices, generatorConfig);
+    std::string marketData = GenerateFeed(GenerateMarketData, generatorConfig);
+    std::string trades = GenerateFeed(GenerateTrades, generatorConfig);
+    std::string inquiries = GenerateFeed(GenerateInquiries, generatorConfig);
+
+    // The main.cpp services
+    MarketDataService<Bond> BondMarketDataService;
+    PricingService<Bond> BondPricingService;
+    TradeBookingService<Bond> BondTradeBookingService;
+    PositionService<Bond> BondPositionService;
+    RiskService<Bond> BondRiskService;
+    AlgoExecutionService<Bond> BondAlgoExecutionService;
+    AlgoStreamingService<Bond> BondAlgoStreamingService;
+    ExecutionService<Bond> BondExecutionService;
+    StreamingService<Bond> BondStreamingService;
+    InquiryService<Bond> BondInquiryService;
+    GUIService<Bond> BondGUIService;
+    HistoricalDataService<Position<Bond>> BondHistoricalPositionService("Position");
+    HistoricalDataService<PV01<Bond>> BondHistoricalRiskService("Risk");
+    HistoricalDataService<ExecutionOrder<Bond>> BondHistoricalExecutionService("Execution");
+    HistoricalDataService<PriceStream<Bond>> BondHistoricalStreamingService("Streaming");
+    HistoricalDataService<Inquiry<Bond>> BondHistoricalInquiryService("Inquiry");
+
+    if (async) {
+        BondGUIService.EnableAsync();
+        BondHistoricalPositionService.EnableAsync();
+        BondHistoricalRiskService.EnableAsync();
+        BondHistoricalExecutionService.EnableAsync();
+        BondHistoricalStreamingService.EnableAsync();
+        BondHistoricalInquiryService.EnableAsync();
+    }
+
+    // Hop reports in pipeline order, held by pointer so probe references stay valid
+    std::vector<std::unique_ptr<HopReport>> hops;
+    auto newHop = [&hops](const std::string& name) -> HopReport& {
+        hops.push_back(std::unique_ptr<HopReport>(new HopReport{name, LatencyHistogram()}));
+        return *hops.back();
+    };
+
+    // Link the services exactly as main.cpp does, with probes around each hop
+    BondPricingService.AddListener(new LatencyProbe<Price<Bond>>(newHop("Pricing")));
+    BondPricingService.AddListener(BondGUIService.GetListener());
+    BondPricingService.AddListener(BondAlgoStreamingService.GetListener());
+    BondAlgoStreamingService.AddListener(new LatencyProbe<AlgoStream<Bond>>(newHop("AlgoStreaming")));
+    BondAlgoStreamingService.AddListener(BondStreamingService.GetListener());
+    BondStreamingService.AddListener(new LatencyProbe<PriceStream<Bond>>(newHop("Streaming")));
+    BondStreamingService.AddListener(BondHistoricalStreamingService.GetServiceListener());
+    BondStreamingService.AddListener(new LatencyProbe<PriceStream<Bond>>(newHop("HistoricalStreaming")));
+
+    BondMarketDataService.AddListener(new LatencyProbe<OrderBook<Bond>>(newHop("MarketData")));
+    BondMarketDataService.AddTopOfBookListener(BondAlgoExecutionService.GetListener());
+    BondAlgoExecutionService.AddListener(new LatencyProbe<AlgoExecution<Bond>>(newHop("AlgoExecution")));
+    BondAlgoExecutionService.AddListener(BondExecutionService.GetListener());
+    BondExecutionService.AddListener(new LatencyProbe<ExecutionOrder<Bond>>(newHop("Execution")));
+    BondExecutionService.AddListener(BondHistoricalExecutionService.GetServiceListener());
+    BondExecutionService.AddListener(new LatencyProbe<ExecutionOrder<Bond>>(newHop("HistoricalExecution")));
+    BondExecutionService.AddListener(BondTradeBookingService.GetListener());
+    BondTradeBookingService.AddListener(new LatencyProbe<Trade<Bond>>(newHop("TradeBooking")));
+    BondTradeBookingService.AddListener(BondPositionService.GetListener());
+    BondPositionService.AddListener(new LatencyProbe<Position<Bond>>(newHop("Position")));
+    BondPositionService.AddListener(BondRiskService.GetListener());
+    BondPositionService.AddListener(BondHistoricalPositionService.GetServiceListener());
+    BondPositionService.AddListener(new LatencyProbe<Position<Bond>>(newHop("HistoricalPosition")));
+    BondRiskService.AddListener(new LatencyProbe<PV01<Bond>>(newHop("Risk")));
+    BondRiskService.AddListener(BondHistoricalRiskService.GetServiceListener());
+    BondRiskService.AddListener(new LatencyProbe<PV01<Bond>>(newHop("HistoricalRisk")));
+
+    BondInquiryService.AddListener(new LatencyProbe<Inquiry<Bond>>(newHop("Inquiry")));
+    BondInquiryService.AddListener(BondHistoricalInquiryService.GetServiceListener());
+    BondInquiryService.AddListener(new LatencyProbe<Inquiry<Bond>>(newHop("HistoricalInquiry")));
+
+    PricingConnector<Bond>* pricingConnector = BondPricingService.GetConnector();
+    TradeBookingConnector<Bond>* tradeConnector = BondTradeBookingService.GetConnector();
+    pricingConnector->SetBatchSize(batchSize);
+    tradeConnector->SetBatchSize(batchSize);
+
+    // Drive the feeds in main.cpp order
+    auto noFinish = []() {};
+    std::vector<FeedReport> feeds;
+    feeds.push_back(DriveFeed("prices", prices, pricingConnector, [pricingConnector]() { pricingConnector->Flush(); }));
+    feeds.push_back(DriveFeed("marketdata", marketData, BondMarketDataService.GetConnector(), noFinish));
+    feeds.push_back(DriveFeed("trades", trades, tradeConnector, [tradeConnector]() { tradeConnector->Flush(); }));
+    feeds.push_back(DriveFeed("inquiries", inquiries, BondInquiryService.GetConnector(), noFinish));
+
+    std::cout << "DATASIZE " << generatorConfig.dataSize << ", seed " << generatorConfig.seed << ", " << (async ? "async" : "sync")
+              << " persistence, batch size " << batchSize << ", latencies in ns\n\n";
+
+    std::cout << std::left << std::setw(24) << "feed" << std::right
+              << std::setw(10) << "lines" << std::setw(14) << "lines/sec"
+              << std::setw(10) << "allocs" << std::setw(20) << "steady allocs/line" << "\n";
+    for (const auto& feed : feeds) {
+        double rate = feed.seconds > 0.0 ? feed.lines / feed.seconds : 0.0;
+        double steadyRate = feed.steadyLines ? double(feed.steadyAllocations) / feed.steadyLines : 0.0;
+        std::cout << std::left << std::setw(24) << feed.feed << std::right
+                  << std::setw(10) << feed.lines
+                  << std::setw(14) << std::fixed << std::setprecision(0) << rate
+                  << std::setw(10) << feed.allocations
+                  << std::setw(20) << std::setprecision(3) << steadyRate << "\n";
+    }
+
+    std::cout << "\n";
+    PrintHistogramHeader("per-line latency");
+    for (const auto& feed : feeds) {
+        std::cout << std::left << std::setw(24) << feed.feed << std::right;
+        PrintHistogramColumns(feed.histogram);
+    }
+
+    std::cout << "\n";
+    PrintHistogramHeader("hop latency");
+    for (const auto& hop : hops) {
+        std::cout << std::left << std::setw(24) << hop->hop << std::right;
+        PrintHistogramColumns(hop->histogram);
+    }
+
+    return 0;
+}
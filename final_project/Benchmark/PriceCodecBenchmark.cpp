@@ -0,0 +1,126 @@
+//
+//  PriceCodecBenchmark.cpp
+//  TradingSystem
+//
+//  Micro-benchmark of the tick price codec in utility.hpp against the
+//  original substr/stod parser and to_string formatter.
+//
+//  Build from final_project/:
+//    g++ -std=c++17 -O2 -I. Benchmark/PriceCodecBenchmark.cpp -o price_codec_benchmark
+//
+//  @author Zixiuji Wang
+//
+
+#include "utility.hpp"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Original implementations, kept here as the baseline
+double LegacyString2Price(const std::string& fractional) {
+    size_t dashPos = fractional.find('-');
+    if (dashPos == std::string::npos) {
+        throw std::invalid_argument("Invalid fractional notation");
+    }
+
+    double basePrice = std::stod(fractional.substr(0, dashPos));
+    int xy = std::stoi(fractional.substr(dashPos + 1, 2));
+    char zChar = fractional[dashPos + 3];
+    int z = (zChar == '+') ? 4 : zChar - '0';
+
+    if (xy < 0 || xy > 31 || z < 0 || z > 7) {
+        throw std::invalid_argument("Invalid fractional components");
+    }
+
+    return basePrice + (xy / 32.0) + (z / 256.0);
+}
+
+std::string LegacyPrice2String(double decimal) {
+    int basePrice = static_cast<int>(decimal);
+    double fractionalPart = decimal - basePrice;
+    int xy = static_cast<int>(fractionalPart * 32);
+    int z = static_cast<int>((fractionalPart * 256)) % 8;
+    char zChar = (z == 4) ? '+' : '0' + z;
+    return std::to_string(basePrice) + "-" + (xy < 10 ? "0" : "") +
+           std::to_string(xy) + zChar;
+}
+
+// Run a callable over the sample set and report nanoseconds per call
+template <typename F>
+double TimePerCall(const char* label, size_t rounds, size_t samples, F&& body) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        body();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double nanos = std::chrono::duration<double, std::nano>(elapsed).count() / (rounds * samples);
+    std::cout << std::left << std::setw(28) << label << std::fixed << std::setprecision(2)
+              << nanos << " ns/op\n";
+    return nanos;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t rounds = (argc > 1) ? std::stoul(argv[1]) : 200;
+
+    // Every tick between 99-000 and 101-000, plus the half-tick mids
+    std::vector<double> prices;
+    std::vector<std::string> strings;
+    for (long t = 99 * TICKS_PER_POINT; t <= 101 * TICKS_PER_POINT; ++t) {
+        prices.push_back(ticks2price(t));
+        prices.push_back(ticks2price(t) + 1.0 / 512.0);
+        strings.push_back(LegacyPrice2String(ticks2price(t)));
+    }
+
+    // Check both codecs agree before timing them
+    for (size_t i = 0; i < strings.size(); ++i) {
+        if (string2price(strings[i]) != LegacyString2Price(strings[i])) {
+            std::cerr << "Parse mismatch on " << strings[i] << std::endl;
+            return 1;
+        }
+    }
+    for (double p : prices) {
+        if (price2string(p) != LegacyPrice2String(p)) {
+            std::cerr << "Format mismatch on " << p << std::endl;
+            return 1;
+        }
+    }
+
+    // Sinks keep the optimiser from discarding the work
+    volatile double priceSink = 0.0;
+    volatile long tickSink = 0;
+    volatile size_t sizeSink = 0;
+    char buffer[PRICE_BUFFER_SIZE];
+
+    std::cout << "Parsing " << strings.size() << " prices x " << rounds << " rounds\n";
+    double legacyParse = TimePerCall("legacy string2price", rounds, strings.size(), [&]() {
+        for (const auto& s : strings) priceSink = LegacyString2Price(s);
+    });
+    double newParse = TimePerCall("string2price", rounds, strings.size(), [&]() {
+        for (const auto& s : strings) priceSink = string2price(s);
+    });
+    TimePerCall("ParsePriceTicks", rounds, strings.size(), [&]() {
+        for (const auto& s : strings) {
+            long ticks = 0;
+            ParsePriceTicks(s.data(), s.data() + s.size(), ticks);
+            tickSink = ticks;
+        }
+    });
+
+    std::cout << "Formatting " << prices.size() << " prices x " << rounds << " rounds\n";
+    double legacyFormat = TimePerCall("legacy price2string", rounds, prices.size(), [&]() {
+        for (double p : prices) sizeSink = LegacyPrice2String(p).size();
+    });
+    double newFormat = TimePerCall("price2string", rounds, prices.size(), [&]() {
+        for (double p : prices) sizeSink = price2string(p).size();
+    });
+    TimePerCall("FormatPriceTicks", rounds, prices.size(), [&]() {
+        for (double p : prices) sizeSink = FormatPriceTicks(price2ticks(p), buffer);
+    });
+
+    std::cout << std::setprecision(1)
+              << "Parse speedup:  " << legacyParse / newParse << "x\n"
+              << "Format speedup: " << legacyFormat / newFormat << "x\n";
+    return 0;
+}
@@ -4,221 +4,365 @@
 //
 //  Created by Zixiuji Wang
 //
+//  Each feed is generated per bond in parallel: every bond has its own RNG
+//  stream derived from the run's seed, so a (seed, size) pair reproduces
+//  the same files whatever the thread count. Lines are formatted into one
+//  private buffer per bond with the tick price codec, and the buffers are
+//  written out in bondMap order, one write each. The same feeds can be
+//  generated for another product type's identifiers into its own directory.
+//  With timestamps requested, every line starts with its time in
+//  microseconds, in the form ReplayDriver::AddTimestampedFeed reads.
+//
 
 #ifndef DataGenerator_hpp
 #define DataGenerator_hpp
 
 #include <boost/date_time/gregorian/gregorian.hpp>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <random>
 #include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
-#include "utility.hpp" // Assumes this header provides bondMap, price2string, etc.
+#include "productfactory.hpp"
+#include "utility.hpp" // Assumes this header provides bondMap, FormatPriceTicks, etc.
 
 using namespace std;
 using namespace boost::gregorian;
 
-// Set the scale of the generated data
-int DATASIZE = 10000;
-
 // Specify the output directory
 const string dirPath = "Data/Input/";
 
 /**
- * GeneratePrices()
- *
- * This function creates "prices.txt" in overwrite mode.
- * For each bond in bondMap, it generates a series of bid/ask prices
- * oscillating around [99.0, 101.0], with a minimum tick of 1/256.
+ * GeneratorConfig
+ * Scale, seed and parallelism of a generation run. dataSize is the number
+ * of prices per bond (market data has dataSize / 10 books per bond).
+ * The feeds are generated for productIds and written under directory.
+ * A positive timestampMicros prefixes every line with a timestamp: each
+ * bond's records arrive at random (Poisson) times over about that many
+ * microseconds, drawn from their own RNG stream so the records themselves
+ * are the same as without timestamps.
  */
-void GeneratePrices() {
-    const string filePath = dirPath + "prices.txt";
-    // Open the file in overwrite (trunc) mode
-    ofstream file(filePath, ios::out | ios::trunc);
-    if (!file.is_open()) {
-        cerr << "Error: Unable to open or create file at " << filePath << endl;
-        return;
-    }
+struct GeneratorConfig
+{
+    int dataSize = 10000;
+    uint64_t seed = 0;
+    size_t threads = max(1u, thread::hardware_concurrency());
+    vector<string> productIds = ProductTraits<Bond>::GetProductIds();
+    string directory = dirPath;
+    int64_t timestampMicros = 0;
+
+    // A config with a fresh random seed, to be printed so the run can be reproduced
+    static GeneratorConfig Random(int dataSize = 10000);
+};
+
+GeneratorConfig GeneratorConfig::Random(int dataSize)
+{
+    GeneratorConfig config;
+    config.dataSize = dataSize;
+    random_device rd;
+    config.seed = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    return config;
+}
 
-    const int orderSize = DATASIZE;
-    const double minTick = 1.0 / 256.0;
-    const double LOW_LIMIT = 99.0 + minTick * 2.0;
-    const double UPPER_LIMIT = 101.0 - minTick * 2.0;
-
-    for (const auto& [mat, bond] : bondMap) {
-        double central_price = LOW_LIMIT;
-        bool up = true;
-        thread_local random_device rd;
-        thread_local mt19937_64 gen(rd());
-        thread_local bernoulli_distribution d(0.5);
-
-        for (int i = 0; i < orderSize; ++i) {
-            double ask = central_price + minTick;
-            double bid = central_price - minTick;
-
-            // Randomly adjust ask or bid by an additional tick
-            if (d(gen)) ask += minTick;
-            if (d(gen)) bid -= minTick;
-
-            // Oscillate the central price
-            central_price += (up ? minTick : -minTick);
-            if (central_price >= UPPER_LIMIT) up = false;
-            if (central_price <= LOW_LIMIT) up = true;
-
-            // Write (BondID, Bid, Ask) to file
-            file << bond.first << ","
-                 << price2string(bid) << ","
-                 << price2string(ask) << endl;
-        }
-    }
+// Salts separating the RNG streams of the four feeds
+enum class GeneratorFeed : uint64_t
+{
+    PRICES = 1,
+    MARKET_DATA = 2,
+    TRADES = 3,
+    INQUIRIES = 4
+};
+
+// SplitMix64 finaliser: decorrelates the per-bond seeds of nearby run seeds
+uint64_t MixSeed(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
 
-    file.close();
-    cout << "prices.txt Generated (overwritten)!\n";
+// The RNG stream of one bond in one feed
+mt19937_64 MakeBondStream(const GeneratorConfig& config, GeneratorFeed feed, size_t bondOrdinal) {
+    uint64_t seed = MixSeed(config.seed ^ MixSeed(static_cast<uint64_t>(feed) << 32 | bondOrdinal));
+    return mt19937_64(seed);
+}
+
+// The RNG stream of one bond's timestamps in one feed, apart from its records
+mt19937_64 MakeTimestampStream(const GeneratorConfig& config, GeneratorFeed feed, size_t bondOrdinal) {
+    const uint64_t TIMESTAMP_SALT = 0x54494D45ULL;
+    uint64_t seed = MixSeed(config.seed ^ TIMESTAMP_SALT ^ MixSeed(static_cast<uint64_t>(feed) << 32 | bondOrdinal));
+    return mt19937_64(seed);
+}
+
+// Appenders formatting straight into a line buffer
+void AppendText(string& out, string_view text) {
+    out.append(text.data(), text.size());
+}
+
+void AppendInteger(string& out, long value) {
+    char buffer[24];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, static_cast<size_t>(result.ptr - buffer));
+}
+
+void AppendPrice(string& out, long ticks) {
+    char buffer[PRICE_BUFFER_SIZE];
+    out.append(buffer, FormatPriceTicks(ticks, buffer));
 }
 
 /**
- * GenerateMarketData()
+ * TimestampLines(config, feed, bondOrdinal, linesPerRecord, chunk)
  *
- * This function creates "marketdata.txt" in overwrite mode.
- * For each bond in bondMap, it simulates a 5-level order book around
- * the price range [99.0, 101.0].
+ * Prefixes every line of one bond's chunk with "<microseconds>,". Each run
+ * of linesPerRecord lines is one record and shares a timestamp, so a record
+ * spanning several lines stays together once feeds are merged by time.
  */
-void GenerateMarketData() {
-    const string filePath = dirPath + "marketdata.txt";
-    ofstream file(filePath, ios::out | ios::trunc);
-    if (!file.is_open()) {
-        cerr << "Error: Unable to open or create file at " << filePath << endl;
-        return;
-    }
-
-    const int orderSize = DATASIZE / 10;
-    const double minTick = 1.0 / 256.0;
-    const double basePrice = 99.0;
-
-    for (const auto& [mat, bond] : bondMap) {
-        double price = basePrice;
-        bool increasing = true;
-
-        for (int i = 0; i < orderSize; ++i) {
-            // Simulate 1 ~ 5 levels for bid/offer
-            for (int level = 1; level <= 5; ++level) {
-                double spread = level * minTick;
-                double bidPrice = price - spread;
-                double askPrice = price + spread;
-                int size = level * 10000000;  // e.g., 10 million, 20 million, etc.
-
-                file << bond.first << ","
-                     << price2string(bidPrice) << ","
-                     << size << ",BID" << endl;
-
-                file << bond.first << ","
-                     << price2string(askPrice) << ","
-                     << size << ",OFFER" << endl;
-            }
-
-            // Price oscillation
-            if (price >= 101.0 - minTick) increasing = false;
-            if (price <= 99.0 + minTick) increasing = true;
-            price += (increasing ? minTick : -minTick);
-        }
+void TimestampLines(const GeneratorConfig& config, GeneratorFeed feed, size_t bondOrdinal, size_t linesPerRecord,
+                    string& chunk) {
+    size_t lines = static_cast<size_t>(count(chunk.begin(), chunk.end(), '\n'));
+    size_t records = max<size_t>(1, lines / max<size_t>(linesPerRecord, 1));
+    mt19937_64 gen = MakeTimestampStream(config, feed, bondOrdinal);
+    exponential_distribution<double> gap(static_cast<double>(records) / static_cast<double>(config.timestampMicros));
+
+    string stamped;
+    stamped.reserve(chunk.size() + lines * 12);
+    double time = 0.0;
+    size_t line = 0;
+    for (size_t begin = 0; begin < chunk.size(); ++line) {
+        if (line % max<size_t>(linesPerRecord, 1) == 0) time += gap(gen);
+        size_t end = chunk.find('\n', begin);
+        end = (end == string::npos) ? chunk.size() : end + 1;
+        AppendInteger(stamped, min(static_cast<long>(time), static_cast<long>(config.timestampMicros)));
+        stamped.push_back(',');
+        stamped.append(chunk, begin, end - begin);
+        begin = end;
     }
-
-    file.close();
-    cout << "marketdata.txt Generated (overwritten)!\n";
+    chunk.swap(stamped);
 }
 
 /**
- * GenerateInquiries()
+ * GenerateBondChunks(config, feed, bytesPerBond, generateBond, linesPerRecord)
  *
- * This function creates "inquiries.txt" in overwrite mode.
- * For each bond in bondMap, it generates 10 inquiry entries with random
- * prices, buy/sell side, and quantity.
+ * Runs generateBond(CUSIP, rng, out) once per product in config.productIds,
+ * spread over config.threads threads, and returns the per-product buffers
+ * in that order. bytesPerBond is reserved up front so a buffer grows at
+ * most once. If config asks for timestamps, each buffer is then stamped
+ * with one time per linesPerRecord lines.
  */
-void GenerateInquiries() {
-    const string filePath = dirPath + "inquiries.txt";
-    ofstream file(filePath, ios::out | ios::trunc);
+vector<string> GenerateBondChunks(const GeneratorConfig& config, GeneratorFeed feed, size_t bytesPerBond,
+                                  const function<void(const string&, mt19937_64&, string&)>& generateBond,
+                                  size_t linesPerRecord = 1) {
+    vector<const string*> ids;
+    for (const string& id : config.productIds) ids.push_back(&id);
+
+    vector<string> chunks(ids.size());
+    atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < ids.size(); i = next++) {
+            mt19937_64 gen = MakeBondStream(config, feed, i);
+            chunks[i].reserve(bytesPerBond);
+            generateBond(*ids[i], gen, chunks[i]);
+            if (config.timestampMicros > 0) TimestampLines(config, feed, i, linesPerRecord, chunks[i]);
+        }
+    };
+
+    size_t workers = min(max<size_t>(config.threads, 1), ids.size());
+    vector<thread> threads;
+    for (size_t t = 1; t < workers; ++t) threads.emplace_back(work);
+    work();
+    for (auto& worker : threads) worker.join();
+    return chunks;
+}
+
+// Write the chunks to a stream, one write per chunk
+void WriteChunks(ostream& file, const vector<string>& chunks) {
+    for (const auto& chunk : chunks) {
+        file.write(chunk.data(), static_cast<streamsize>(chunk.size()));
+    }
+}
+
+// Write the chunks to directory + fileName, overwriting any previous file
+void WriteChunks(const string& directory, const string& fileName, const vector<string>& chunks) {
+    const string filePath = directory + fileName;
+    ofstream file(filePath, ios::out | ios::trunc | ios::binary);
     if (!file.is_open()) {
         cerr << "Error: Unable to open or create file at " << filePath << endl;
         return;
     }
 
-    thread_local random_device rd;
-    thread_local mt19937_64 gen(rd());
-    thread_local uniform_real_distribution<double> d(0.0, 1.0);
-    const double minTick = 1.0 / 256.0;
-
-    for (const auto& [mat, bond] : bondMap) {
-        for (int i = 0; i < 10; ++i) {
-            int _n = static_cast<int>(d(gen) * 512);
-            double _price = 99.0 + minTick * _n;
-
-            string inquiryId = bond.first + "_INQ" + to_string(i);
-            string side = (i % 2 == 0) ? "BUY" : "SELL";
-            int quantity = ((i % 5) + 1) * 1000000;
-
-            // Write (InquiryID, BondID, Side, Quantity, Price, Status) to file
-            file << inquiryId << ","
-                 << bond.first << ","
-                 << side << ","
-                 << quantity << ","
-                 << price2string(_price) << ",RECEIVED"
-                 << endl;
-        }
-    }
-
+    WriteChunks(file, chunks);
     file.close();
-    cout << "inquiries.txt Generated (overwritten)!\n";
+    cout << fileName << " Generated (overwritten)!\n";
 }
 
 /**
- * GenerateTrades()
+ * GeneratePrices(config)
  *
- * This function creates "trades.txt" in overwrite mode.
- * For each bond in bondMap, it generates 10 trade entries with random
- * trade IDs, buy/sell side, quantity, and a random "book" name.
+ * Generates the contents of "prices.txt". For each bond in bondMap, it
+ * generates a series of bid/ask prices oscillating around [99.0, 101.0],
+ * with a minimum tick of 1/256.
  */
-void GenerateTrades() {
-    const string filePath = dirPath + "trades.txt";
-    ofstream file(filePath, ios::out | ios::trunc);
-    if (!file.is_open()) {
-        cerr << "Error: Unable to open or create file at " << filePath << endl;
-        return;
-    }
+vector<string> GeneratePrices(const GeneratorConfig& config) {
+    const int orderSize = config.dataSize;
+    const long LOW_LIMIT = 99 * TICKS_PER_POINT + 2;
+    const long UPPER_LIMIT = 101 * TICKS_PER_POINT - 2;
+
+    return GenerateBondChunks(config, GeneratorFeed::PRICES, static_cast<size_t>(orderSize) * 32,
+        [orderSize, LOW_LIMIT, UPPER_LIMIT](const string& id, mt19937_64& gen, string& out) {
+            bernoulli_distribution d(0.5);
+            long central_price = LOW_LIMIT;
+            bool up = true;
+
+            for (int i = 0; i < orderSize; ++i) {
+                long ask = central_price + 1;
+                long bid = central_price - 1;
+
+                // Randomly adjust ask or bid by an additional tick
+                if (d(gen)) ask += 1;
+                if (d(gen)) bid -= 1;
+
+                // Oscillate the central price
+                central_price += (up ? 1 : -1);
+                if (central_price >= UPPER_LIMIT) up = false;
+                if (central_price <= LOW_LIMIT) up = true;
+
+                // (BondID, Bid, Ask)
+                AppendText(out, id);
+                out.push_back(',');
+                AppendPrice(out, bid);
+                out.push_back(',');
+                AppendPrice(out, ask);
+                out.push_back('\n');
+            }
+        });
+}
 
-    thread_local random_device rd;
-    thread_local mt19937_64 gen(rd());
-    thread_local uniform_real_distribution<double> d(0.0, 1.0);
-    const double minTick = 1.0 / 256.0;
-
-    for (const auto& [mat, bond] : bondMap) {
-        for (int i = 0; i < 10; ++i) {
-            string tradeId = bond.first + "_TRADE" + to_string(i);
-            string side = (i % 2 == 0) ? "BUY" : "SELL";
-            int quantity = ((i % 5) + 1) * 1000000;
-
-            // Randomly choose a trade book index from [1..3]
-            int _market = (static_cast<int>(d(gen) * 3) % 3) + 1;
-            string _book_name = "TRSY" + to_string(_market);
-
-            // Random price based on minTick offset
-            int _n = static_cast<int>(d(gen) * 512);
-            double _price = 99.0 + minTick * _n;
-
-            // Write (BondID, TradeID, Price, BookName, Quantity, Side) to file
-            file << bond.first << ","
-                 << tradeId << ","
-                 << price2string(_price) << ","
-                 << _book_name << ","
-                 << quantity << ","
-                 << side
-                 << endl;
-        }
-    }
+/**
+ * GenerateMarketData(config)
+ *
+ * Generates the contents of "marketdata.txt". For each bond in bondMap, it
+ * simulates a 5-level order book around the price range [99.0, 101.0].
+ * A book's 10 lines are one record.
+ */
+vector<string> GenerateMarketData(const GeneratorConfig& config) {
+    const int orderSize = config.dataSize / 10;
+
+    return GenerateBondChunks(config, GeneratorFeed::MARKET_DATA, static_cast<size_t>(orderSize) * 10 * 36,
+        [orderSize](const string& id, mt19937_64& /*gen*/, string& out) {
+            long price = 99 * TICKS_PER_POINT;
+            bool increasing = true;
+
+            for (int i = 0; i < orderSize; ++i) {
+                // Simulate 1 ~ 5 levels for bid/offer
+                for (int level = 1; level <= 5; ++level) {
+                    long size = level * 10000000L;  // e.g., 10 million, 20 million, etc.
+
+                    AppendText(out, id);
+                    out.push_back(',');
+                    AppendPrice(out, price - level);
+                    out.push_back(',');
+                    AppendInteger(out, size);
+                    AppendText(out, ",BID\n");
+
+                    AppendText(out, id);
+                    out.push_back(',');
+                    AppendPrice(out, price + level);
+                    out.push_back(',');
+                    AppendInteger(out, size);
+                    AppendText(out, ",OFFER\n");
+                }
+
+                // Price oscillation
+                if (price >= 101 * TICKS_PER_POINT - 1) increasing = false;
+                if (price <= 99 * TICKS_PER_POINT + 1) increasing = true;
+                price += (increasing ? 1 : -1);
+            }
+        }, 10);
+}
 
-    file.close();
-    cout << "trades.txt Generated (overwritten)!\n";
+/**
+ * GenerateInquiries(config)
+ *
+ * Generates the contents of "inquiries.txt". For each bond in bondMap, it
+ * generates 10 inquiry entries with random prices, buy/sell side, and
+ * quantity.
+ */
+vector<string> GenerateInquiries(const GeneratorConfig& config) {
+    return GenerateBondChunks(config, GeneratorFeed::INQUIRIES, 1024,
+        [](const string& id, mt19937_64& gen, string& out) {
+            uniform_real_distribution<double> d(0.0, 1.0);
+
+            for (int i = 0; i < 10; ++i) {
+                long _price = 99 * TICKS_PER_POINT + static_cast<long>(d(gen) * 512);
+                long quantity = ((i % 5) + 1) * 1000000L;
+
+                // (InquiryID, BondID, Side, Quantity, Price, Status)
+                AppendText(out, id);
+                AppendText(out, "_INQ");
+                AppendInteger(out, i);
+                out.push_back(',');
+                AppendText(out, id);
+                AppendText(out, (i % 2 == 0) ? ",BUY," : ",SELL,");
+                AppendInteger(out, quantity);
+                out.push_back(',');
+                AppendPrice(out, _price);
+                AppendText(out, ",RECEIVED\n");
+            }
+        });
+}
+
+/**
+ * GenerateTrades(config)
+ *
+ * Generates the contents of "trades.txt". For each bond in bondMap, it
+ * generates 10 trade entries with buy/sell side, quantity, a random price
+ * and a random "book" name.
+ */
+vector<string> GenerateTrades(const GeneratorConfig& config) {
+    return GenerateBondChunks(config, GeneratorFeed::TRADES, 1024,
+        [](const string& id, mt19937_64& gen, string& out) {
+            uniform_real_distribution<double> d(0.0, 1.0);
+
+            for (int i = 0; i < 10; ++i) {
+                long quantity = ((i % 5) + 1) * 1000000L;
+
+                // Randomly choose a trade book index from [1..3]
+                int _market = (static_cast<int>(d(gen) * 3) % 3) + 1;
+
+                // Random price based on minTick offset
+                long _price = 99 * TICKS_PER_POINT + static_cast<long>(d(gen) * 512);
+
+                // (BondID, TradeID, Price, BookName, Quantity, Side)
+                AppendText(out, id);
+                out.push_back(',');
+                AppendText(out, id);
+                AppendText(out, "_TRADE");
+                AppendInteger(out, i);
+                out.push_back(',');
+                AppendPrice(out, _price);
+                AppendText(out, ",TRSY");
+                AppendInteger(out, _market);
+                out.push_back(',');
+                AppendInteger(out, quantity);
+                AppendText(out, (i % 2 == 0) ? ",BUY\n" : ",SELL\n");
+            }
+        });
+}
+
+// Write the four input files under config.directory, overwriting any previous ones
+void GenerateAll(const GeneratorConfig& config) {
+    WriteChunks(config.directory, "prices.txt", GeneratePrices(config));
+    WriteChunks(config.directory, "trades.txt", GenerateTrades(config));
+    WriteChunks(config.directory, "inquiries.txt", GenerateInquiries(config));
+    WriteChunks(config.directory, "marketdata.txt", GenerateMarketData(config));
 }
 
 #endif /* DataGenerator_hpp */
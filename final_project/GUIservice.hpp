@@ -11,8 +11,11 @@
 #include <fstream>
 #include <string>
 #include <thread>
+#include "asyncwriter.hpp"
+#include "bufferedwriter.hpp"
 #include "soa.hpp"
 #include "pricingservice.hpp"
+#include "throttle.hpp"
 #include "utility.hpp"
 
 // Throttle value in milliseconds
@@ -30,8 +33,8 @@ template<typename T>
 class GUIService : Service<string, Price<T>>  {
 
 public:
-    // Constructor
-    GUIService();
+    // Constructor; ticks are written to _outputPath
+    explicit GUIService(const string& _outputPath = "Data/Output/gui.txt");
 
     // Destructor
     ~GUIService();
@@ -54,42 +57,62 @@ public:
     // Get the listener
     ServiceListener<Price<T>>* GetListener();
 
-    // Get the current time
-    int GetTime() const;
+    // Replace the throttle in front of the connector (resets its counters)
+    void SetThrottlePolicy(ThrottlePolicy policy);
 
-    // Set the time
-    void SetTime(int _time);
+    // Accepted/suppressed counters of the throttle
+    ThrottleStats GetThrottleStats() const;
+
+    // Write accepted ticks on a background writer thread
+    void EnableAsync(size_t queueCapacity = DEFAULT_ASYNC_QUEUE_CAPACITY,
+                     OverflowPolicy overflow = OverflowPolicy::BLOCK);
+
+    // Back-pressure counters of the background writer (all zero if synchronous)
+    AsyncWriterStats GetAsyncStats() const;
+
+    // Ticks waiting for the background writer (zero if synchronous)
+    size_t GetAsyncQueueDepth() const;
 
 private:
-    map<string, Price<T>> GUIs;
+    ProductStore<Price<T>> GUIs;
     vector<ServiceListener<Price<T>>*> listeners;
     GUIConnector<T>* connector;
     ServiceListener<Price<T>>* listener;
-    int timeCount;
+
+    // By default at most one tick per THROTTLE_MILLISECONDS across all products
+    Throttle<Price<T>> throttle;
 };
 
 template<typename T>
-GUIService<T>::GUIService() {
-    GUIs = map<string, Price<T>>();
+GUIService<T>::GUIService(const string& _outputPath) {
+    GUIs = ProductStore<Price<T>>();
     listeners = vector<ServiceListener<Price<T>>*>();
-    connector = new GUIConnector<T>(this);
+    connector = new GUIConnector<T>(this, _outputPath);
     listener = new GUIListener<T>(this);
-    timeCount = 0;
+
+    ThrottlePolicy throttlePolicy;
+    throttlePolicy.interval = chrono::milliseconds(THROTTLE_MILLISECONDS);
+    throttle = Throttle<Price<T>>(throttlePolicy);
 }
 
 template<typename T>
-GUIService<T>::~GUIService() {}
+GUIService<T>::~GUIService()
+{
+    // Drains the background writer, if any
+    delete connector;
+}
 
 template<typename T>
 Price<T>& GUIService<T>::GetData(string _key) {
-    return GUIs[_key];
+    return GUIs.Get(_key);
 }
 
 template<typename T>
 void GUIService<T>::OnMessage(Price<T>& _data) {
-    string product_id = _data.GetProduct().GetProductId();
-    GUIs[product_id] = _data;
-    connector->Publish(_data);
+    GUIs[_data.GetProduct().GetProductIndex()] = _data;
+
+    // Ticks arriving without a token are dropped
+    if (throttle.Accept(_data)) connector->Publish(_data);
 }
 
 template<typename T>
@@ -117,68 +140,112 @@ ServiceListener<Price<T>>* GUIService<T>::GetListener()
 }
 
 template<typename T>
-int GUIService<T>::GetTime() const
+void GUIService<T>::SetThrottlePolicy(ThrottlePolicy policy)
+{
+    throttle = Throttle<Price<T>>(policy);
+}
+
+template<typename T>
+ThrottleStats GUIService<T>::GetThrottleStats() const
+{
+    return throttle.GetStats();
+}
+
+template<typename T>
+void GUIService<T>::EnableAsync(size_t queueCapacity, OverflowPolicy overflow)
 {
-    return timeCount;
+    connector->EnableAsync(queueCapacity, overflow);
 }
 
 template<typename T>
-void GUIService<T>::SetTime(int _time)
+AsyncWriterStats GUIService<T>::GetAsyncStats() const
 {
-    timeCount = _time;
+    return connector->GetAsyncStats();
+}
+
+template<typename T>
+size_t GUIService<T>::GetAsyncQueueDepth() const
+{
+    return connector->GetAsyncQueueDepth();
 }
 
 // GUIConnector class definition
 template<typename T>
 class GUIConnector : public Connector<Price<T>> {
 public:
-    GUIConnector(GUIService<T>* service);
+    GUIConnector(GUIService<T>* service, const string& outputPath);
+    ~GUIConnector();
 
     void Publish(Price<T>& _data);
 
     // Not implemented
     void Subscribe(ifstream& _data);
 
+    // Hand accepted ticks to a background writer instead of writing inline
+    void EnableAsync(size_t queueCapacity, OverflowPolicy overflow);
+
+    // Back-pressure counters of the background writer
+    AsyncWriterStats GetAsyncStats() const;
+    size_t GetAsyncQueueDepth() const;
+
 private:
     GUIService<T>* guiService;
+    BufferedFileWriter* output;
+    AsyncRecordWriter<TimestampedRecord<Price<T>>>* asyncWriter;
 };
 
 template<typename T>
-GUIConnector<T>::GUIConnector(GUIService<T>* service) : guiService(service) {}
+GUIConnector<T>::GUIConnector(GUIService<T>* service, const string& outputPath)
+    : guiService(service), asyncWriter(nullptr)
+{
+    // gui.txt stays open; throttled ticks are rare, so each is flushed at once
+    FlushPolicy everyRecord;
+    everyRecord.maxBufferedBytes = 0;
+    output = new BufferedFileWriter(outputPath, everyRecord);
+}
 
 template<typename T>
-void GUIConnector<T>::Publish(Price<T>& _data)
+GUIConnector<T>::~GUIConnector()
 {
-    int _time = guiService->GetTime();
+    delete asyncWriter;
+    delete output;
+}
 
-    auto timePoint = chrono::system_clock::now();
-    auto sec = chrono::time_point_cast<chrono::seconds>(timePoint);
-    auto millisec = chrono::duration_cast<chrono::milliseconds>(timePoint - sec);
-    long currentTime = static_cast<long>(millisec.count());
+template<typename T>
+void GUIConnector<T>::EnableAsync(size_t queueCapacity, OverflowPolicy overflow)
+{
+    if (asyncWriter) return;
+    asyncWriter = new AsyncRecordWriter<TimestampedRecord<Price<T>>>(
+        *output,
+        [](const TimestampedRecord<Price<T>>& record, BufferedFileWriter& output)
+        {
+            WriteTextRecord(record.timestamp, record.data, output);
+        },
+        queueCapacity, overflow);
+}
 
-    // Update time
-    while (currentTime < _time) {
-        currentTime += 1000;
-    }
-    if (currentTime - _time >= THROTTLE_MILLISECONDS)
+template<typename T>
+AsyncWriterStats GUIConnector<T>::GetAsyncStats() const
+{
+    return asyncWriter ? asyncWriter->GetStats() : AsyncWriterStats();
+}
+
+template<typename T>
+size_t GUIConnector<T>::GetAsyncQueueDepth() const
+{
+    return asyncWriter ? asyncWriter->GetQueueDepth() : 0;
+}
+
+template<typename T>
+void GUIConnector<T>::Publish(Price<T>& _data)
+{
+    // Throttling happens in GUIService; every tick reaching here is written
+    if (asyncWriter)
     {
-        guiService->SetTime(currentTime);
-        ofstream _file;
-        _file.open("Data/Output/gui.txt", ios::app);
-
-        if (!_file.is_open()) {
-            cerr << "Error: Unable to open file at " << "Data/Output/gui.txt" << endl;
-            return;
-        }
-
-        auto now = microsec_clock::local_time();
-        _file << now << ",";
-        for (auto& s : _data.PrintFunction())
-        {
-            _file << s << ",";
-        }
-        _file << "\n";
+        asyncWriter->Enqueue(TimestampedRecord<Price<T>>{microsec_clock::local_time(), _data});
+        return;
     }
+    WriteTextRecord(microsec_clock::local_time(), _data, *output);
 }
 
 template<typename T>
@@ -0,0 +1,86 @@
+//
+//  JournalConverter.cpp
+//  TradingSystem
+//
+//  Converts a binary historical journal (e.g. Data/Output/positions.bin)
+//  back into the comma-separated text format of the .txt outputs.
+//
+//  Build from final_project/:
+//    g++ -std=c++17 -O2 -I. Tools/JournalConverter.cpp -o journal_converter
+//  Usage:
+//    ./journal_converter Data/Output/positions.bin positions.txt
+//
+//  @author Zixiuji Wang
+//
+
+#include "historicaldataservice.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Decode every V record in the journal and write it out as text
+template <typename V>
+long ConvertJournal(std::ifstream& input, BufferedFileWriter& output)
+{
+    long converted = 0;
+    ptime timestamp;
+    V dataObj;
+    while (ReadJournalRecord(input, timestamp, dataObj))
+    {
+        WriteTextRecord(timestamp, dataObj, output);
+        ++converted;
+    }
+    return converted;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <journal.bin> <output.txt>" << std::endl;
+        return 1;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    JournalHeader header;
+    if (!input.is_open() || !ReadJournalHeader(input, header))
+    {
+        std::cerr << "Error: " << argv[1] << " is not a journal file" << std::endl;
+        return 1;
+    }
+
+    // Start the text file from scratch rather than appending to it
+    std::ofstream(argv[2], std::ios::trunc);
+    FlushPolicy policy;
+    policy.maxBufferedBytes = 1 << 20;
+    BufferedFileWriter output(argv[2], policy);
+    if (!output.IsOpen()) return 1;
+
+    long converted = -1;
+    switch (header.recordType)
+    {
+    case JOURNAL_POSITION:
+        if (MatchesJournal<Position<Bond>>(header)) converted = ConvertJournal<Position<Bond>>(input, output);
+        break;
+    case JOURNAL_RISK:
+        if (MatchesJournal<PV01<Bond>>(header)) converted = ConvertJournal<PV01<Bond>>(input, output);
+        break;
+    case JOURNAL_EXECUTION:
+        if (MatchesJournal<ExecutionOrder<Bond>>(header)) converted = ConvertJournal<ExecutionOrder<Bond>>(input, output);
+        break;
+    case JOURNAL_STREAMING:
+        if (MatchesJournal<PriceStream<Bond>>(header)) converted = ConvertJournal<PriceStream<Bond>>(input, output);
+        break;
+    case JOURNAL_INQUIRY:
+        if (MatchesJournal<Inquiry<Bond>>(header)) converted = ConvertJournal<Inquiry<Bond>>(input, output);
+        break;
+    }
+
+    if (converted < 0)
+    {
+        std::cerr << "Error: unsupported journal record type " << header.recordType << std::endl;
+        return 1;
+    }
+    std::cout << "Converted " << converted << " records to " << argv[2] << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+//
+//  RiskReport.cpp
+//  TradingSystem
+//
+//  Loads historical bond positions and risk (journals or .txt outputs) into
+//  a PositionHistory and prints the treasury bucketed PV01, the exposure of
+//  every book and the total PV01 at the close of each interval.
+//
+//  Build from final_project/:
+//    g++ -std=c++17 -O2 -pthread -I. Tools/RiskReport.cpp -o risk_report
+//  Usage:
+//    ./risk_report Data/Output/positions.txt Data/Output/risk.txt [interval seconds]
+//
+//  @author Zixiuji Wang
+//
+
+#include "riskreport.hpp"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 && argc != 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <positions> <risk> [interval seconds]" << std::endl;
+        return 1;
+    }
+    const double seconds = (argc == 4) ? std::atof(argv[3]) : 1.0;
+    if (seconds <= 0.0)
+    {
+        std::cerr << "Error: the interval must be positive" << std::endl;
+        return 1;
+    }
+
+    PositionHistory<Bond> history;
+    size_t positionRows = history.LoadPositions(argv[1]);
+    size_t riskRows = history.LoadRisk(argv[2]);
+    std::cout << "Loaded " << positionRows << " position rows and " << riskRows << " risk rows" << std::endl;
+    if (positionRows + riskRows == 0) return 1;
+
+    RiskReport<Bond> report(history);
+
+    std::cout << "\nBucketed PV01" << std::endl;
+    for (auto& sector : MakeTreasurySectors())
+    {
+        std::cout << "  " << sector.GetName() << "," << report.GetBucketedRisk(sector).GetPV01() << std::endl;
+    }
+
+    std::cout << "\nBook exposure (book,quantity,PV01)" << std::endl;
+    for (auto& exposure : report.GetBookExposure())
+    {
+        std::cout << "  " << exposure.book << "," << static_cast<long>(exposure.quantity) << "," << exposure.pv01
+                  << std::endl;
+    }
+
+    const int64_t interval = static_cast<int64_t>(seconds * 1000000.0);
+    const int64_t start = history.GetFirstTimestamp();
+    const size_t count = static_cast<size_t>((history.GetLastTimestamp() - start) / interval) + 1;
+    std::cout << "\nPV01 at the close of each interval" << std::endl;
+    std::vector<double> series = report.GetPV01Series(start, interval, count);
+    for (size_t b = 0; b < count; ++b)
+    {
+        std::cout << "  " << boost::posix_time::to_simple_string(FromJournalTime(start + (b + 1) * interval)) << ","
+                  << series[b] << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+//
+//  SnapshotCheck.cpp
+//  TradingSystem
+//
+//  Checks that a service snapshot survives a save and restore unchanged.
+//  Given one snapshot, it restores it, saves the restored services to
+//  <snapshot>.check, restores that into fresh services and compares the
+//  two states. Given two, it restores each and compares them, e.g. the
+//  snapshot of a run against one saved again after `main --restore`.
+//  Journals are not replayed; only the snapshots themselves are compared.
+//
+//  Build from final_project/:
+//    g++ -std=c++17 -O2 -pthread -I. Tools/SnapshotCheck.cpp -o snapshot_check
+//  Usage:
+//    ./snapshot_check <snapshot> [other snapshot]
+//
+//  @author Zixiuji Wang
+//
+
+#include "snapshot.hpp"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// The four stateful services of a snapshot, restored without journals
+struct SnapshotServices
+{
+    SnapshotServices() : snapshot(positions, risk, inquiries, marketData, SnapshotJournals::None()) {}
+
+    PositionService<Bond> positions;
+    RiskService<Bond> risk;
+    InquiryService<Bond> inquiries;
+    MarketDataService<Bond> marketData;
+    ServiceSnapshot<Bond> snapshot;
+};
+
+std::string JoinFields(const std::string& kind, const std::vector<std::string>& fields)
+{
+    std::string line = kind;
+    for (const auto& field : fields) line += "," + field;
+    return line;
+}
+
+// One line per position, PV01, inquiry and order book level, in sorted order
+std::vector<std::string> DescribeState(SnapshotServices& services)
+{
+    std::vector<std::string> lines;
+    services.positions.ForEachPosition(
+        [&lines](const Position<Bond>& position) { lines.push_back(JoinFields("position", position.PrintFunction())); });
+    services.risk.ForEachPV01(
+        [&lines](const PV01<Bond>& pv01) { lines.push_back(JoinFields("pv01", pv01.PrintFunction())); });
+    services.inquiries.ForEachInquiry(
+        [&lines](const Inquiry<Bond>& inquiry) { lines.push_back(JoinFields("inquiry", inquiry.PrintFunction())); });
+    services.marketData.ForEachOrderBook([&lines](const OrderBook<Bond>& book) {
+        const std::string& productId = book.GetProduct().GetProductId();
+        for (size_t i = 0; i < book.GetBids().GetLevelCount(); ++i)
+        {
+            const auto& level = book.GetBids().GetLevel(i);
+            lines.push_back(JoinFields("bid", {productId, std::to_string(level.price.Ticks()), std::to_string(level.quantity)}));
+        }
+        for (size_t i = 0; i < book.GetOffers().GetLevelCount(); ++i)
+        {
+            const auto& level = book.GetOffers().GetLevel(i);
+            lines.push_back(JoinFields("offer", {productId, std::to_string(level.price.Ticks()), std::to_string(level.quantity)}));
+        }
+    });
+    std::sort(lines.begin(), lines.end());
+    return lines;
+}
+
+bool RestoreInto(const std::string& path, SnapshotServices& services)
+{
+    SnapshotRestoreStats stats;
+    if (!services.snapshot.Restore(path, stats))
+    {
+        std::cerr << "Error: Unable to restore " << path << std::endl;
+        return false;
+    }
+    std::cout << "Restored " << stats.snapshotRecords << " records from " << path << std::endl;
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <snapshot> [other snapshot]" << std::endl;
+        return 1;
+    }
+
+    SnapshotServices first;
+    if (!RestoreInto(argv[1], first)) return 1;
+    std::string otherPath = (argc == 3) ? argv[2] : std::string(argv[1]) + ".check";
+    if (argc == 2 && !first.snapshot.Save(otherPath)) return 1;
+    SnapshotServices second;
+    if (!RestoreInto(otherPath, second)) return 1;
+
+    std::vector<std::string> expected = DescribeState(first);
+    std::vector<std::string> actual = DescribeState(second);
+    std::vector<std::string> missing;
+    std::vector<std::string> extra;
+    std::set_difference(expected.begin(), expected.end(), actual.begin(), actual.end(), std::back_inserter(missing));
+    std::set_difference(actual.begin(), actual.end(), expected.begin(), expected.end(), std::back_inserter(extra));
+    for (const auto& line : missing) std::cout << "  - " << line << std::endl;
+    for (const auto& line : extra) std::cout << "  + " << line << std::endl;
+    if (!missing.empty() || !extra.empty())
+    {
+        std::cerr << "Error: " << missing.size() + extra.size() << " of " << expected.size()
+                  << " state lines differ" << std::endl;
+        return 1;
+    }
+    std::cout << expected.size() << " state lines match" << std::endl;
+    return 0;
+}
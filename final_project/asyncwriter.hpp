@@ -0,0 +1,240 @@
+/**
+ * asyncwriter.hpp
+ * Defines a background writer thread that drains records from a bounded
+ * SPSC ring buffer and formats them into a BufferedFileWriter, so the
+ * publishing service does not block on disk.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef ASYNC_WRITER_HPP
+#define ASYNC_WRITER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include "bufferedwriter.hpp"
+#include "ringbuffer.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// What an enqueue does when the ring buffer is full
+enum class OverflowPolicy
+{
+    BLOCK,  // wait for the writer thread to make room (counted as a stall)
+    DROP    // discard the record (counted as a drop)
+};
+
+// Default number of records the ring buffer can hold
+constexpr size_t DEFAULT_ASYNC_QUEUE_CAPACITY = 1 << 14;
+
+/**
+ * Back-pressure counters for an AsyncRecordWriter.
+ */
+struct AsyncWriterStats
+{
+    size_t enqueued = 0;       // records accepted into the queue
+    size_t written = 0;        // records formatted by the writer thread
+    size_t highWaterMark = 0;  // deepest the queue has been
+    size_t stalls = 0;         // enqueues that had to wait for space
+    size_t drops = 0;          // records discarded because the queue was full
+};
+
+/**
+ * A record captured on the producer side: the event time plus a copy of the
+ * value, so formatting can happen later on the writer thread.
+ */
+template <typename V>
+struct TimestampedRecord
+{
+    ptime timestamp;
+    V data;
+};
+
+/**
+ * AsyncRecordWriter
+ * Owns a writer thread that pops records of type R and passes each to the
+ * format callback together with the output file. The writer thread flushes
+ * the file when the queue has been idle for a while, on Drain() and on
+ * Stop(). Only one thread may call Enqueue, and Drain from that thread.
+ */
+template <typename R>
+class AsyncRecordWriter
+{
+public:
+    using Formatter = function<void(const R&, BufferedFileWriter&)>;
+
+    AsyncRecordWriter(BufferedFileWriter& _output, Formatter _format,
+                      size_t _capacity = DEFAULT_ASYNC_QUEUE_CAPACITY,
+                      OverflowPolicy _overflow = OverflowPolicy::BLOCK);
+
+    // Drains the queue and joins the writer thread
+    ~AsyncRecordWriter();
+
+    AsyncRecordWriter(const AsyncRecordWriter&) = delete;
+    AsyncRecordWriter& operator=(const AsyncRecordWriter&) = delete;
+
+    // Hand a record to the writer thread; returns false if it was dropped
+    bool Enqueue(R&& record);
+
+    // Wait until everything enqueued so far is written and flushed to the file
+    void Drain();
+
+    // Stop accepting work, write out everything queued and flush the file
+    void Stop();
+
+    // Snapshot of the back-pressure counters
+    AsyncWriterStats GetStats() const;
+
+    // Records queued but not yet formatted; safe to read from any thread
+    size_t GetQueueDepth() const;
+
+private:
+    void Run();
+
+    BufferedFileWriter& output;
+    Formatter format;
+    OverflowPolicy overflow;
+    SPSCQueue<R> queue;
+    thread worker;
+    atomic<bool> running;
+
+    // Producer-side counters
+    size_t enqueued;
+    size_t highWaterMark;
+    size_t stalls;
+    size_t drops;
+
+    // Consumer-side counter
+    atomic<size_t> written;
+
+    // Drain requests made, and the last one the writer thread has flushed
+    atomic<size_t> flushRequests;
+    atomic<size_t> flushesDone;
+};
+
+// -------------------- Implementation of AsyncRecordWriter<R> --------------------
+
+template <typename R>
+AsyncRecordWriter<R>::AsyncRecordWriter(BufferedFileWriter& _output, Formatter _format,
+                                        size_t _capacity, OverflowPolicy _overflow)
+    : output(_output), format(std::move(_format)), overflow(_overflow), queue(_capacity),
+      running(true), enqueued(0), highWaterMark(0), stalls(0), drops(0), written(0),
+      flushRequests(0), flushesDone(0)
+{
+    worker = thread(&AsyncRecordWriter<R>::Run, this);
+}
+
+template <typename R>
+AsyncRecordWriter<R>::~AsyncRecordWriter()
+{
+    Stop();
+}
+
+template <typename R>
+bool AsyncRecordWriter<R>::Enqueue(R&& record)
+{
+    if (!queue.TryPush(std::move(record)))
+    {
+        if (overflow == OverflowPolicy::DROP)
+        {
+            ++drops;
+            return false;
+        }
+        ++stalls;
+        while (!queue.TryPush(std::move(record)))
+        {
+            this_thread::yield();
+        }
+    }
+    ++enqueued;
+    highWaterMark = max(highWaterMark, queue.Size());
+    return true;
+}
+
+template <typename R>
+void AsyncRecordWriter<R>::Drain()
+{
+    // Everything enqueued is already in the queue, so a flush the writer
+    // thread makes once it has emptied the queue covers all of it
+    if (!worker.joinable()) return;
+    size_t request = flushRequests.fetch_add(1, memory_order_acq_rel) + 1;
+    while (flushesDone.load(memory_order_acquire) < request)
+    {
+        this_thread::yield();
+    }
+}
+
+template <typename R>
+void AsyncRecordWriter<R>::Stop()
+{
+    if (!worker.joinable()) return;
+    running.store(false, memory_order_release);
+    worker.join();
+    output.Flush();
+}
+
+template <typename R>
+AsyncWriterStats AsyncRecordWriter<R>::GetStats() const
+{
+    AsyncWriterStats stats;
+    stats.enqueued = enqueued;
+    stats.written = written.load(memory_order_relaxed);
+    stats.highWaterMark = highWaterMark;
+    stats.stalls = stalls;
+    stats.drops = drops;
+    return stats;
+}
+
+template <typename R>
+size_t AsyncRecordWriter<R>::GetQueueDepth() const
+{
+    return queue.Size();
+}
+
+template <typename R>
+void AsyncRecordWriter<R>::Run()
+{
+    R record;
+    int idleSpins = 0;
+    while (true)
+    {
+        if (queue.TryPop(record))
+        {
+            format(record, output);
+            written.fetch_add(1, memory_order_relaxed);
+            idleSpins = 0;
+            continue;
+        }
+
+        // Queue is empty: answer any drain request with a flush
+        size_t requested = flushRequests.load(memory_order_acquire);
+        if (requested != flushesDone.load(memory_order_relaxed))
+        {
+            output.Flush();
+            flushesDone.store(requested, memory_order_release);
+            idleSpins = 0;
+            continue;
+        }
+
+        // Exit once stopped, otherwise back off
+        if (!running.load(memory_order_acquire))
+        {
+            if (queue.Size() == 0) break;
+            continue;
+        }
+        ++idleSpins;
+        if (idleSpins < 64)
+        {
+            this_thread::yield();
+            continue;
+        }
+
+        // Idle for a while: make what we have written visible, then sleep
+        if (idleSpins == 64) output.Flush();
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+}
+
+#endif // ASYNC_WRITER_HPP
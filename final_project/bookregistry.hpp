@@ -0,0 +1,119 @@
+/**
+ * bookregistry.hpp
+ * Defines the process-wide BookRegistry, which interns book names (TRSY1,
+ * TRSY2, ...) into small indices for the per-book arrays of Position.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef BOOK_REGISTRY_HPP
+#define BOOK_REGISTRY_HPP
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+// Interned book index handed out by the BookRegistry
+typedef uint8_t BookIndex;
+
+// Upper bound on distinct books (TRSY1, TRSY2, ...) in one process
+constexpr size_t MAX_BOOKS = 8;
+
+// Index of a book name that was never interned
+constexpr BookIndex INVALID_BOOK_INDEX = UINT8_MAX;
+
+/**
+ * BookRegistry
+ * Process-wide table assigning each book name a stable index 0, 1, 2, ...
+ * in order of first use, so positions can hold per-book quantities in a
+ * fixed array. Registration is serialised; looking up an already published
+ * name is a lock-free scan of at most MAX_BOOKS entries. Once the table is
+ * full a new name gets no index, and callers skip it rather than fail: the
+ * trade connector rejects trades in such a book with a logged error.
+ */
+class BookRegistry
+{
+public:
+    // The single registry shared by all positions
+    static BookRegistry& Instance();
+
+    // Index for the book, registering it if it is new; INVALID_BOOK_INDEX
+    // if it is new and all MAX_BOOKS indices are taken
+    BookIndex Intern(string_view book);
+
+    // Index for the book, or INVALID_BOOK_INDEX if unknown
+    BookIndex Find(string_view book) const;
+
+    // Book name registered at an index
+    const string& GetBook(BookIndex index) const;
+
+    // Number of registered books
+    size_t Size() const;
+
+private:
+    BookRegistry();
+
+    mutex registryMutex;
+    array<string, MAX_BOOKS> books;
+    atomic<size_t> bookCount;
+};
+
+// -------------------- Implementation of BookRegistry --------------------
+
+BookRegistry& BookRegistry::Instance()
+{
+    static BookRegistry registry;
+    return registry;
+}
+
+BookRegistry::BookRegistry()
+    : bookCount(0)
+{
+}
+
+BookIndex BookRegistry::Intern(string_view book)
+{
+    BookIndex index = Find(book);
+    if (index != INVALID_BOOK_INDEX) return index;
+
+    lock_guard<mutex> lock(registryMutex);
+    index = Find(book);
+    if (index != INVALID_BOOK_INDEX) return index;
+
+    size_t count = bookCount.load(memory_order_relaxed);
+    if (count >= MAX_BOOKS) return INVALID_BOOK_INDEX;
+    books[count] = string(book);
+    bookCount.store(count + 1, memory_order_release);
+    return static_cast<BookIndex>(count);
+}
+
+BookIndex BookRegistry::Find(string_view book) const
+{
+    size_t count = bookCount.load(memory_order_acquire);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (books[i] == book) return static_cast<BookIndex>(i);
+    }
+    return INVALID_BOOK_INDEX;
+}
+
+const string& BookRegistry::GetBook(BookIndex index) const
+{
+    if (index >= bookCount.load(memory_order_acquire))
+    {
+        throw out_of_range("Unknown book index");
+    }
+    return books[index];
+}
+
+size_t BookRegistry::Size() const
+{
+    return bookCount.load(memory_order_acquire);
+}
+
+#endif // BOOK_REGISTRY_HPP
@@ -0,0 +1,187 @@
+/**
+ * bufferedwriter.hpp
+ * Defines a long-lived, buffered output file used by the publishing
+ * connectors, so records are not written with one open/flush/close each.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef BUFFERED_WRITER_HPP
+#define BUFFERED_WRITER_HPP
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "utility.hpp"
+
+using namespace std;
+
+/**
+ * When a BufferedFileWriter hands its buffer to the file.
+ * The buffer is always flushed on Flush() and when the writer is destroyed.
+ */
+struct FlushPolicy
+{
+    // Flush once this many bytes are buffered (0 = flush every record)
+    size_t maxBufferedBytes = 64 * 1024;
+
+    // Flush after this many records (0 = no record limit)
+    size_t maxBufferedRecords = 0;
+};
+
+/**
+ * BufferedFileWriter
+ * Keeps one output file open in append mode and batches records in memory,
+ * writing them out according to its FlushPolicy.
+ */
+class BufferedFileWriter
+{
+public:
+    explicit BufferedFileWriter(const string& _path, FlushPolicy _policy = FlushPolicy());
+    ~BufferedFileWriter();
+
+    BufferedFileWriter(const BufferedFileWriter&) = delete;
+    BufferedFileWriter& operator=(const BufferedFileWriter&) = delete;
+
+    // Whether the output file is open
+    bool IsOpen() const;
+
+    // Path of the output file
+    const string& GetPath() const;
+
+    // Size of the file in bytes when it was opened
+    size_t GetInitialSize() const;
+
+    // Append bytes to the current record
+    void Write(string_view text);
+    void Write(char c);
+
+    // Mark the end of a record and flush if the policy says so
+    void EndRecord();
+
+    // Write all buffered bytes to the file
+    void Flush();
+
+    // Hold policy flushes until the matching EndBatch, so a batch of
+    // records reaches the file in one write; batches may nest
+    void BeginBatch();
+    void EndBatch();
+
+private:
+    string path;
+    FlushPolicy policy;
+    ofstream file;
+    string buffer;
+    size_t bufferedRecords;
+    size_t initialSize;
+    size_t batchDepth;
+};
+
+// -------------------- Implementation of BufferedFileWriter --------------------
+
+BufferedFileWriter::BufferedFileWriter(const string& _path, FlushPolicy _policy)
+    : path(_path), policy(_policy), bufferedRecords(0), initialSize(0), batchDepth(0)
+{
+    // Our own buffer batches the writes, so the stream does not need one
+    file.rdbuf()->pubsetbuf(nullptr, 0);
+    file.open(path, ios::app);
+    if (!file.is_open())
+    {
+        cerr << "Error: Unable to open file " << path << "\n";
+    }
+    else
+    {
+        file.seekp(0, ios::end);
+        initialSize = static_cast<size_t>(file.tellp());
+    }
+    buffer.reserve(policy.maxBufferedBytes + 1024);
+}
+
+BufferedFileWriter::~BufferedFileWriter()
+{
+    Flush();
+}
+
+bool BufferedFileWriter::IsOpen() const
+{
+    return file.is_open();
+}
+
+const string& BufferedFileWriter::GetPath() const
+{
+    return path;
+}
+
+size_t BufferedFileWriter::GetInitialSize() const
+{
+    return initialSize;
+}
+
+void BufferedFileWriter::Write(string_view text)
+{
+    buffer.append(text.data(), text.size());
+}
+
+void BufferedFileWriter::Write(char c)
+{
+    buffer.push_back(c);
+}
+
+void BufferedFileWriter::EndRecord()
+{
+    ++bufferedRecords;
+    if (batchDepth != 0) return;
+    if (buffer.size() >= policy.maxBufferedBytes ||
+        (policy.maxBufferedRecords != 0 && bufferedRecords >= policy.maxBufferedRecords))
+    {
+        Flush();
+    }
+}
+
+void BufferedFileWriter::Flush()
+{
+    if (!buffer.empty() && file.is_open())
+    {
+        file.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        file.flush();
+    }
+    buffer.clear();
+    bufferedRecords = 0;
+}
+
+void BufferedFileWriter::BeginBatch()
+{
+    ++batchDepth;
+}
+
+void BufferedFileWriter::EndBatch()
+{
+    if (batchDepth == 0 || --batchDepth != 0) return;
+    if (buffer.size() >= policy.maxBufferedBytes ||
+        (policy.maxBufferedRecords != 0 && bufferedRecords >= policy.maxBufferedRecords))
+    {
+        Flush();
+    }
+}
+
+/**
+ * Write one "timestamp,field1,field2,...," text record for any value type
+ * that provides PrintFunction().
+ */
+template <typename V>
+void WriteTextRecord(const ptime& timestamp, const V& dataObj, BufferedFileWriter& output)
+{
+    output.Write(boost::posix_time::to_simple_string(timestamp));
+    output.Write(',');
+    vector<string> dataFields = dataObj.PrintFunction();
+    for (auto& field : dataFields)
+    {
+        output.Write(field);
+        output.Write(',');
+    }
+    output.Write('\n');
+    output.EndRecord();
+}
+
+#endif // BUFFERED_WRITER_HPP
@@ -0,0 +1,331 @@
+/**
+ * conflation.hpp
+ * Defines a last-value-wins conflation stage. A Conflator keeps, per
+ * product (or once for all products), at most one pending value and lets a
+ * value through only once the configured interval has passed since the
+ * previous one; values arriving in between replace the pending one, so a
+ * burst is published as its latest value. ConflatingListener puts a
+ * Conflator between a service and its listeners.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef CONFLATION_HPP
+#define CONFLATION_HPP
+
+#include <chrono>
+#include <vector>
+#include "productregistry.hpp"
+#include "soa.hpp"
+
+using namespace std;
+
+// Whether conflation intervals are tracked per product or across all of them
+enum class ConflationScope
+{
+    PER_PRODUCT,  // each product publishes at most once per interval
+    GLOBAL        // at most one value per interval across every product
+};
+
+// Slot key used for every value under ConflationScope::GLOBAL
+constexpr ProductIndex GLOBAL_SLOT = INVALID_PRODUCT_INDEX;
+
+/**
+ * How often a Conflator publishes. A zero interval passes every value
+ * straight through.
+ */
+struct ConflationPolicy
+{
+    chrono::nanoseconds interval = chrono::nanoseconds(0);
+    ConflationScope scope = ConflationScope::PER_PRODUCT;
+
+    // At most maxPerSecond values per second (per product, or in total)
+    static ConflationPolicy MaxRate(double maxPerSecond,
+                                    ConflationScope scope = ConflationScope::PER_PRODUCT);
+};
+
+/**
+ * Counters of a Conflator.
+ */
+struct ConflationStats
+{
+    size_t offered = 0;     // values passed to Offer
+    size_t published = 0;   // values let through
+    size_t conflated = 0;   // values replaced by a newer one before publication
+};
+
+/**
+ * Conflator
+ * Last-value-wins rate limiter for values of type V, keyed on
+ * V::GetProduct(). Offer publishes a value at once if its slot is due and
+ * otherwise holds it as the slot's pending value; PublishDue releases
+ * pending values whose interval has since passed, and PublishAll releases
+ * every pending value (e.g. at the end of a feed). Not thread-safe.
+ */
+template <typename V>
+class Conflator
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    explicit Conflator(ConflationPolicy _policy = ConflationPolicy());
+
+    const ConflationPolicy& GetPolicy() const;
+
+    // Publish data through publish(V&) now, or hold it until its slot is due
+    template <typename Publish>
+    void Offer(V& data, Publish&& publish, Clock::time_point now = Clock::now());
+
+    // Publish every pending value whose slot is due; returns how many
+    template <typename Publish>
+    size_t PublishDue(Publish&& publish, Clock::time_point now = Clock::now());
+
+    // Publish every pending value regardless of the interval
+    template <typename Publish>
+    size_t PublishAll(Publish&& publish, Clock::time_point now = Clock::now());
+
+    ConflationStats GetStats() const;
+
+private:
+    struct Slot
+    {
+        V pending;
+        bool hasPending = false;
+        bool hasPublished = false;
+        Clock::time_point lastPublished;
+    };
+
+    // Slot key of a value: its product, or GLOBAL_SLOT
+    ProductIndex GetKey(const V& data) const;
+    Slot& GetSlot(ProductIndex key);
+    bool IsDue(const Slot& slot, Clock::time_point now) const;
+
+    template <typename Publish>
+    void PublishSlot(Slot& slot, V& data, Publish&& publish, Clock::time_point now);
+
+    ConflationPolicy policy;
+    ProductStore<Slot> productSlots;
+    Slot globalSlot;
+    vector<ProductIndex> pendingKeys;
+    ConflationStats stats;
+};
+
+/**
+ * ConflatingListener
+ * A listener that conflates what a service publishes before passing it to
+ * its own listeners. Each incoming value or batch also releases held values
+ * that have become due; Poll does so without a new value, and Flush
+ * releases all of them (e.g. at the end of a feed).
+ */
+template <typename V>
+class ConflatingListener : public ServiceListener<V>
+{
+public:
+    explicit ConflatingListener(ConflationPolicy _policy);
+
+    // Downstream listeners receiving the conflated values
+    void AddListener(ServiceListener<V>* listener);
+    const vector<ServiceListener<V>*>& GetListeners() const;
+
+    void ProcessAdd(V& data) override;
+    void ProcessRemove(V& data) override;
+    void ProcessUpdate(V& data) override;
+    void ProcessAddBatch(Span<V> batch) override;
+
+    // Release held values whose interval has passed; returns how many
+    size_t Poll();
+
+    // Release every held value
+    size_t Flush();
+
+    ConflationStats GetStats() const;
+
+private:
+    Conflator<V> conflator;
+    vector<ServiceListener<V>*> listeners;
+};
+
+// -------------------- Implementation of ConflationPolicy --------------------
+
+ConflationPolicy ConflationPolicy::MaxRate(double maxPerSecond, ConflationScope scope)
+{
+    ConflationPolicy policy;
+    policy.scope = scope;
+    if (maxPerSecond > 0.0)
+    {
+        policy.interval = chrono::duration_cast<chrono::nanoseconds>(
+            chrono::duration<double>(1.0 / maxPerSecond));
+    }
+    return policy;
+}
+
+// -------------------- Implementation of Conflator<V> --------------------
+
+template <typename V>
+Conflator<V>::Conflator(ConflationPolicy _policy)
+    : policy(_policy)
+{
+}
+
+template <typename V>
+const ConflationPolicy& Conflator<V>::GetPolicy() const
+{
+    return policy;
+}
+
+template <typename V>
+template <typename Publish>
+void Conflator<V>::Offer(V& data, Publish&& publish, Clock::time_point now)
+{
+    ++stats.offered;
+    ProductIndex key = GetKey(data);
+    Slot& slot = GetSlot(key);
+    if (IsDue(slot, now))
+    {
+        // The new value supersedes anything still pending in the slot
+        if (slot.hasPending) ++stats.conflated;
+        PublishSlot(slot, data, publish, now);
+        return;
+    }
+
+    if (slot.hasPending) ++stats.conflated;
+    else pendingKeys.push_back(key);
+    slot.pending = data;
+    slot.hasPending = true;
+}
+
+template <typename V>
+template <typename Publish>
+size_t Conflator<V>::PublishDue(Publish&& publish, Clock::time_point now)
+{
+    size_t count = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingKeys.size(); ++i)
+    {
+        Slot& slot = GetSlot(pendingKeys[i]);
+        if (!slot.hasPending) continue;
+        if (!IsDue(slot, now))
+        {
+            pendingKeys[kept++] = pendingKeys[i];
+            continue;
+        }
+        PublishSlot(slot, slot.pending, publish, now);
+        ++count;
+    }
+    pendingKeys.resize(kept);
+    return count;
+}
+
+template <typename V>
+template <typename Publish>
+size_t Conflator<V>::PublishAll(Publish&& publish, Clock::time_point now)
+{
+    size_t count = 0;
+    for (ProductIndex key : pendingKeys)
+    {
+        Slot& slot = GetSlot(key);
+        if (!slot.hasPending) continue;
+        PublishSlot(slot, slot.pending, publish, now);
+        ++count;
+    }
+    pendingKeys.clear();
+    return count;
+}
+
+template <typename V>
+ConflationStats Conflator<V>::GetStats() const
+{
+    return stats;
+}
+
+template <typename V>
+ProductIndex Conflator<V>::GetKey(const V& data) const
+{
+    if (policy.scope == ConflationScope::GLOBAL) return GLOBAL_SLOT;
+    return data.GetProduct().GetProductIndex();
+}
+
+template <typename V>
+typename Conflator<V>::Slot& Conflator<V>::GetSlot(ProductIndex key)
+{
+    return (key == GLOBAL_SLOT) ? globalSlot : productSlots[key];
+}
+
+template <typename V>
+bool Conflator<V>::IsDue(const Slot& slot, Clock::time_point now) const
+{
+    return !slot.hasPublished || now - slot.lastPublished >= policy.interval;
+}
+
+template <typename V>
+template <typename Publish>
+void Conflator<V>::PublishSlot(Slot& slot, V& data, Publish&& publish, Clock::time_point now)
+{
+    slot.hasPending = false;
+    slot.hasPublished = true;
+    slot.lastPublished = now;
+    ++stats.published;
+    publish(data);
+}
+
+// -------------------- Implementation of ConflatingListener<V> --------------------
+
+template <typename V>
+ConflatingListener<V>::ConflatingListener(ConflationPolicy _policy)
+    : conflator(_policy)
+{
+}
+
+template <typename V>
+void ConflatingListener<V>::AddListener(ServiceListener<V>* listener)
+{
+    listeners.push_back(listener);
+}
+
+template <typename V>
+const vector<ServiceListener<V>*>& ConflatingListener<V>::GetListeners() const
+{
+    return listeners;
+}
+
+template <typename V>
+void ConflatingListener<V>::ProcessAdd(V& data)
+{
+    ListenerSink<V> sink(listeners);
+    conflator.Offer(data, sink);
+    conflator.PublishDue(sink);
+}
+
+template <typename V>
+void ConflatingListener<V>::ProcessAddBatch(Span<V> batch)
+{
+    ListenerSink<V> sink(listeners);
+    auto now = Conflator<V>::Clock::now();
+    for (V& data : batch) conflator.Offer(data, sink, now);
+    conflator.PublishDue(sink, now);
+}
+
+template <typename V>
+void ConflatingListener<V>::ProcessRemove(V& /*data*/) {}
+
+template <typename V>
+void ConflatingListener<V>::ProcessUpdate(V& /*data*/) {}
+
+template <typename V>
+size_t ConflatingListener<V>::Poll()
+{
+    return conflator.PublishDue(ListenerSink<V>(listeners));
+}
+
+template <typename V>
+size_t ConflatingListener<V>::Flush()
+{
+    return conflator.PublishAll(ListenerSink<V>(listeners));
+}
+
+template <typename V>
+ConflationStats ConflatingListener<V>::GetStats() const
+{
+    return conflator.GetStats();
+}
+
+#endif // CONFLATION_HPP
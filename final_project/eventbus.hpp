@@ -0,0 +1,227 @@
+/**
+ * eventbus.hpp
+ * Defines an optional event bus layer over the ServiceListener API. A
+ * listener can be connected to a service "inline", the usual synchronous
+ * ProcessAdd on the publisher's stack, or "queued": the service then calls
+ * a QueuedListener, which copies each message into a bounded lock-free ring
+ * (SPSC, or MPSC when several services feed the same listener), and a
+ * consumer thread later drains the ring in batches into the real listener.
+ * Queued edges are registered with the ordinary Service::AddListener, so
+ * services need no changes to take part.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef EVENT_BUS_HPP
+#define EVENT_BUS_HPP
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "ringbuffer.hpp"
+#include "soa.hpp"
+
+using namespace std;
+
+// Default number of messages a queued edge can hold before producers wait
+constexpr size_t DEFAULT_HANDOFF_CAPACITY = 1 << 12;
+
+// How a listener connected through the EventBus receives messages
+enum class Delivery
+{
+    INLINE,  // called synchronously by the publishing service
+    QUEUED   // called later on the thread that drains the edge
+};
+
+/**
+ * HandoffInput
+ * Consumer-side view of a queued edge, polled by the thread that owns the
+ * edge's listener.
+ */
+class HandoffInput
+{
+public:
+    virtual ~HandoffInput() = default;
+
+    // Forward queued messages on the calling thread; returns how many
+    virtual size_t Drain() = 0;
+
+    // Producer side: one producer will publish no more messages
+    virtual void Close() = 0;
+
+    // Every producer has closed and the edge is fully drained
+    virtual bool IsFinished() const = 0;
+
+    // Messages queued but not yet drained
+    virtual size_t GetDepth() const = 0;
+};
+
+/**
+ * QueuedListener
+ * A listener registered on one or more services running on producer
+ * threads. Each ProcessAdd copies the message into a ring Q (SPSCQueue<V>
+ * for one producer, MPSCQueue<V> for several), waiting for room if it is
+ * full. Drain, called on the consumer thread, passes up to one ring's worth
+ * of messages to the target listener in order, in place in the ring.
+ * Remove and update events are not carried.
+ */
+template <typename V, typename Q = SPSCQueue<V>>
+class QueuedListener : public ServiceListener<V>, public HandoffInput
+{
+public:
+    QueuedListener(ServiceListener<V>* _target,
+                   size_t _capacity = DEFAULT_HANDOFF_CAPACITY,
+                   size_t _producers = 1);
+
+    // Producer side
+    void ProcessAdd(V& data) override;
+    void ProcessRemove(V& data) override;
+    void ProcessUpdate(V& data) override;
+    void Close() override;
+
+    // Consumer side
+    size_t Drain() override;
+    bool IsFinished() const override;
+    size_t GetDepth() const override;
+
+    // Number of ProcessAdd calls that had to wait for room
+    size_t GetStalls() const;
+
+private:
+    ServiceListener<V>* target;
+    Q queue;
+    size_t producers;
+    atomic<size_t> closedProducers;
+    atomic<size_t> stalls;
+};
+
+// A single-producer edge, as used between two threads
+template <typename V>
+using HandoffListener = QueuedListener<V, SPSCQueue<V>>;
+
+// An edge shared by several producer threads
+template <typename V>
+using SharedHandoffListener = QueuedListener<V, MPSCQueue<V>>;
+
+// -------------------- Implementation of QueuedListener<V, Q> --------------------
+
+template <typename V, typename Q>
+QueuedListener<V, Q>::QueuedListener(ServiceListener<V>* _target, size_t _capacity,
+                                     size_t _producers)
+    : target(_target), queue(_capacity), producers(_producers), closedProducers(0), stalls(0)
+{
+}
+
+template <typename V, typename Q>
+void QueuedListener<V, Q>::ProcessAdd(V& data)
+{
+    if (queue.TryPush(data)) return;
+    stalls.fetch_add(1, memory_order_relaxed);
+    while (!queue.TryPush(data))
+    {
+        this_thread::yield();
+    }
+}
+
+template <typename V, typename Q>
+void QueuedListener<V, Q>::ProcessRemove(V& /*data*/) {}
+
+template <typename V, typename Q>
+void QueuedListener<V, Q>::ProcessUpdate(V& /*data*/) {}
+
+template <typename V, typename Q>
+void QueuedListener<V, Q>::Close()
+{
+    closedProducers.fetch_add(1, memory_order_release);
+}
+
+template <typename V, typename Q>
+size_t QueuedListener<V, Q>::Drain()
+{
+    ServiceListener<V>* listener = target;
+    return queue.ConsumeBatch([listener](V& data) { listener->ProcessAdd(data); },
+                              queue.Capacity());
+}
+
+template <typename V, typename Q>
+bool QueuedListener<V, Q>::IsFinished() const
+{
+    // Every push happens before its producer's Close, so closed-then-empty means drained
+    return closedProducers.load(memory_order_acquire) >= producers && queue.Size() == 0;
+}
+
+template <typename V, typename Q>
+size_t QueuedListener<V, Q>::GetDepth() const
+{
+    return queue.Size();
+}
+
+template <typename V, typename Q>
+size_t QueuedListener<V, Q>::GetStalls() const
+{
+    return stalls.load(memory_order_relaxed);
+}
+
+/**
+ * EventBus
+ * Connects listeners to services, inline or queued, and owns the queued
+ * edges it creates. Connect returns the edge to drain (nullptr when
+ * inline), and GetQueuedEdges lists every edge for a consumer stage.
+ */
+class EventBus
+{
+public:
+    // Connect a listener to one service
+    template <typename K, typename V>
+    HandoffInput* Connect(Service<K, V>& source, ServiceListener<V>* listener,
+                          Delivery delivery = Delivery::INLINE,
+                          size_t capacity = DEFAULT_HANDOFF_CAPACITY);
+
+    // Connect a listener to several services through one shared MPSC edge
+    template <typename V, typename... Sources>
+    HandoffInput* ConnectShared(ServiceListener<V>* listener, size_t capacity,
+                                Sources&... sources);
+
+    // Every queued edge, in creation order
+    const vector<HandoffInput*>& GetQueuedEdges() const;
+
+private:
+    vector<unique_ptr<HandoffInput>> ownedEdges;
+    vector<HandoffInput*> queuedEdges;
+};
+
+// -------------------- Implementation of EventBus --------------------
+
+template <typename K, typename V>
+HandoffInput* EventBus::Connect(Service<K, V>& source, ServiceListener<V>* listener,
+                                Delivery delivery, size_t capacity)
+{
+    if (delivery == Delivery::INLINE)
+    {
+        source.AddListener(listener);
+        return nullptr;
+    }
+    auto* edge = new HandoffListener<V>(listener, capacity);
+    ownedEdges.emplace_back(edge);
+    queuedEdges.push_back(edge);
+    source.AddListener(edge);
+    return edge;
+}
+
+template <typename V, typename... Sources>
+HandoffInput* EventBus::ConnectShared(ServiceListener<V>* listener, size_t capacity,
+                                      Sources&... sources)
+{
+    auto* edge = new SharedHandoffListener<V>(listener, capacity, sizeof...(Sources));
+    ownedEdges.emplace_back(edge);
+    queuedEdges.push_back(edge);
+    (sources.AddListener(edge), ...);
+    return edge;
+}
+
+const vector<HandoffInput*>& EventBus::GetQueuedEdges() const
+{
+    return queuedEdges;
+}
+
+#endif // EVENT_BUS_HPP
@@ -28,33 +28,33 @@ class ExecutionOrder
 public:
     // Constructors
     ExecutionOrder() = default;
-    ExecutionOrder(const T& prod, PricingSide ps, std::string oid,
-                   OrderType ot, double pr, double visQty, double hidQty,
-                   std::string parentOid, bool childFlag);
+    ExecutionOrder(const T& prod, PricingSide ps, std::string_view oid,
+                   OrderType ot, Tick256 pr, double visQty, double hidQty,
+                   std::string_view parentOid, bool childFlag);
 
     // Accessors
     const T& GetProduct() const;
     PricingSide GetPricingSide() const;
-    const std::string& GetOrderId() const;
+    std::string_view GetOrderId() const;
     OrderType GetOrderType() const;
-    double GetPrice() const;
+    Tick256 GetPrice() const;
     long GetVisibleQuantity() const;
     long GetHiddenQuantity() const;
-    const std::string& GetParentOrderId() const;
+    std::string_view GetParentOrderId() const;
     bool IsChildOrder() const;
 
     // Generate a list of string fields for printing/logging
     std::vector<std::string> PrintFunction() const;
 
 private:
-    T product;
+    ProductRef<T> product;
     PricingSide side;
-    std::string orderId;
+    OrderId orderId;
     OrderType orderType;
-    double price;
+    Tick256 price;
     long visibleQuantity;
     long hiddenQuantity;
-    std::string parentOrderId;
+    OrderId parentOrderId;
     bool isChildOrder;
 };
 
@@ -62,9 +62,9 @@ private:
 
 template <typename T>
 ExecutionOrder<T>::ExecutionOrder(const T& prod, PricingSide ps,
-                                  std::string oid, OrderType ot,
-                                  double pr, double visQty, double hidQty,
-                                  std::string parentOid, bool childFlag)
+                                  std::string_view oid, OrderType ot,
+                                  Tick256 pr, double visQty, double hidQty,
+                                  std::string_view parentOid, bool childFlag)
     : product(prod)
 {
     side           = ps;
@@ -80,7 +80,7 @@ ExecutionOrder<T>::ExecutionOrder(const T& prod, PricingSide ps,
 template <typename T>
 const T& ExecutionOrder<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
 }
 
 template <typename T>
@@ -90,9 +90,9 @@ PricingSide ExecutionOrder<T>::GetPricingSide() const
 }
 
 template <typename T>
-const std::string& ExecutionOrder<T>::GetOrderId() const
+std::string_view ExecutionOrder<T>::GetOrderId() const
 {
-    return orderId;
+    return orderId.View();
 }
 
 template <typename T>
@@ -102,7 +102,7 @@ OrderType ExecutionOrder<T>::GetOrderType() const
 }
 
 template <typename T>
-double ExecutionOrder<T>::GetPrice() const
+Tick256 ExecutionOrder<T>::GetPrice() const
 {
     return price;
 }
@@ -120,9 +120,9 @@ long ExecutionOrder<T>::GetHiddenQuantity() const
 }
 
 template <typename T>
-const std::string& ExecutionOrder<T>::GetParentOrderId() const
+std::string_view ExecutionOrder<T>::GetParentOrderId() const
 {
-    return parentOrderId;
+    return parentOrderId.View();
 }
 
 template <typename T>
@@ -135,9 +135,9 @@ template <typename T>
 std::vector<std::string> ExecutionOrder<T>::PrintFunction() const
 {
     // Convert internal data to string representations
-    std::string prodIdStr   = product.GetProductId();
+    std::string prodIdStr   = product.Get().GetProductId();
     std::string sideStr     = (side == BID) ? "BID" : "OFFER";
-    std::string oidStr      = orderId;
+    std::string oidStr(orderId.View());
 
     // Map the order type enum to string
     std::string otStr;
@@ -152,14 +152,14 @@ std::vector<std::string> ExecutionOrder<T>::PrintFunction() const
     }
 
     // Convert numeric fields
-    std::string priceStr = price2string(price);
+    std::string priceStr = price.ToString();
 
     // Convert quantity to string but ensure it's integral
     std::string visQtyStr = std::to_string(visibleQuantity);
     std::string hidQtyStr = std::to_string(hiddenQuantity);
 
     // Parent order ID and child flag
-    std::string parentStr = parentOrderId;
+    std::string parentStr(parentOrderId.View());
     std::string childFlagStr = isChildOrder ? "YES" : "NO";
 
     // Build the list of fields
@@ -10,6 +10,7 @@
 
 #include <string>
 #include "soa.hpp"
+#include "AlgoExecutionService.hpp"
 #include "execution.hpp"
 #include "marketdataservice.hpp"
 
@@ -47,8 +48,12 @@ public:
     // Execute an order upon receiving a request
     void ExecuteOrder(ExecutionOrder<T>& execOrder);
 
+    // As above, passing the order to sink(ExecutionOrder<T>&) instead of the listeners
+    template <typename Sink>
+    void ExecuteOrder(ExecutionOrder<T>& execOrder, Sink&& sink);
+
 private:
-    std::map<std::string, ExecutionOrder<T>> executionOrders;
+    ProductStore<ExecutionOrder<T>> executionOrders;
     std::vector<ServiceListener<ExecutionOrder<T>>*> listeners;
     ExecutionServiceListener<T>* listener;
 };
@@ -58,7 +63,7 @@ private:
 template<typename T>
 ExecutionService<T>::ExecutionService()
 {
-    executionOrders = std::map<std::string, ExecutionOrder<T>>();
+    executionOrders = ProductStore<ExecutionOrder<T>>();
     listeners       = std::vector<ServiceListener<ExecutionOrder<T>>*>();
     listener        = new ExecutionServiceListener<T>(this);
 }
@@ -66,14 +71,13 @@ ExecutionService<T>::ExecutionService()
 template<typename T>
 ExecutionOrder<T>& ExecutionService<T>::GetData(std::string id)
 {
-    return executionOrders[id];
+    return executionOrders.Get(id);
 }
 
 template<typename T>
 void ExecutionService<T>::OnMessage(ExecutionOrder<T>& dataObj)
 {
-    std::string prodId = dataObj.GetProduct().GetProductId();
-    executionOrders[prodId] = dataObj;
+    executionOrders[dataObj.GetProduct().GetProductIndex()] = dataObj;
 }
 
 template<typename T>
@@ -97,14 +101,17 @@ ExecutionServiceListener<T>* ExecutionService<T>::GetListener()
 template<typename T>
 void ExecutionService<T>::ExecuteOrder(ExecutionOrder<T>& execOrder)
 {
-    std::string prodId = execOrder.GetProduct().GetProductId();
-    executionOrders[prodId] = execOrder;
-
     // Notify all listeners
-    for (auto& ls : listeners)
-    {
-        ls->ProcessAdd(execOrder);
-    }
+    ExecuteOrder(execOrder, ListenerSink<ExecutionOrder<T>>(listeners));
+}
+
+template<typename T>
+template<typename Sink>
+void ExecutionService<T>::ExecuteOrder(ExecutionOrder<T>& execOrder, Sink&& sink)
+{
+    executionOrders[execOrder.GetProduct().GetProductIndex()] = execOrder;
+
+    sink(execOrder);
 }
 
 /**
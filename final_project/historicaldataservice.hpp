@@ -13,8 +13,11 @@
 #ifndef HISTORICAL_DATA_SERVICE_HPP
 #define HISTORICAL_DATA_SERVICE_HPP
 
+#include "asyncwriter.hpp"
+#include "bufferedwriter.hpp"
 #include "executionservice.hpp"
 #include "inquiryservice.hpp"
+#include "journal.hpp"
 #include "positionservice.hpp"
 #include "riskservice.hpp"
 #include "soa.hpp"
@@ -30,6 +33,38 @@
 template <typename V> class HistoricalDataConnector;
 template <typename V> class HistoricalDataListener;
 
+/**
+ * On-disk format of a historical data file.
+ */
+enum class HistoricalFormat
+{
+    TEXT,   // comma-separated lines, one per record
+    BINARY  // fixed-width journal records (see journal.hpp)
+};
+
+// Directory the historical files are written to unless one is given
+const std::string DEFAULT_OUTPUT_DIRECTORY = "Data/Output/";
+
+/**
+ * Map a historical service type to the output file it persists to, under
+ * directory. Unknown types fall back to "unknown"; binary journals use ".bin".
+ */
+std::string GetHistoricalFilePath(const std::string& serviceType,
+                                  HistoricalFormat format = HistoricalFormat::TEXT,
+                                  const std::string& directory = DEFAULT_OUTPUT_DIRECTORY)
+{
+    static const std::map<std::string, std::string> historicalFiles({
+        {"Position", "positions"},
+        {"Risk", "risk"},
+        {"Execution", "executions"},
+        {"Streaming", "streaming"},
+        {"Inquiry", "allinquiries"}
+    });
+    auto it = historicalFiles.find(serviceType);
+    std::string stem = directory + ((it != historicalFiles.end()) ? it->second : "unknown");
+    return stem + (format == HistoricalFormat::BINARY ? ".bin" : ".txt");
+}
+
 /**
  * HistoricalDataService
  * A service for processing and persisting historical data keyed by a string.
@@ -39,9 +74,12 @@ template <typename V>
 class HistoricalDataService : public Service<std::string, V>
 {
 public:
-    // Constructors
+    // Constructors / Destructor (flushes any buffered output)
     HistoricalDataService();
-    explicit HistoricalDataService(std::string _type);
+    explicit HistoricalDataService(std::string _type, FlushPolicy _policy = FlushPolicy(),
+                                   HistoricalFormat _format = HistoricalFormat::TEXT,
+                                   const std::string& _directory = DEFAULT_OUTPUT_DIRECTORY);
+    ~HistoricalDataService();
 
     // Retrieve data by key
     V& GetData(std::string key) override;
@@ -49,6 +87,9 @@ public:
     // Called by connector with new or updated data
     void OnMessage(V& dataObj) override;
 
+    // Store a batch of records, then pass it on to each listener at once
+    void OnMessageBatch(Span<V> batch) override;
+
     // Add a listener
     void AddListener(ServiceListener<V>* listenerPtr) override;
 
@@ -64,15 +105,45 @@ public:
     // Service type (e.g. "Position", "Risk", "Execution", "Streaming", "Inquiry")
     std::string GetServiceType() const;
 
+    // Text or binary journal output
+    HistoricalFormat GetFormat() const;
+
     // Persist data using the connector
     void PersistData(std::string persistKey, V& dataObj);
 
+    // Persist a batch of records under one timestamp; synchronously the
+    // whole batch is formatted first and reaches the file in one write
+    void PersistBatch(Span<V> batch);
+
+    // Output file writer, opened once for the service type
+    BufferedFileWriter& GetWriter();
+
+    // Write any buffered records to the output file; in async mode, wait for
+    // the writer thread to write and flush everything persisted so far
+    void Flush();
+
+    // Persist on a background writer thread fed through a bounded ring buffer
+    void EnableAsync(size_t queueCapacity = DEFAULT_ASYNC_QUEUE_CAPACITY,
+                     OverflowPolicy overflow = OverflowPolicy::BLOCK);
+
+    // Whether records are persisted by the background writer
+    bool IsAsync() const;
+
+    // Back-pressure counters of the background writer (all zero if synchronous)
+    AsyncWriterStats GetAsyncStats() const;
+
+    // Records waiting for the background writer (zero if synchronous)
+    size_t GetAsyncQueueDepth() const;
+
 private:
-    std::map<std::string, V> historicalDataMap;
+    ProductStore<V> historicalDataMap;
     std::vector<ServiceListener<V>*> serviceListeners;
     HistoricalDataConnector<V>* dataConnector;
     ServiceListener<V>* dataListener;
     std::string serviceType;
+    HistoricalFormat historicalFormat;
+    BufferedFileWriter* fileWriter;
+    AsyncRecordWriter<TimestampedRecord<V>>* asyncWriter;
 };
 
 // --------------------------------------------------------------------------
@@ -80,49 +151,82 @@ private:
 // --------------------------------------------------------------------------
 template <typename V>
 HistoricalDataService<V>::HistoricalDataService()
-    : historicalDataMap(),
-      serviceListeners(),
-      dataConnector(nullptr),
-      dataListener(nullptr),
-      serviceType("Position")
+    : HistoricalDataService("Position")
 {
-    // Initialize containers
-    historicalDataMap = std::map<std::string, V>();
-    serviceListeners = std::vector<ServiceListener<V>*>();
-
-    // Create connector and listener
-    dataConnector = new HistoricalDataConnector<V>(this);
-    dataListener = new HistoricalDataListener<V>(this);
 }
 
 template <typename V>
-HistoricalDataService<V>::HistoricalDataService(std::string _type)
+HistoricalDataService<V>::HistoricalDataService(std::string _type, FlushPolicy _policy,
+                                                HistoricalFormat _format, const std::string& _directory)
     : historicalDataMap(),
       serviceListeners(),
       dataConnector(nullptr),
       dataListener(nullptr),
-      serviceType(std::move(_type))
+      serviceType(std::move(_type)),
+      historicalFormat(_format),
+      fileWriter(nullptr),
+      asyncWriter(nullptr)
 {
     // Initialize containers
-    historicalDataMap = std::map<std::string, V>();
+    historicalDataMap = ProductStore<V>();
     serviceListeners = std::vector<ServiceListener<V>*>();
 
+    // Open the output file once for the lifetime of the service
+    fileWriter = new BufferedFileWriter(GetHistoricalFilePath(serviceType, historicalFormat, _directory), _policy);
+
+    // A new journal starts with its schema header
+    if (historicalFormat == HistoricalFormat::BINARY && fileWriter->IsOpen() &&
+        fileWriter->GetInitialSize() == 0)
+    {
+        JournalHeader header = MakeJournalHeader<V>();
+        fileWriter->Write(std::string_view(reinterpret_cast<const char*>(&header), sizeof(header)));
+        fileWriter->Flush();
+    }
+
     // Create connector and listener
     dataConnector = new HistoricalDataConnector<V>(this);
     dataListener = new HistoricalDataListener<V>(this);
 }
 
+template <typename V>
+HistoricalDataService<V>::~HistoricalDataService()
+{
+    // Drain the background writer before its output file goes away
+    delete asyncWriter;
+    delete fileWriter;
+}
+
 template <typename V>
 V& HistoricalDataService<V>::GetData(std::string key)
 {
-    return historicalDataMap[key];
+    return historicalDataMap.Get(key);
 }
 
 template <typename V>
 void HistoricalDataService<V>::OnMessage(V& dataObj)
 {
     // Store or update data in the map, keyed by the product ID
-    historicalDataMap[dataObj.GetProduct().GetProductId()] = dataObj;
+    historicalDataMap[dataObj.GetProduct().GetProductIndex()] = dataObj;
+
+    // Pass replayed records on to any downstream services
+    for (auto& ls : serviceListeners)
+    {
+        ls->ProcessAdd(dataObj);
+    }
+}
+
+template <typename V>
+void HistoricalDataService<V>::OnMessageBatch(Span<V> batch)
+{
+    for (V& dataObj : batch)
+    {
+        historicalDataMap[dataObj.GetProduct().GetProductIndex()] = dataObj;
+    }
+
+    for (auto& ls : serviceListeners)
+    {
+        ls->ProcessAddBatch(batch);
+    }
 }
 
 template <typename V>
@@ -155,19 +259,106 @@ std::string HistoricalDataService<V>::GetServiceType() const
     return serviceType;
 }
 
+template <typename V>
+HistoricalFormat HistoricalDataService<V>::GetFormat() const
+{
+    return historicalFormat;
+}
+
 template <typename V>
 void HistoricalDataService<V>::PersistData(std::string persistKey, V& dataObj)
 {
+    if (asyncWriter)
+    {
+        // Capture the event time now; formatting happens on the writer thread
+        asyncWriter->Enqueue(TimestampedRecord<V>{microsec_clock::local_time(), dataObj});
+        return;
+    }
+
     // Delegate the actual writing to the connector
     dataConnector->Publish(dataObj);
 }
 
+template <typename V>
+void HistoricalDataService<V>::PersistBatch(Span<V> batch)
+{
+    if (batch.empty()) return;
+    ptime timestamp = microsec_clock::local_time();
+
+    if (asyncWriter)
+    {
+        for (V& dataObj : batch)
+        {
+            asyncWriter->Enqueue(TimestampedRecord<V>{timestamp, dataObj});
+        }
+        return;
+    }
+
+    fileWriter->BeginBatch();
+    for (V& dataObj : batch)
+    {
+        dataConnector->WriteRecord(timestamp, dataObj);
+    }
+    fileWriter->EndBatch();
+}
+
+template <typename V>
+BufferedFileWriter& HistoricalDataService<V>::GetWriter()
+{
+    return *fileWriter;
+}
+
+template <typename V>
+void HistoricalDataService<V>::Flush()
+{
+    if (asyncWriter)
+    {
+        asyncWriter->Drain();
+        return;
+    }
+    fileWriter->Flush();
+}
+
+template <typename V>
+void HistoricalDataService<V>::EnableAsync(size_t queueCapacity, OverflowPolicy overflow)
+{
+    if (asyncWriter) return;
+    fileWriter->Flush();
+
+    HistoricalDataConnector<V>* connectorPtr = dataConnector;
+    asyncWriter = new AsyncRecordWriter<TimestampedRecord<V>>(
+        *fileWriter,
+        [connectorPtr](const TimestampedRecord<V>& record, BufferedFileWriter&)
+        {
+            connectorPtr->WriteRecord(record.timestamp, record.data);
+        },
+        queueCapacity, overflow);
+}
+
+template <typename V>
+bool HistoricalDataService<V>::IsAsync() const
+{
+    return asyncWriter != nullptr;
+}
+
+template <typename V>
+AsyncWriterStats HistoricalDataService<V>::GetAsyncStats() const
+{
+    return asyncWriter ? asyncWriter->GetStats() : AsyncWriterStats();
+}
+
+template <typename V>
+size_t HistoricalDataService<V>::GetAsyncQueueDepth() const
+{
+    return asyncWriter ? asyncWriter->GetQueueDepth() : 0;
+}
+
 // ============================================================================
 // CLASS: HistoricalDataConnector<V>
 // ============================================================================
 /**
- * HistoricalDataConnector handles publishing data to local files
- * based on the service type. Subscribe is unused here.
+ * HistoricalDataConnector handles publishing data to the service's
+ * output file, and replaying a binary journal back into the service.
  */
 template <typename V>
 class HistoricalDataConnector : public Connector<V>
@@ -179,7 +370,10 @@ public:
     // Publish data (write to file)
     void Publish(V& dataObj) override;
 
-    // Subscribe data (not implemented)
+    // Format one timestamped record into the service's output file
+    void WriteRecord(const ptime& timestamp, const V& dataObj);
+
+    // Replay a binary journal into the service, one OnMessage per record
     void Subscribe(std::ifstream& fileStream) override;
 
 private:
@@ -198,83 +392,42 @@ HistoricalDataConnector<V>::HistoricalDataConnector(HistoricalDataService<V>* sv
 template <typename V>
 void HistoricalDataConnector<V>::Publish(V& dataObj)
 {
-    std::string typeStr = serviceRef->GetServiceType();
-    std::ofstream outFile;
-
-    // Determine which file to open based on service type
-    if (typeStr == "Position")
-    {
-        outFile.open("Data/Output/positions.txt", std::ios::app);
-        if (!outFile.is_open())
-        {
-            std::cerr << "Error: Unable to open file Data/Output/positions.txt\n";
-            return;
-        }
-    }
-    else if (typeStr == "Risk")
-    {
-        outFile.open("Data/Output/risk.txt", std::ios::app);
-        if (!outFile.is_open())
-        {
-            std::cerr << "Error: Unable to open file Data/Output/risk.txt\n";
-            return;
-        }
-    }
-    else if (typeStr == "Execution")
-    {
-        outFile.open("Data/Output/executions.txt", std::ios::app);
-        if (!outFile.is_open())
-        {
-            std::cerr << "Error: Unable to open file Data/Output/executions.txt\n";
-            return;
-        }
-    }
-    else if (typeStr == "Streaming")
-    {
-        outFile.open("Data/Output/streaming.txt", std::ios::app);
-        if (!outFile.is_open())
-        {
-            std::cerr << "Error: Unable to open file Data/Output/streaming.txt\n";
-            return;
-        }
-    }
-    else if (typeStr == "Inquiry")
-    {
-        outFile.open("Data/Output/allinquiries.txt", std::ios::app);
-        if (!outFile.is_open())
-        {
-            std::cerr << "Error: Unable to open file Data/Output/allinquiries.txt\n";
-            return;
-        }
-    }
-    else
-    {
-        // If service type is unknown, write to a fallback file
-        outFile.open("Data/Output/unknown.txt", std::ios::app);
-        if (!outFile.is_open())
-        {
-            std::cerr << "Error: Unable to open file Data/Output/unknown.txt\n";
-            return;
-        }
-    }
+    WriteRecord(microsec_clock::local_time(), dataObj);
+}
 
-    // Write timestamp
-    auto nowTime = microsec_clock::local_time();
-    outFile << nowTime << ",";
+template <typename V>
+void HistoricalDataConnector<V>::WriteRecord(const ptime& timestamp, const V& dataObj)
+{
+    BufferedFileWriter& outFile = serviceRef->GetWriter();
+    if (!outFile.IsOpen()) return;
 
-    // Write data fields
-    std::vector<std::string> dataFields = dataObj.PrintFunction();
-    for (auto& field : dataFields)
+    if (serviceRef->GetFormat() == HistoricalFormat::BINARY)
     {
-        outFile << field << ",";
+        typename JournalTraits<V>::Record record;
+        JournalTraits<V>::Encode(timestamp, dataObj, record);
+        outFile.Write(std::string_view(reinterpret_cast<const char*>(&record), sizeof(record)));
+        outFile.EndRecord();
+        return;
     }
-    outFile << std::endl;  // end line
+    WriteTextRecord(timestamp, dataObj, outFile);
 }
 
 template <typename V>
-void HistoricalDataConnector<V>::Subscribe(std::ifstream& /*fileStream*/)
+void HistoricalDataConnector<V>::Subscribe(std::ifstream& fileStream)
 {
-    // Not implemented
+    JournalHeader header;
+    if (!ReadJournalHeader(fileStream, header) || !MatchesJournal<V>(header))
+    {
+        std::cerr << "Error: Not a " << serviceRef->GetServiceType() << " journal\n";
+        return;
+    }
+
+    ptime timestamp;
+    V dataObj;
+    while (ReadJournalRecord(fileStream, timestamp, dataObj))
+    {
+        serviceRef->OnMessage(dataObj);
+    }
 }
 
 // ============================================================================
@@ -298,6 +451,7 @@ public:
     void ProcessAdd(V& dataObj) override;
     void ProcessRemove(V& dataObj) override;
     void ProcessUpdate(V& dataObj) override;
+    void ProcessAddBatch(Span<V> batch) override;
 
 private:
     HistoricalDataService<V>* parentService;
@@ -325,6 +479,12 @@ void HistoricalDataListener<V>::ProcessAdd(V& dataObj)
     parentService->PersistData(persistKey, dataObj);
 }
 
+template <typename V>
+void HistoricalDataListener<V>::ProcessAddBatch(Span<V> batch)
+{
+    parentService->PersistBatch(batch);
+}
+
 template <typename V>
 void HistoricalDataListener<V>::ProcessRemove(V& /*dataObj*/)
 {
@@ -337,4 +497,26 @@ void HistoricalDataListener<V>::ProcessUpdate(V& /*dataObj*/)
     // Not used
 }
 
+// ============================================================================
+// CLASS: ReplayListener<K, V>
+// ============================================================================
+/**
+ * ReplayListener forwards records replayed from a journal into another
+ * service's OnMessage, e.g. to restore PositionService from positions.bin.
+ */
+template <typename K, typename V>
+class ReplayListener : public ServiceListener<V>
+{
+public:
+    explicit ReplayListener(Service<K, V>* _target) : target(_target) {}
+
+    void ProcessAdd(V& dataObj) override { target->OnMessage(dataObj); }
+    void ProcessAddBatch(Span<V> batch) override { target->OnMessageBatch(batch); }
+    void ProcessRemove(V& /*dataObj*/) override {}
+    void ProcessUpdate(V& /*dataObj*/) override {}
+
+private:
+    Service<K, V>* target;
+};
+
 #endif // HISTORICAL_DATA_SERVICE_HPP
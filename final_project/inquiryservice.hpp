@@ -10,14 +10,21 @@
 #ifndef INQUIRY_SERVICE_HPP
 #define INQUIRY_SERVICE_HPP
 
+#include "latencyhistogram.hpp"
+#include "mappedfile.hpp"
+#include "pricingservice.hpp"
+#include "productfactory.hpp"
+#include "productregistry.hpp"
 #include "soa.hpp"
 #include "tradebookingservice.hpp"
 #include "utility.hpp"
+#include <chrono>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <sstream>
 #include <fstream>
-#include <map>
+#include <unordered_map>
 #include <iostream>
 
 // ============================================================================
@@ -35,6 +42,42 @@ enum InquiryState
     CUSTOMER_REJECTED
 };
 
+// Name of a state as written in inquiry records
+const char* InquiryStateName(InquiryState state)
+{
+    switch (state)
+    {
+    case RECEIVED:
+        return "RECEIVED";
+    case QUOTED:
+        return "QUOTED";
+    case DONE:
+        return "DONE";
+    case REJECTED:
+        return "REJECTED";
+    case CUSTOMER_REJECTED:
+        return "CUSTOMER_REJECTED";
+    }
+    return "";
+}
+
+/**
+ * Whether an inquiry may move from one state to another:
+ *   RECEIVED -> QUOTED | REJECTED | CUSTOMER_REJECTED
+ *   QUOTED   -> DONE | CUSTOMER_REJECTED
+ * DONE, REJECTED and CUSTOMER_REJECTED are final.
+ */
+constexpr bool IsInquiryTransition(InquiryState from, InquiryState to)
+{
+    return (from == RECEIVED && (to == QUOTED || to == REJECTED || to == CUSTOMER_REJECTED)) ||
+           (from == QUOTED && (to == DONE || to == CUSTOMER_REJECTED));
+}
+
+constexpr bool IsFinalInquiryState(InquiryState state)
+{
+    return state == DONE || state == REJECTED || state == CUSTOMER_REJECTED;
+}
+
 // ============================================================================
 // CLASS: Inquiry<T>
 // ============================================================================
@@ -68,7 +111,7 @@ public:
 
 private:
     std::string inquiryId;
-    T product;
+    ProductRef<T> product;
     Side side;
     long quantity;
     double price;
@@ -93,7 +136,7 @@ const std::string& Inquiry<T>::GetInquiryId() const
 template <typename T>
 const T& Inquiry<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
 }
 
 template <typename T>
@@ -137,30 +180,11 @@ std::vector<std::string> Inquiry<T>::PrintFunction() const
 {
     // Convert members to strings
     std::string inqIdStr = inquiryId;
-    std::string prodIdStr = product.GetProductId();
+    std::string prodIdStr = product.Get().GetProductId();
     std::string sideStr = (side == BUY) ? "BUY" : "SELL";
     std::string qtyStr = std::to_string(quantity);
     std::string priceStr = price2string(price);
-
-    std::string stateStr;
-    switch (state)
-    {
-    case RECEIVED:
-        stateStr = "RECEIVED";
-        break;
-    case QUOTED:
-        stateStr = "QUOTED";
-        break;
-    case DONE:
-        stateStr = "DONE";
-        break;
-    case REJECTED:
-        stateStr = "REJECTED";
-        break;
-    case CUSTOMER_REJECTED:
-        stateStr = "CUSTOMER_REJECTED";
-        break;
-    }
+    std::string stateStr = InquiryStateName(state);
 
     return { inqIdStr, prodIdStr, sideStr, qtyStr, priceStr, stateStr };
 }
@@ -177,15 +201,28 @@ class InquiryConnector;
 /**
  * InquiryService manages customer inquiries keyed by an inquiry ID (string).
  * Type T is the product type.
+ *
+ * Inquiries are kept in one dense vector, found through a hash index on
+ * the inquiry ID, and every change of state goes through Transition, which
+ * enforces IsInquiryTransition. RECEIVED inquiries are also indexed per
+ * product as open. By default a new inquiry is quoted at its own price as
+ * soon as it arrives; with auto-quoting off, open inquiries wait for
+ * SendQuote or QuoteOpenInquiries.
+ *
+ * When an inquiry reaches a final state, the time since it was received
+ * is recorded as its RFQ turnaround.
  */
 template <typename T>
 class InquiryService : public Service<std::string, Inquiry<T>>
 {
 public:
+    using Clock = std::chrono::steady_clock;
+
     // Constructor
     InquiryService();
 
-    // Retrieve an Inquiry<T> by ID
+    // Retrieve an Inquiry<T> by ID; an unknown ID gets an empty inquiry
+    // that is not stored, so a lookup never adds an inquiry
     Inquiry<T>& GetData(std::string _key) override;
 
     // Connector callback for new/updated inquiries
@@ -200,14 +237,66 @@ public:
     // Access the connector
     InquiryConnector<T>* GetConnector();
 
-    // Send a quote back to the client
+    // Send a quote back to the client for an open inquiry
     void SendQuote(const std::string& _inquiryId, double _price);
 
-    // Reject an inquiry from the client
+    // Reject an open inquiry from the client
     void RejectInquiry(const std::string& _inquiryId);
 
+    // Quote new inquiries at their own price on arrival (the default)
+    void SetAutoQuote(bool _autoQuote);
+
+    // Quote every open inquiry on a product at one price; returns how many
+    size_t QuoteOpenInquiries(ProductIndex _product, double _price);
+
+    // Quote every open inquiry at its product's current mid in _pricing,
+    // skipping products without a price; returns how many were quoted
+    size_t QuoteOpenInquiries(const PricingService<T>& _pricing);
+
+    // Number of open (RECEIVED) inquiries on a product
+    size_t GetOpenInquiryCount(ProductIndex _product) const;
+
+    // Received-to-final turnaround of every finished inquiry, in nanoseconds
+    const LatencyHistogram& GetRfqLatency() const;
+
+    // Store an inquiry in whatever state it is in (e.g. from a snapshot),
+    // without quoting it or notifying listeners
+    void Restore(const Inquiry<T>& _data);
+
+    // Call f(inquiry) for every stored inquiry, in arrival order
+    template <typename F>
+    void ForEachInquiry(F&& f) const;
+
 private:
-    std::map<std::string, Inquiry<T>> inquiries;
+    // Slot of an inquiry ID, or NO_SLOT
+    size_t FindSlot(const std::string& _inquiryId) const;
+
+    // Store a new inquiry in its incoming state
+    size_t Insert(const Inquiry<T>& _data);
+
+    // Move a stored inquiry to a new state; logs and returns false if not allowed
+    bool Transition(size_t _slot, InquiryState _state);
+
+    // RECEIVED -> QUOTED at _price, send it, and let the client accept it
+    void Quote(size_t _slot, double _price);
+
+    // QUOTED -> DONE, without notifying listeners
+    void Complete(size_t _slot);
+
+    void Open(size_t _slot);
+    void Close(size_t _slot);
+
+    static constexpr size_t NO_SLOT = static_cast<size_t>(-1);
+
+    std::vector<Inquiry<T>> inquiries;
+    std::vector<Clock::time_point> receivedTimes;
+    std::vector<size_t> openPositions;
+    std::unordered_map<std::string, size_t> inquiryIndex;
+    ProductStore<std::vector<size_t>> openInquiries;
+    std::vector<Inquiry<T>> quoteBatch;
+    Inquiry<T> emptyInquiry;
+    LatencyHistogram rfqLatency;
+    bool autoQuote;
     std::vector<ServiceListener<Inquiry<T>>*> listeners;
     InquiryConnector<T>* connector;
 };
@@ -215,9 +304,8 @@ private:
 // -------------------- Implementation of InquiryService<T> --------------------
 template <typename T>
 InquiryService<T>::InquiryService()
-    : inquiries(), listeners(), connector(nullptr)
+    : inquiries(), emptyInquiry(), autoQuote(true), listeners(), connector(nullptr)
 {
-    inquiries = std::map<std::string, Inquiry<T>>();
     listeners = std::vector<ServiceListener<Inquiry<T>>*>();
     connector = new InquiryConnector<T>(this);
 }
@@ -225,33 +313,56 @@ InquiryService<T>::InquiryService()
 template <typename T>
 Inquiry<T>& InquiryService<T>::GetData(std::string _key)
 {
-    return inquiries[_key];
+    size_t slot = FindSlot(_key);
+    if (slot == NO_SLOT)
+    {
+        // Reset, in case a caller wrote to the one handed out before
+        emptyInquiry = Inquiry<T>();
+        return emptyInquiry;
+    }
+    return inquiries[slot];
 }
 
 template <typename T>
 void InquiryService<T>::OnMessage(Inquiry<T>& _data)
 {
     InquiryState currentState = _data.GetState();
-    if (currentState == RECEIVED)
+    if (currentState != RECEIVED && currentState != QUOTED) return;
+
+    size_t slot = FindSlot(_data.GetInquiryId());
+    if (slot == NO_SLOT)
+    {
+        slot = Insert(_data);
+    }
+    else if (inquiries[slot].GetState() == currentState)
+    {
+        // A repeated message refreshes the stored inquiry, re-listing it
+        // under its product in case the repeat names a different one
+        Close(slot);
+        inquiries[slot] = _data;
+        if (currentState == RECEIVED) Open(slot);
+    }
+    else
     {
-        // Store inquiry if it's newly received
-        inquiries[_data.GetInquiryId()] = _data;
+        if (!Transition(slot, currentState)) return;
+        inquiries[slot].SetPrice(_data.GetPrice());
+    }
 
-        // Publish to connector (this may change the state to QUOTED)
-        connector->Publish(_data);
+    if (currentState == RECEIVED)
+    {
+        if (!autoQuote) return;
+        Quote(slot, inquiries[slot].GetPrice());
+    }
+    else
+    {
+        // A quote confirmed by the client completes the inquiry
+        Complete(slot);
     }
 
-    // If the state is QUOTED, we move to DONE and notify listeners
-    if (currentState == QUOTED)
+    if (inquiries[slot].GetState() != DONE) return;
+    for (auto& ls : listeners)
     {
-        _data.SetState(DONE);
-        inquiries[_data.GetInquiryId()] = _data;
-
-        // Notify all service listeners
-        for (auto& ls : listeners)
-        {
-            ls->ProcessAdd(_data);
-        }
+        ls->ProcessAdd(inquiries[slot]);
     }
 }
 
@@ -276,23 +387,191 @@ InquiryConnector<T>* InquiryService<T>::GetConnector()
 template <typename T>
 void InquiryService<T>::SendQuote(const std::string& _inquiryId, double _price)
 {
-    // Update the price for the given inquiry
-    Inquiry<T>& targetInquiry = inquiries[_inquiryId];
-    targetInquiry.SetPrice(_price);
+    size_t slot = FindSlot(_inquiryId);
+    if (slot == NO_SLOT || inquiries[slot].GetState() != RECEIVED)
+    {
+        std::cerr << "Error: inquiry " << _inquiryId << " is not open" << std::endl;
+        return;
+    }
 
-    // Notify all listeners that something changed
+    Quote(slot, _price);
     for (auto& ls : listeners)
     {
-        ls->ProcessAdd(targetInquiry);
+        ls->ProcessAdd(inquiries[slot]);
     }
 }
 
 template <typename T>
 void InquiryService<T>::RejectInquiry(const std::string& _inquiryId)
 {
-    // Mark the inquiry as REJECTED
-    Inquiry<T>& targetInquiry = inquiries[_inquiryId];
-    targetInquiry.SetState(REJECTED);
+    size_t slot = FindSlot(_inquiryId);
+    if (slot == NO_SLOT)
+    {
+        std::cerr << "Error: unknown inquiry " << _inquiryId << std::endl;
+        return;
+    }
+    Transition(slot, REJECTED);
+}
+
+template <typename T>
+void InquiryService<T>::SetAutoQuote(bool _autoQuote)
+{
+    autoQuote = _autoQuote;
+}
+
+template <typename T>
+size_t InquiryService<T>::QuoteOpenInquiries(ProductIndex _product, double _price)
+{
+    if (!openInquiries.Contains(_product)) return 0;
+
+    // Quoting closes each inquiry, so work from a copy of the open list
+    std::vector<size_t> slots = openInquiries[_product];
+    quoteBatch.clear();
+    for (size_t slot : slots)
+    {
+        Quote(slot, _price);
+        quoteBatch.push_back(inquiries[slot]);
+    }
+
+    // One notification per listener for the whole batch
+    if (!quoteBatch.empty())
+    {
+        for (auto* ls : listeners) ls->ProcessAddBatch(Span<Inquiry<T>>(quoteBatch));
+    }
+    return slots.size();
+}
+
+template <typename T>
+size_t InquiryService<T>::QuoteOpenInquiries(const PricingService<T>& _pricing)
+{
+    std::vector<std::pair<ProductIndex, double>> mids;
+    openInquiries.ForEach([&](ProductIndex index, std::vector<size_t>& slots) {
+        if (slots.empty()) return;
+        const Price<T>* price = _pricing.FindData(index);
+        if (price) mids.emplace_back(index, price->GetMid());
+    });
+
+    size_t quoted = 0;
+    for (const auto& [index, mid] : mids) quoted += QuoteOpenInquiries(index, mid);
+    return quoted;
+}
+
+template <typename T>
+size_t InquiryService<T>::GetOpenInquiryCount(ProductIndex _product) const
+{
+    const std::vector<size_t>* slots = openInquiries.Find(_product);
+    return slots ? slots->size() : 0;
+}
+
+template <typename T>
+const LatencyHistogram& InquiryService<T>::GetRfqLatency() const
+{
+    return rfqLatency;
+}
+
+template <typename T>
+void InquiryService<T>::Restore(const Inquiry<T>& _data)
+{
+    size_t slot = FindSlot(_data.GetInquiryId());
+    if (slot == NO_SLOT)
+    {
+        Insert(_data);
+        return;
+    }
+
+    Close(slot);
+    inquiries[slot] = _data;
+    if (_data.GetState() == RECEIVED) Open(slot);
+}
+
+template <typename T>
+template <typename F>
+void InquiryService<T>::ForEachInquiry(F&& f) const
+{
+    for (const Inquiry<T>& inquiry : inquiries)
+    {
+        // Skip any inquiry that arrived without an ID
+        if (!inquiry.GetInquiryId().empty()) f(inquiry);
+    }
+}
+
+template <typename T>
+size_t InquiryService<T>::FindSlot(const std::string& _inquiryId) const
+{
+    auto found = inquiryIndex.find(_inquiryId);
+    return (found == inquiryIndex.end()) ? NO_SLOT : found->second;
+}
+
+template <typename T>
+size_t InquiryService<T>::Insert(const Inquiry<T>& _data)
+{
+    size_t slot = inquiries.size();
+    inquiries.push_back(_data);
+    receivedTimes.push_back(Clock::now());
+    openPositions.push_back(NO_SLOT);
+    inquiryIndex.emplace(_data.GetInquiryId(), slot);
+    if (_data.GetState() == RECEIVED) Open(slot);
+    return slot;
+}
+
+template <typename T>
+bool InquiryService<T>::Transition(size_t _slot, InquiryState _state)
+{
+    Inquiry<T>& inquiry = inquiries[_slot];
+    if (!IsInquiryTransition(inquiry.GetState(), _state))
+    {
+        std::cerr << "Error: inquiry " << inquiry.GetInquiryId() << " cannot move from "
+                  << InquiryStateName(inquiry.GetState()) << " to " << InquiryStateName(_state) << std::endl;
+        return false;
+    }
+
+    if (inquiry.GetState() == RECEIVED) Close(_slot);
+    inquiry.SetState(_state);
+    if (IsFinalInquiryState(_state))
+    {
+        auto turnaround = Clock::now() - receivedTimes[_slot];
+        rfqLatency.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(turnaround).count()));
+    }
+    return true;
+}
+
+template <typename T>
+void InquiryService<T>::Quote(size_t _slot, double _price)
+{
+    if (!Transition(_slot, QUOTED)) return;
+    inquiries[_slot].SetPrice(_price);
+    connector->Publish(inquiries[_slot]);
+    Complete(_slot);
+}
+
+template <typename T>
+void InquiryService<T>::Complete(size_t _slot)
+{
+    Transition(_slot, DONE);
+}
+
+template <typename T>
+void InquiryService<T>::Open(size_t _slot)
+{
+    std::vector<size_t>& slots = openInquiries[inquiries[_slot].GetProduct().GetProductIndex()];
+    openPositions[_slot] = slots.size();
+    slots.push_back(_slot);
+}
+
+template <typename T>
+void InquiryService<T>::Close(size_t _slot)
+{
+    size_t position = openPositions[_slot];
+    if (position == NO_SLOT) return;
+
+    // Swap-remove from the product's open list
+    std::vector<size_t>& slots = openInquiries[inquiries[_slot].GetProduct().GetProductIndex()];
+    size_t moved = slots.back();
+    slots[position] = moved;
+    openPositions[moved] = position;
+    slots.pop_back();
+    openPositions[_slot] = NO_SLOT;
 }
 
 // ============================================================================
@@ -310,17 +589,26 @@ public:
     // Constructor
     InquiryConnector(InquiryService<T>* _service);
 
-    // Publish data (may change state from RECEIVED to QUOTED)
+    // Send a quote to the client
     void Publish(Inquiry<T>& _data) override;
 
     // Subscribe from a file stream (e.g. "inquiries.txt")
     void Subscribe(std::ifstream& _data) override;
 
-    // Overloaded Subscribe to handle a single Inquiry update
+    // Subscribe data from a memory-mapped file, scanning it in place
+    void Subscribe(MappedFile& _data);
+
+    // Overloaded Subscribe to handle a single Inquiry update from the client
     void Subscribe(Inquiry<T>& _data);
 
+    // Parse one inquiry record and pass it to the service
+    void ProcessLine(std::string_view line);
+
 private:
     InquiryService<T>* inquiryService;
+
+    // Scratch field storage reused across lines
+    LineFields fields;
 };
 
 // -------------------- Implementation of InquiryConnector<T> --------------------
@@ -331,67 +619,66 @@ InquiryConnector<T>::InquiryConnector(InquiryService<T>* _service)
 }
 
 template <typename T>
-void InquiryConnector<T>::Publish(Inquiry<T>& _data)
+void InquiryConnector<T>::Publish(Inquiry<T>& /*_data*/)
 {
-    // If the Inquiry is just RECEIVED, move it to QUOTED
-    if (_data.GetState() == RECEIVED)
-    {
-        _data.SetState(QUOTED);
-        // Re-subscribe to process state change
-        this->Subscribe(_data);
-    }
+    // There is no client transport: the simulated client accepts every
+    // quote, which InquiryService applies itself without a round trip
 }
 
 template <typename T>
 void InquiryConnector<T>::Subscribe(std::ifstream& inputStream)
 {
     // Read lines (e.g. from "inquiries.txt") and create Inquiry objects
-    std::string lineStr;
-    while (std::getline(inputStream, lineStr))
+    LineReader reader(inputStream);
+    std::string_view lineStr;
+    while (reader.NextLine(lineStr))
     {
-        if (lineStr.empty()) continue;
-
-        std::stringstream ss(lineStr);
-        std::string token;
-        std::vector<std::string> fields;
-        while (std::getline(ss, token, ','))
-        {
-            fields.push_back(token);
-        }
-
-        if (fields.size() < 6) continue; // Expect 6 fields: ID, productId, side, qty, price, state
-
-        // Parse fields
-        std::string inquiryIdStr = fields[0];
-        std::string productIdStr = fields[1];
-        Side inquirySide = (fields[2] == "BUY") ? BUY : SELL;
-        long parsedQty = stol(fields[3]);
-        double parsedPrice = string2price(fields[4]);
-
-        InquiryState parsedState;
-        if (fields[5] == "RECEIVED")
-            parsedState = RECEIVED;
-        else if (fields[5] == "QUOTED")
-            parsedState = QUOTED;
-        else if (fields[5] == "DONE")
-            parsedState = DONE;
-        else if (fields[5] == "REJECTED")
-            parsedState = REJECTED;
-        else
-            parsedState = CUSTOMER_REJECTED;
-
-        // Convert product ID to actual product (e.g., Bond)
-        T productObj = GetBond(productIdStr);
-
-        // Create an Inquiry object
-        Inquiry<T> newInquiry(inquiryIdStr, productObj, inquirySide,
-                              parsedQty, parsedPrice, parsedState);
-
-        // Notify the service
-        inquiryService->OnMessage(newInquiry);
+        ProcessLine(lineStr);
     }
 }
 
+template <typename T>
+void InquiryConnector<T>::Subscribe(MappedFile& _data)
+{
+    _data.ForEachLine([this](std::string_view line) { ProcessLine(line); });
+}
+
+template <typename T>
+void InquiryConnector<T>::ProcessLine(std::string_view lineStr)
+{
+    if (lineStr.empty()) return;
+
+    // Expect 6 fields: ID, productId, side, qty, price, state
+    if (SplitFields(lineStr, fields) < 6) return;
+
+    // Parse fields
+    Side inquirySide = (fields[2] == "BUY") ? BUY : SELL;
+    long parsedQty = ParseLong(fields[3]);
+    double parsedPrice = string2price(fields[4]);
+
+    InquiryState parsedState;
+    if (fields[5] == "RECEIVED")
+        parsedState = RECEIVED;
+    else if (fields[5] == "QUOTED")
+        parsedState = QUOTED;
+    else if (fields[5] == "DONE")
+        parsedState = DONE;
+    else if (fields[5] == "REJECTED")
+        parsedState = REJECTED;
+    else
+        parsedState = CUSTOMER_REJECTED;
+
+    // Convert product ID to actual product (e.g., Bond)
+    const T& productObj = GetProduct<T>(fields[1]);
+
+    // Create an Inquiry object
+    Inquiry<T> newInquiry(std::string(fields[0]), productObj, inquirySide,
+                          parsedQty, parsedPrice, parsedState);
+
+    // Notify the service
+    inquiryService->OnMessage(newInquiry);
+}
+
 template <typename T>
 void InquiryConnector<T>::Subscribe(Inquiry<T>& _data)
 {
@@ -0,0 +1,325 @@
+/**
+ * journal.hpp
+ * Defines the fixed-width binary journal format for historical data:
+ * a small header describing the record schema, followed by one
+ * fixed-size record per persisted event.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <type_traits>
+#include "execution.hpp"
+#include "inquiryservice.hpp"
+#include "positionservice.hpp"
+#include "productfactory.hpp"
+#include "riskservice.hpp"
+#include "streaming.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// Identifies a journal file and its layout revision
+constexpr char JOURNAL_MAGIC[8] = {'T', 'S', 'J', 'R', 'N', 'L', '\0', '\0'};
+constexpr uint32_t JOURNAL_VERSION = 2;
+
+// Books a Position record can hold: every book a Position can, so any
+// position the service holds can be journaled
+constexpr size_t JOURNAL_MAX_BOOKS = MAX_BOOKS;
+static_assert(JOURNAL_MAX_BOOKS >= MAX_BOOKS, "a Position record must hold every book of a Position");
+
+/**
+ * The value type stored in a journal.
+ */
+enum JournalRecordType : uint32_t
+{
+    JOURNAL_POSITION = 1,
+    JOURNAL_RISK = 2,
+    JOURNAL_EXECUTION = 3,
+    JOURNAL_STREAMING = 4,
+    JOURNAL_INQUIRY = 5
+};
+
+/**
+ * Written once at the start of every journal file.
+ */
+struct JournalHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t recordType;
+    uint32_t recordSize;
+    uint32_t reserved;
+};
+
+// -------------------- Fixed-width record layouts --------------------
+
+struct PositionRecord
+{
+    int64_t timestamp;
+    FixedString<12> productId;
+    uint32_t bookCount;
+    FixedString<8> books[JOURNAL_MAX_BOOKS];
+    int64_t quantities[JOURNAL_MAX_BOOKS];
+};
+
+struct PV01Record
+{
+    int64_t timestamp;
+    FixedString<12> productId;
+    double pv01;
+    int64_t quantity;
+};
+
+struct ExecutionRecord
+{
+    int64_t timestamp;
+    FixedString<12> productId;
+    uint8_t side;
+    uint8_t orderType;
+    uint8_t isChildOrder;
+    FixedString<24> orderId;
+    FixedString<24> parentOrderId;
+    double price;
+    int64_t visibleQuantity;
+    int64_t hiddenQuantity;
+};
+
+struct StreamingRecord
+{
+    int64_t timestamp;
+    FixedString<12> productId;
+    double bidPrice;
+    int64_t bidVisibleQuantity;
+    int64_t bidHiddenQuantity;
+    double offerPrice;
+    int64_t offerVisibleQuantity;
+    int64_t offerHiddenQuantity;
+};
+
+struct InquiryRecord
+{
+    int64_t timestamp;
+    FixedString<24> inquiryId;
+    FixedString<12> productId;
+    uint8_t side;
+    uint8_t state;
+    int64_t quantity;
+    double price;
+};
+
+// Timestamps are stored as microseconds since 1970-01-01 of the recorded clock
+int64_t ToJournalTime(const ptime& timestamp)
+{
+    static const ptime epoch(date(1970, Jan, 1));
+    return (timestamp - epoch).total_microseconds();
+}
+
+ptime FromJournalTime(int64_t micros)
+{
+    static const ptime epoch(date(1970, Jan, 1));
+    return epoch + boost::posix_time::microseconds(micros);
+}
+
+/**
+ * JournalTraits<V> maps a persisted value type to its record layout and
+ * converts in both directions. Decoding rebuilds the product from its
+ * identifier with GetProduct<T>.
+ */
+template <typename V>
+struct JournalTraits;
+
+template <typename T>
+struct JournalTraits<Position<T>>
+{
+    using Record = PositionRecord;
+    static constexpr JournalRecordType type = JOURNAL_POSITION;
+
+    static void Encode(const ptime& timestamp, const Position<T>& position, Record& record)
+    {
+        memset(static_cast<void*>(&record), 0, sizeof(Record));
+        record.timestamp = ToJournalTime(timestamp);
+        record.productId.Assign(position.GetProduct().GetProductId());
+        position.ForEachBook([&record](const string& book, long qty) {
+            record.books[record.bookCount].Assign(book);
+            record.quantities[record.bookCount] = qty;
+            ++record.bookCount;
+        });
+    }
+
+    static Position<T> Decode(const Record& record, ptime& timestamp)
+    {
+        timestamp = FromJournalTime(record.timestamp);
+        Position<T> position(GetProduct<T>(record.productId.View()));
+        for (uint32_t i = 0; i < record.bookCount && i < JOURNAL_MAX_BOOKS; ++i)
+        {
+            position.AddPosition(string(record.books[i].View()), record.quantities[i]);
+        }
+        return position;
+    }
+};
+
+template <typename T>
+struct JournalTraits<PV01<T>>
+{
+    using Record = PV01Record;
+    static constexpr JournalRecordType type = JOURNAL_RISK;
+
+    static void Encode(const ptime& timestamp, const PV01<T>& pv01, Record& record)
+    {
+        memset(static_cast<void*>(&record), 0, sizeof(Record));
+        record.timestamp = ToJournalTime(timestamp);
+        record.productId.Assign(pv01.GetProduct().GetProductId());
+        record.pv01 = pv01.GetPV01();
+        record.quantity = pv01.GetQuantity();
+    }
+
+    static PV01<T> Decode(const Record& record, ptime& timestamp)
+    {
+        timestamp = FromJournalTime(record.timestamp);
+        return PV01<T>(GetProduct<T>(record.productId.View()), record.pv01, record.quantity);
+    }
+};
+
+template <typename T>
+struct JournalTraits<ExecutionOrder<T>>
+{
+    using Record = ExecutionRecord;
+    static constexpr JournalRecordType type = JOURNAL_EXECUTION;
+
+    static void Encode(const ptime& timestamp, const ExecutionOrder<T>& order, Record& record)
+    {
+        memset(static_cast<void*>(&record), 0, sizeof(Record));
+        record.timestamp = ToJournalTime(timestamp);
+        record.productId.Assign(order.GetProduct().GetProductId());
+        record.side = static_cast<uint8_t>(order.GetPricingSide());
+        record.orderType = static_cast<uint8_t>(order.GetOrderType());
+        record.isChildOrder = order.IsChildOrder() ? 1 : 0;
+        record.orderId.Assign(order.GetOrderId());
+        record.parentOrderId.Assign(order.GetParentOrderId());
+        record.price = order.GetPrice().ToDecimal();
+        record.visibleQuantity = order.GetVisibleQuantity();
+        record.hiddenQuantity = order.GetHiddenQuantity();
+    }
+
+    static ExecutionOrder<T> Decode(const Record& record, ptime& timestamp)
+    {
+        timestamp = FromJournalTime(record.timestamp);
+        return ExecutionOrder<T>(GetProduct<T>(record.productId.View()),
+                                 static_cast<PricingSide>(record.side),
+                                 string(record.orderId.View()),
+                                 static_cast<OrderType>(record.orderType),
+                                 Tick256::FromDecimal(record.price),
+                                 static_cast<double>(record.visibleQuantity),
+                                 static_cast<double>(record.hiddenQuantity),
+                                 string(record.parentOrderId.View()),
+                                 record.isChildOrder != 0);
+    }
+};
+
+template <typename T>
+struct JournalTraits<PriceStream<T>>
+{
+    using Record = StreamingRecord;
+    static constexpr JournalRecordType type = JOURNAL_STREAMING;
+
+    static void Encode(const ptime& timestamp, const PriceStream<T>& stream, Record& record)
+    {
+        memset(static_cast<void*>(&record), 0, sizeof(Record));
+        record.timestamp = ToJournalTime(timestamp);
+        record.productId.Assign(stream.GetProduct().GetProductId());
+        record.bidPrice = stream.GetBidOrder().GetPrice().ToDecimal();
+        record.bidVisibleQuantity = stream.GetBidOrder().GetVisibleQuantity();
+        record.bidHiddenQuantity = stream.GetBidOrder().GetHiddenQuantity();
+        record.offerPrice = stream.GetOfferOrder().GetPrice().ToDecimal();
+        record.offerVisibleQuantity = stream.GetOfferOrder().GetVisibleQuantity();
+        record.offerHiddenQuantity = stream.GetOfferOrder().GetHiddenQuantity();
+    }
+
+    static PriceStream<T> Decode(const Record& record, ptime& timestamp)
+    {
+        timestamp = FromJournalTime(record.timestamp);
+        PriceStreamOrder bidOrder(Tick256::FromDecimal(record.bidPrice), record.bidVisibleQuantity,
+                                  record.bidHiddenQuantity, BID);
+        PriceStreamOrder offerOrder(Tick256::FromDecimal(record.offerPrice), record.offerVisibleQuantity,
+                                    record.offerHiddenQuantity, OFFER);
+        return PriceStream<T>(GetProduct<T>(record.productId.View()), bidOrder, offerOrder);
+    }
+};
+
+template <typename T>
+struct JournalTraits<Inquiry<T>>
+{
+    using Record = InquiryRecord;
+    static constexpr JournalRecordType type = JOURNAL_INQUIRY;
+
+    static void Encode(const ptime& timestamp, const Inquiry<T>& inquiry, Record& record)
+    {
+        memset(static_cast<void*>(&record), 0, sizeof(Record));
+        record.timestamp = ToJournalTime(timestamp);
+        record.inquiryId.Assign(inquiry.GetInquiryId());
+        record.productId.Assign(inquiry.GetProduct().GetProductId());
+        record.side = static_cast<uint8_t>(inquiry.GetSide());
+        record.state = static_cast<uint8_t>(inquiry.GetState());
+        record.quantity = inquiry.GetQuantity();
+        record.price = inquiry.GetPrice();
+    }
+
+    static Inquiry<T> Decode(const Record& record, ptime& timestamp)
+    {
+        timestamp = FromJournalTime(record.timestamp);
+        return Inquiry<T>(string(record.inquiryId.View()), GetProduct<T>(record.productId.View()),
+                          static_cast<Side>(record.side), record.quantity, record.price,
+                          static_cast<InquiryState>(record.state));
+    }
+};
+
+// -------------------- Header helpers --------------------
+
+// Build the header for a journal of V records
+template <typename V>
+JournalHeader MakeJournalHeader()
+{
+    static_assert(is_trivially_copyable<typename JournalTraits<V>::Record>::value,
+                  "journal records must be trivially copyable");
+    JournalHeader header;
+    memset(&header, 0, sizeof(JournalHeader));
+    memcpy(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+    header.version = JOURNAL_VERSION;
+    header.recordType = JournalTraits<V>::type;
+    header.recordSize = sizeof(typename JournalTraits<V>::Record);
+    return header;
+}
+
+// Read and check a journal header; returns false if it is missing or unknown
+bool ReadJournalHeader(istream& input, JournalHeader& header)
+{
+    if (!input.read(reinterpret_cast<char*>(&header), sizeof(JournalHeader))) return false;
+    return memcmp(header.magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) == 0 &&
+           header.version == JOURNAL_VERSION;
+}
+
+// Whether a header describes a journal of V records
+template <typename V>
+bool MatchesJournal(const JournalHeader& header)
+{
+    return header.recordType == JournalTraits<V>::type &&
+           header.recordSize == sizeof(typename JournalTraits<V>::Record);
+}
+
+// Read the next V record; returns false at end of file
+template <typename V>
+bool ReadJournalRecord(istream& input, ptime& timestamp, V& value)
+{
+    typename JournalTraits<V>::Record record;
+    if (!input.read(reinterpret_cast<char*>(&record), sizeof(record))) return false;
+    value = JournalTraits<V>::Decode(record, timestamp);
+    return true;
+}
+
+#endif // JOURNAL_HPP
@@ -0,0 +1,157 @@
+/**
+ * latencyhistogram.hpp
+ * Defines LatencyHistogram, a fixed-size log-linear histogram of latencies
+ * in the style of HdrHistogram: each power of two is split into equal
+ * sub-buckets, so every recorded value is kept to within ~3% for the whole
+ * 1ns .. 2^63ns range without allocating.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+using namespace std;
+
+// Sub-buckets per power of two are 2^(LATENCY_SUB_BUCKET_BITS - 1)
+constexpr unsigned LATENCY_SUB_BUCKET_BITS = 6;
+constexpr size_t LATENCY_SUB_BUCKETS = size_t(1) << LATENCY_SUB_BUCKET_BITS;
+constexpr size_t LATENCY_HALF_BUCKETS = LATENCY_SUB_BUCKETS / 2;
+constexpr size_t LATENCY_BUCKET_COUNT =
+    (64 - LATENCY_SUB_BUCKET_BITS) * LATENCY_HALF_BUCKETS + LATENCY_SUB_BUCKETS;
+
+/**
+ * LatencyHistogram
+ * Values below 2^LATENCY_SUB_BUCKET_BITS are counted exactly; larger values
+ * keep their top LATENCY_SUB_BUCKET_BITS bits. Percentiles report the
+ * highest value equivalent to the selected bucket, as HdrHistogram does.
+ */
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    // Count one value (normally nanoseconds)
+    void Record(uint64_t value);
+
+    // Add every count of another histogram
+    void Merge(const LatencyHistogram& other);
+
+    // Forget all recorded values
+    void Reset();
+
+    uint64_t GetCount() const;
+    uint64_t GetMin() const;
+    uint64_t GetMax() const;
+    double GetMean() const;
+
+    // Smallest recorded value v such that percentile% of values are <= v
+    uint64_t ValueAtPercentile(double percentile) const;
+
+private:
+    static size_t BucketIndex(uint64_t value);
+    static uint64_t BucketHighestValue(size_t index);
+
+    array<uint64_t, LATENCY_BUCKET_COUNT> counts;
+    uint64_t totalCount;
+    uint64_t minValue;
+    uint64_t maxValue;
+    double sum;
+};
+
+// -------------------- Implementation of LatencyHistogram --------------------
+
+LatencyHistogram::LatencyHistogram()
+{
+    Reset();
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+    ++counts[BucketIndex(value)];
+    ++totalCount;
+    minValue = min(minValue, value);
+    maxValue = max(maxValue, value);
+    sum += static_cast<double>(value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other)
+{
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i) counts[i] += other.counts[i];
+    totalCount += other.totalCount;
+    minValue = min(minValue, other.minValue);
+    maxValue = max(maxValue, other.maxValue);
+    sum += other.sum;
+}
+
+void LatencyHistogram::Reset()
+{
+    counts.fill(0);
+    totalCount = 0;
+    minValue = numeric_limits<uint64_t>::max();
+    maxValue = 0;
+    sum = 0.0;
+}
+
+uint64_t LatencyHistogram::GetCount() const
+{
+    return totalCount;
+}
+
+uint64_t LatencyHistogram::GetMin() const
+{
+    return totalCount ? minValue : 0;
+}
+
+uint64_t LatencyHistogram::GetMax() const
+{
+    return maxValue;
+}
+
+double LatencyHistogram::GetMean() const
+{
+    return totalCount ? sum / static_cast<double>(totalCount) : 0.0;
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const
+{
+    if (totalCount == 0) return 0;
+    double clamped = min(max(percentile, 0.0), 100.0);
+    uint64_t target = static_cast<uint64_t>(ceil(clamped / 100.0 * static_cast<double>(totalCount)));
+    target = max<uint64_t>(target, 1);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; ++i)
+    {
+        seen += counts[i];
+        if (seen >= target) return min(BucketHighestValue(i), maxValue);
+    }
+    return maxValue;
+}
+
+size_t LatencyHistogram::BucketIndex(uint64_t value)
+{
+    if (value < LATENCY_SUB_BUCKETS) return static_cast<size_t>(value);
+
+    // Keep the top LATENCY_SUB_BUCKET_BITS bits; the shift selects the octave
+    unsigned topBit = 63 - static_cast<unsigned>(__builtin_clzll(value));
+    unsigned shift = topBit - LATENCY_SUB_BUCKET_BITS + 1;
+    return shift * LATENCY_HALF_BUCKETS + static_cast<size_t>(value >> shift);
+}
+
+uint64_t LatencyHistogram::BucketHighestValue(size_t index)
+{
+    if (index < LATENCY_SUB_BUCKETS) return index;
+
+    unsigned shift = static_cast<unsigned>(index / LATENCY_HALF_BUCKETS - 1);
+    uint64_t top = index - shift * LATENCY_HALF_BUCKETS;
+    return ((top + 1) << shift) - 1;
+}
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -7,33 +7,233 @@
 
 #include "AlgoExecutionService.hpp"
 #include "AlgoStreamingService.hpp"
+#include "conflation.hpp"
 #include "DataGenerator.hpp"
+#include "eventbus.hpp"
 #include "GUIservice.hpp"
 #include "executionservice.hpp"
 #include "historicaldataservice.hpp"
 #include "inquiryservice.hpp"
+#include "mappedfile.hpp"
 #include "marketdataservice.hpp"
+#include "metrics.hpp"
 #include "positionservice.hpp"
 #include "pricingservice.hpp"
 #include "products.hpp"
+#include "replay.hpp"
 #include "riskservice.hpp"
+#include "sharding.hpp"
+#include "snapshot.hpp"
 #include "soa.hpp"
+#include "staticpipeline.hpp"
 #include "streamingservice.hpp"
+#include "threadedruntime.hpp"
 #include "tradebookingservice.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <random>
+#include <string>
 
-int main() {
-    // Step 1: Generate all data
-    std::cout << "====== Data Generating... ======" << std::endl;
-    GeneratePrices();
-    GenerateTrades();
-    GenerateInquiries();
-    GenerateMarketData();
-    std::cout << "====== Data Generated! ======" << std::endl;
+#ifdef STATIC_PIPELINE
+// Latency-critical build (-DSTATIC_PIPELINE): the same topology with the
+// services linked at compile time, run sequentially on the main thread
+int RunStaticPipeline() {
+    std::cout << "====== Static pipeline running... ======" << std::endl;
+    StaticPipeline<Bond> pipeline;
+    pipeline.EnableAsync();
+    pipeline.Run("Data/Input/");
+    std::cout << "====== All Finished! ======" << std::endl;
+    return 0;
+}
+#endif
+
+// Sharded run (--shards N): the bond topology split by CUSIP over N worker
+// threads, each owning its own services, with bucketed risk summed at the end
+int RunShardedPipeline(size_t shardCount, bool pinThreads) {
+    std::cout << "====== Sharded pipeline running (" << shardCount << " shards)... ======" << std::endl;
+    ShardedPipeline<Bond> pipeline(shardCount, DEFAULT_OUTPUT_DIRECTORY, pinThreads);
+    std::vector<BucketedSector<Bond>> sectors = MakeTreasurySectors();
+    for (const auto& sector : sectors) pipeline.AddBucketedSector(sector);
+    pipeline.EnableAsync();
+
+    auto start = std::chrono::steady_clock::now();
+    pipeline.Run("Data/Input/");
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::vector<size_t> routed = pipeline.GetRoutedCounts();
+    for (size_t i = 0; i < routed.size(); ++i) {
+        std::cout << "  shard " << i << ": " << routed[i] << " records\n";
+    }
+    std::cout << "  " << elapsed.count() << "s\n";
+    for (const auto& sector : sectors) {
+        std::cout << "  " << sector.GetName() << " risk: " << pipeline.GetBucketedRisk(sector).GetPV01() << "\n";
+    }
+    std::cout << "====== All Finished! ======" << std::endl;
+    return 0;
+}
+
+// Usage: main [--sequential] [--conflate MILLISECONDS] [--seed N] [--size N] [--generate-only]
+//             [--metrics FILE] [--metrics-interval MILLISECONDS]
+//             [--journal] [--snapshot FILE] [--restore FILE]
+//             [--replay SPEED] [--replay-duration SECONDS] [--timestamped]
+//             [--swaps] [--pin-threads] [--shards N]
+//   By default each input feed runs on its own thread; --sequential reads
+//   the feeds one after another on the main thread. --conflate publishes
+//   at most one price per product per interval to AlgoStreamingService.
+//   --seed and --size fix the generated inputs (prices per bond), and
+//   --generate-only stops once they are written. --metrics instruments
+//   every service link and rewrites FILE in Prometheus text format every
+//   interval (1000ms by default). --journal writes the historical files as
+//   binary journals. --snapshot saves positions, risk, inquiries and order
+//   books to FILE once the feeds are done (and between feeds when
+//   sequential); --restore rebuilds the services from FILE and the tails
+//   of the journals written since, instead of generating and reading the
+//   inputs again (Tools/SnapshotCheck.cpp compares two snapshots). --replay
+//   merges the four feeds into one time-ordered stream on the main thread,
+//   at SPEED times real time (0 for as fast as possible), and reports
+//   latency from each record's scheduled time. Each feed is spread evenly
+//   over --replay-duration (10s by default); --timestamped instead
+//   generates every line with its time in microseconds, each bond's records
+//   arriving at random over the duration, and replays them at those times.
+//   Only a replay can read such inputs. --swaps also generates feeds for the IRSwap universe and
+//   runs a second, IRSwap-typed pipeline over them on its own thread, with
+//   its own input and output directories; --pin-threads pins each thread
+//   to its own core. --shards splits the bond services by CUSIP over N
+//   worker threads, each writing under Data/Output/shard<i>/; of the
+//   options above it takes only --pin-threads and the generator's.
+int main(int argc, char* argv[]) {
+    bool sequential = false;
+    bool generateOnly = false;
+    long conflateMilliseconds = 0;
+    std::string metricsPath;
+    long metricsMilliseconds = 1000;
+    HistoricalFormat historicalFormat = HistoricalFormat::TEXT;
+    std::string snapshotPath;
+    std::string restorePath;
+    double replaySpeed = -1.0;
+    double replaySeconds = 10.0;
+    bool timestamped = false;
+    bool swaps = false;
+    bool pinThreads = false;
+    size_t shardCount = 0;
+    GeneratorConfig generatorConfig = GeneratorConfig::Random();
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--sequential") {
+            sequential = true;
+        } else if (arg == "--generate-only") {
+            generateOnly = true;
+        } else if (arg == "--conflate" && i + 1 < argc) {
+            conflateMilliseconds = std::atol(argv[++i]);
+        } else if (arg == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        } else if (arg == "--metrics-interval" && i + 1 < argc && std::atol(argv[i + 1]) > 0) {
+            metricsMilliseconds = std::atol(argv[++i]);
+        } else if (arg == "--journal") {
+            historicalFormat = HistoricalFormat::BINARY;
+        } else if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (arg == "--restore" && i + 1 < argc) {
+            restorePath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc && std::atof(argv[i + 1]) >= 0.0) {
+            replaySpeed = std::atof(argv[++i]);
+        } else if (arg == "--replay-duration" && i + 1 < argc && std::atof(argv[i + 1]) > 0.0) {
+            replaySeconds = std::atof(argv[++i]);
+        } else if (arg == "--timestamped") {
+            timestamped = true;
+        } else if (arg == "--swaps") {
+            swaps = true;
+        } else if (arg == "--pin-threads") {
+            pinThreads = true;
+        } else if (arg == "--shards" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            shardCount = static_cast<size_t>(std::atoi(argv[++i]));
+        } else if (arg == "--seed" && i + 1 < argc) {
+            generatorConfig.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--size" && i + 1 < argc && std::atoi(argv[i + 1]) > 0) {
+            generatorConfig.dataSize = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Error: usage: " << argv[0] << " [--sequential] [--conflate MILLISECONDS]"
+                      << " [--seed N] [--size N] [--generate-only]"
+                      << " [--metrics FILE] [--metrics-interval MILLISECONDS]"
+                      << " [--journal] [--snapshot FILE] [--restore FILE]"
+                      << " [--replay SPEED] [--replay-duration SECONDS] [--timestamped]"
+                      << " [--swaps] [--pin-threads] [--shards N]" << std::endl;
+            return 1;
+        }
+    }
+    // A restore already holds every input the saving run applied
+    if (!restorePath.empty() && (generateOnly || replaySpeed >= 0.0 || swaps)) {
+        std::cerr << "Error: --restore cannot be combined with --generate-only, --replay or --swaps" << std::endl;
+        return 1;
+    }
+    // The sharded pipeline builds its own services, without the options below
+    if (shardCount > 0) {
+        std::string unsupported;
+        auto reject = [&unsupported](bool given, const char* flag) {
+            if (given) unsupported += std::string(" ") + flag;
+        };
+        reject(sequential, "--sequential");
+        reject(conflateMilliseconds > 0, "--conflate");
+        reject(!metricsPath.empty(), "--metrics");
+        reject(historicalFormat == HistoricalFormat::BINARY, "--journal");
+        reject(!snapshotPath.empty(), "--snapshot");
+        reject(!restorePath.empty(), "--restore");
+        reject(replaySpeed >= 0.0, "--replay");
+        reject(timestamped, "--timestamped");
+        reject(swaps, "--swaps");
+        if (!unsupported.empty()) {
+            std::cerr << "Error: --shards cannot be combined with" << unsupported << std::endl;
+            return 1;
+        }
+    }
+    // The connectors read untimed lines; only a replay strips the timestamps
+    if (timestamped && replaySpeed < 0.0) {
+        std::cerr << "Error: --timestamped needs --replay" << std::endl;
+        return 1;
+    }
+    if (timestamped) generatorConfig.timestampMicros = static_cast<int64_t>(replaySeconds * 1e6);
+    // A replay delivers every feed from the main thread
+    if (replaySpeed >= 0.0) sequential = true;
+
+    // Step 1: Generate all data (a restore reads no inputs)
+    const std::string swapInputDirectory = std::string("Data/Input/") + ProductTraits<IRSwap>::name + "/";
+    const std::string swapOutputDirectory = DEFAULT_OUTPUT_DIRECTORY + ProductTraits<IRSwap>::name + "/";
+    if (restorePath.empty()) {
+        std::cout << "====== Data Generating... ======" << std::endl;
+        std::cout << "  seed " << generatorConfig.seed << ", size " << generatorConfig.dataSize << "\n";
+        GenerateAll(generatorConfig);
+        if (swaps) {
+            // The swap feeds use the same seed, under their own directory, and
+            // are read untimed by the swap pipeline
+            GeneratorConfig swapConfig = generatorConfig;
+            swapConfig.productIds = ProductTraits<IRSwap>::GetProductIds();
+            swapConfig.directory = swapInputDirectory;
+            swapConfig.timestampMicros = 0;
+            std::filesystem::create_directories(swapConfig.directory);
+            GenerateAll(swapConfig);
+        }
+        std::cout << "====== Data Generated! ======" << std::endl;
+    }
+    if (generateOnly) return 0;
+
+#ifdef STATIC_PIPELINE
+    return RunStaticPipeline();
+#endif
+    if (shardCount > 0) return RunShardedPipeline(shardCount, pinThreads);
 
     // Step 2: Use Bond as the productType, register all the service
     std::cout << "====== Services initializing... ======\n";
+    // The swap pipeline owns its own IRSwap-typed services and shares none with the bonds
+    std::unique_ptr<StaticPipeline<IRSwap>> swapPipeline;
+    if (swaps) {
+        std::filesystem::create_directories(swapOutputDirectory);
+        swapPipeline.reset(new StaticPipeline<IRSwap>(swapOutputDirectory));
+        swapPipeline->EnableAsync();
+    }
     MarketDataService<Bond> BondMarketDataService;
     PricingService<Bond> BondPricingService;
     TradeBookingService<Bond> BondTradeBookingService;
@@ -45,45 +245,211 @@ int main() {
     StreamingService<Bond> BondStreamingService;
     InquiryService<Bond> BondInquiryService;
     GUIService<Bond> BondGUIService;
-    HistoricalDataService<Position<Bond>> BondHistoricalPositionService("Position");
-    HistoricalDataService<PV01<Bond>> BondHistoricalRiskService("Risk");
-    HistoricalDataService<ExecutionOrder<Bond>> BondHistoricalExecutionService("Execution");
-    HistoricalDataService<PriceStream<Bond>> BondHistoricalStreamingService("Streaming");
-    HistoricalDataService<Inquiry<Bond>> BondHistoricalInquiryService("Inquiry");
+    HistoricalDataService<Position<Bond>> BondHistoricalPositionService("Position", FlushPolicy(), historicalFormat);
+    HistoricalDataService<PV01<Bond>> BondHistoricalRiskService("Risk", FlushPolicy(), historicalFormat);
+    HistoricalDataService<ExecutionOrder<Bond>> BondHistoricalExecutionService("Execution", FlushPolicy(), historicalFormat);
+    HistoricalDataService<PriceStream<Bond>> BondHistoricalStreamingService("Streaming", FlushPolicy(), historicalFormat);
+    HistoricalDataService<Inquiry<Bond>> BondHistoricalInquiryService("Inquiry", FlushPolicy(), historicalFormat);
+
+    // Persist on background writer threads so the listener chains never block on disk
+    BondGUIService.EnableAsync();
+    BondHistoricalPositionService.EnableAsync();
+    BondHistoricalRiskService.EnableAsync();
+    BondHistoricalExecutionService.EnableAsync();
+    BondHistoricalStreamingService.EnableAsync();
+    BondHistoricalInquiryService.EnableAsync();
+    // Keep front-end, belly and long-end risk up to date as positions change
+    for (const auto& sector : MakeTreasurySectors()) BondRiskService.AddBucketedSector(sector);
     std::cout << "====== Services initialized! ======\n";
 
-    // Step 3: Link corresponding service
+    // Step 3: Link corresponding service. Each link is wrapped by
+    // Instrument, which returns the listener unchanged unless --metrics is given.
     std::cout << "====== Services linking... ======" << std::endl;
-    BondPricingService.AddListener(BondGUIService.GetListener());
-    BondPricingService.AddListener(BondAlgoStreamingService.GetListener());
-    BondAlgoStreamingService.AddListener(BondStreamingService.GetListener());
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    if (!metricsPath.empty()) metrics.Enable();
+    BondPricingService.AddListener(Instrument(BondGUIService.GetListener(), "GUI", "Pricing"));
+    ConflatingListener<Price<Bond>>* pricingConflation = nullptr;
+    if (conflateMilliseconds > 0) {
+        ConflationPolicy policy;
+        policy.interval = std::chrono::milliseconds(conflateMilliseconds);
+        pricingConflation = new ConflatingListener<Price<Bond>>(policy);
+        pricingConflation->AddListener(Instrument(BondAlgoStreamingService.GetListener(), "AlgoStreaming", "Conflation"));
+        BondPricingService.AddListener(Instrument(pricingConflation, "Conflation", "Pricing"));
+    } else {
+        BondPricingService.AddListener(Instrument(BondAlgoStreamingService.GetListener(), "AlgoStreaming", "Pricing"));
+    }
+    BondAlgoStreamingService.AddListener(Instrument(BondStreamingService.GetListener(), "Streaming", "AlgoStreaming"));
     BondStreamingService.AddListener(
-        BondHistoricalStreamingService.GetServiceListener());
-    BondMarketDataService.AddListener(BondAlgoExecutionService.GetListener());
-    BondAlgoExecutionService.AddListener(BondExecutionService.GetListener());
+        Instrument(BondHistoricalStreamingService.GetServiceListener(), "HistoricalStreaming", "Streaming"));
+    BondMarketDataService.AddTopOfBookListener(
+        Instrument(BondAlgoExecutionService.GetListener(), "AlgoExecution", "MarketData"));
+    BondAlgoExecutionService.AddListener(Instrument(BondExecutionService.GetListener(), "Execution", "AlgoExecution"));
     BondExecutionService.AddListener(
-        BondHistoricalExecutionService.GetServiceListener());
-    BondExecutionService.AddListener(BondTradeBookingService.GetListener());
-    BondTradeBookingService.AddListener(BondPositionService.GetListener());
-    BondPositionService.AddListener(BondRiskService.GetListener());
+        Instrument(BondHistoricalExecutionService.GetServiceListener(), "HistoricalExecution", "Execution"));
+    // TradeBookingService is fed by two chains. When threaded, both reach it
+    // through queued edges drained by the booking thread, which owns it and
+    // everything downstream: executions first, then trades.txt, as in a
+    // sequential run.
+    EventBus bus;
+    TradeBookingService<Bond> BondTradeFeedService;
+    HandoffInput* executionEdge = bus.Connect(BondExecutionService,
+                                              Instrument(BondTradeBookingService.GetListener(), "TradeBooking", "Execution"),
+                                              sequential ? Delivery::INLINE : Delivery::QUEUED);
+    HandoffInput* tradeEdge = bus.Connect(BondTradeFeedService,
+                                          Instrument(new ReplayListener<string, Trade<Bond>>(&BondTradeBookingService),
+                                                     "TradeBooking", "TradeFeed"),
+                                          Delivery::QUEUED);
+    BondTradeBookingService.AddListener(Instrument(BondPositionService.GetListener(), "Position", "TradeBooking"));
+    BondPositionService.AddListener(Instrument(BondRiskService.GetListener(), "Risk", "Position"));
     BondPositionService.AddListener(
-        BondHistoricalPositionService.GetServiceListener());
-    BondRiskService.AddListener(BondHistoricalRiskService.GetServiceListener());
+        Instrument(BondHistoricalPositionService.GetServiceListener(), "HistoricalPosition", "Position"));
+    BondRiskService.AddListener(Instrument(BondHistoricalRiskService.GetServiceListener(), "HistoricalRisk", "Risk"));
     BondInquiryService.AddListener(
-        BondHistoricalInquiryService.GetServiceListener());
+        Instrument(BondHistoricalInquiryService.GetServiceListener(), "HistoricalInquiry", "Inquiry"));
+    BondPricingService.GetConnector()->SetMetrics(InstrumentInput("Pricing", "prices.txt"));
+    if (sequential) {
+        BondTradeBookingService.GetConnector()->SetMetrics(InstrumentInput("TradeBooking", "trades.txt"));
+    } else {
+        BondTradeFeedService.GetConnector()->SetMetrics(InstrumentInput("TradeFeed", "trades.txt"));
+    }
+
+    std::unique_ptr<MetricsReporter> metricsReporter;
+    if (metrics.IsEnabled()) {
+        if (executionEdge) metrics.AddQueue("booking.executions", [executionEdge]() { return executionEdge->GetDepth(); });
+        metrics.AddQueue("booking.trades", [tradeEdge]() { return tradeEdge->GetDepth(); });
+        metrics.AddQueue("writer.gui", [&]() { return BondGUIService.GetAsyncQueueDepth(); });
+        metrics.AddQueue("writer.position", [&]() { return BondHistoricalPositionService.GetAsyncQueueDepth(); });
+        metrics.AddQueue("writer.risk", [&]() { return BondHistoricalRiskService.GetAsyncQueueDepth(); });
+        metrics.AddQueue("writer.execution", [&]() { return BondHistoricalExecutionService.GetAsyncQueueDepth(); });
+        metrics.AddQueue("writer.streaming", [&]() { return BondHistoricalStreamingService.GetAsyncQueueDepth(); });
+        metrics.AddQueue("writer.inquiry", [&]() { return BondHistoricalInquiryService.GetAsyncQueueDepth(); });
+        metricsReporter.reset(new MetricsReporter(metricsPath, std::chrono::milliseconds(metricsMilliseconds)));
+    }
     std::cout << "====== Services linked! ======" << std::endl;
 
-    // Step 4: Read data and write to output
+    // Warm restart: load the last snapshot, then the journal records written
+    // after it. Those records hold full state, so together they replace
+    // reading the feeds that produced them.
+    ServiceSnapshot<Bond> snapshot(BondPositionService, BondRiskService, BondInquiryService, BondMarketDataService);
+    snapshot.AddJournalWriter(BondHistoricalPositionService);
+    snapshot.AddJournalWriter(BondHistoricalRiskService);
+    snapshot.AddJournalWriter(BondHistoricalInquiryService);
+    if (!restorePath.empty()) {
+        SnapshotRestoreStats restoreStats;
+        if (!snapshot.Restore(restorePath, restoreStats)) {
+            std::cerr << "Error: Unable to restore " << restorePath << std::endl;
+            return 1;
+        }
+        std::cout << "  Restored " << restoreStats.snapshotRecords << " records from " << restorePath
+                  << ", replayed " << restoreStats.replayedRecords << " journal records\n";
+    }
+    const auto snapshotInterval = std::chrono::milliseconds(1000);
+
+    // Step 4: Read data and write to output. Prices and trades reach their
+    // services in batches, so each hop dispatches once per batch.
+    const size_t feedBatchSize = 64;
+    BondPricingService.GetConnector()->SetBatchSize(feedBatchSize);
+    BondTradeBookingService.GetConnector()->SetBatchSize(feedBatchSize);
+    BondTradeFeedService.GetConnector()->SetBatchSize(feedBatchSize);
+
     const string dirPath = "Data/Input/";
-    ifstream priceData(dirPath + "prices.txt");
-
-    BondPricingService.GetConnector()->Subscribe(priceData);
-    ifstream marketData(dirPath + "marketdata.txt");
-    BondMarketDataService.GetConnector()->Subscribe(marketData);
-    ifstream tradeData(dirPath + "trades.txt");
-    BondTradeBookingService.GetConnector()->Subscribe(tradeData);
-    ifstream inquiryData(dirPath + "inquiries.txt");
-    BondInquiryService.GetConnector()->Subscribe(inquiryData);
+    MappedFile priceData(dirPath + "prices.txt");
+    MappedFile marketData(dirPath + "marketdata.txt");
+    MappedFile tradeData(dirPath + "trades.txt");
+    MappedFile inquiryData(dirPath + "inquiries.txt");
+    auto readPrices = [&]() {
+        BondPricingService.GetConnector()->Subscribe(priceData);
+        if (pricingConflation) pricingConflation->Flush();
+    };
+    if (!restorePath.empty())
+    {
+        // Nothing to read: the restored state already reflects the inputs
+    }
+    else if (replaySpeed >= 0.0)
+    {
+        ReplayDriver replay;
+        replay.SetSpeed(replaySpeed);
+        auto addFeed = [&](const string& name, MappedFile& data, ReplayDriver::Handler handler,
+                           function<void()> flush = {}) {
+            if (timestamped) {
+                replay.AddTimestampedFeed(name, data, std::move(handler), std::move(flush));
+            } else {
+                replay.AddFeed(name, data, std::move(handler), static_cast<int64_t>(replaySeconds * 1e6),
+                               std::move(flush));
+            }
+        };
+        PricingConnector<Bond>* pricingConnector = BondPricingService.GetConnector();
+        TradeBookingConnector<Bond>* tradeConnector = BondTradeBookingService.GetConnector();
+        MarketDataConnector<Bond>* marketDataConnector = BondMarketDataService.GetConnector();
+        InquiryConnector<Bond>* inquiryConnector = BondInquiryService.GetConnector();
+        addFeed("prices", priceData, [pricingConnector](string_view line) { pricingConnector->ProcessLine(line); },
+                [pricingConnector]() { pricingConnector->Flush(); });
+        addFeed("marketdata", marketData,
+                [marketDataConnector](string_view line) { marketDataConnector->ProcessLine(line); });
+        addFeed("trades", tradeData, [tradeConnector](string_view line) { tradeConnector->ProcessLine(line); },
+                [tradeConnector]() { tradeConnector->Flush(); });
+        addFeed("inquiries", inquiryData,
+                [inquiryConnector](string_view line) { inquiryConnector->ProcessLine(line); });
+
+        ReplayStats replayStats = replay.Run();
+        if (pricingConflation) pricingConflation->Flush();
+        std::cout << "  Replayed " << replayStats.records << " records in " << replayStats.seconds
+                  << "s, lag p99 " << replayStats.lag.ValueAtPercentile(99.0) << "ns\n";
+        for (const auto& feedStats : replayStats.feeds)
+        {
+            std::cout << "  " << feedStats.name << ": " << feedStats.records << " records, latency p50 "
+                      << feedStats.latency.ValueAtPercentile(50.0) << "ns, p99 "
+                      << feedStats.latency.ValueAtPercentile(99.0) << "ns, max "
+                      << feedStats.latency.GetMax() << "ns\n";
+        }
+    }
+    else if (sequential)
+    {
+        // Between feeds no service is being updated, so snapshots are safe there
+        auto saveIfDue = [&]() {
+            if (!snapshotPath.empty()) snapshot.SaveIfDue(snapshotPath, snapshotInterval);
+        };
+        readPrices();
+        saveIfDue();
+        BondMarketDataService.GetConnector()->Subscribe(marketData);
+        saveIfDue();
+        BondTradeBookingService.GetConnector()->Subscribe(tradeData);
+        saveIfDue();
+        BondInquiryService.GetConnector()->Subscribe(inquiryData);
+    }
+    else
+    {
+        ThreadedRuntime runtime(pinThreads);
+        runtime.AddFeed("prices", readPrices);
+        runtime.AddFeed("marketdata", [&]() { BondMarketDataService.GetConnector()->Subscribe(marketData); },
+                        {executionEdge});
+        runtime.AddFeed("trades", [&]() { BondTradeFeedService.GetConnector()->Subscribe(tradeData); },
+                        {tradeEdge});
+        runtime.AddFeed("inquiries", [&]() { BondInquiryService.GetConnector()->Subscribe(inquiryData); });
+        runtime.AddStage("booking", {executionEdge, tradeEdge}, StageOrder::IN_ORDER);
+        if (swapPipeline) runtime.AddFeed("swaps", [&]() { swapPipeline->Run(swapInputDirectory); });
+        runtime.Run();
+
+        for (const auto& timing : runtime.GetTimings())
+        {
+            std::cout << "  " << timing.first << " thread: " << timing.second << "s\n";
+        }
+    }
+    if (swapPipeline && sequential) swapPipeline->Run(swapInputDirectory);
+    if (!snapshotPath.empty() && snapshot.Save(snapshotPath)) {
+        std::cout << "  Snapshot saved to " << snapshotPath << "\n";
+    }
+    ThrottleStats guiStats = BondGUIService.GetThrottleStats();
+    std::cout << "  GUI throttle: " << guiStats.accepted << " accepted, "
+              << guiStats.suppressed << " suppressed\n";
+    const LatencyHistogram& rfqLatency = BondInquiryService.GetRfqLatency();
+    std::cout << "  RFQ turnaround: " << rfqLatency.GetCount() << " inquiries, p50 "
+              << rfqLatency.ValueAtPercentile(50.0) << "ns, p99 " << rfqLatency.ValueAtPercentile(99.0) << "ns\n";
+    if (metricsReporter) {
+        metricsReporter->Stop();
+        std::cout << "  Metrics (" << metricsPath << "):\n";
+        metrics.WriteSummary(std::cout);
+    }
     std::cout << "====== All Finished! ======" << std::endl;
 
     return 0;
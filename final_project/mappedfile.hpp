@@ -0,0 +1,172 @@
+/**
+ * mappedfile.hpp
+ * Defines a read-only memory-mapped input file that connectors can scan line
+ * by line in place, as a faster alternative to reading through an ifstream.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Files up to this size are mapped in one piece; larger files are scanned
+// through a sliding window of this many bytes
+constexpr size_t DEFAULT_MAP_WINDOW = size_t(1) << 30;
+
+/**
+ * MappedFile
+ * Maps an input file into memory and hands each line to a callback as a
+ * string_view into the mapping, so no per-line copy is made. Files bigger
+ * than the window are mapped chunk by chunk; only a line straddling two
+ * chunks is copied into a carry-over buffer.
+ */
+class MappedFile
+{
+public:
+    // Open the file at _path; check IsOpen() before scanning
+    explicit MappedFile(const string& _path, size_t _windowBytes = DEFAULT_MAP_WINDOW);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Whether the file was opened successfully
+    bool IsOpen() const;
+
+    // Size of the file in bytes
+    size_t GetSize() const;
+
+    // Call onLine(string_view) for every line, with any trailing '\r' removed
+    template <typename F>
+    void ForEachLine(F&& onLine);
+
+private:
+    template <typename F>
+    static void EmitLine(string_view line, F& onLine);
+
+    string path;
+    int fd;
+    size_t fileSize;
+    size_t windowBytes;
+};
+
+// -------------------- Implementation of MappedFile --------------------
+
+MappedFile::MappedFile(const string& _path, size_t _windowBytes)
+    : path(_path), fd(-1), fileSize(0), windowBytes(_windowBytes)
+{
+    // Windows must start on a page boundary, so keep their size page-aligned
+    size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    windowBytes = max(pageSize, (windowBytes + pageSize - 1) / pageSize * pageSize);
+
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        cerr << "Error: Unable to open file at " << path << endl;
+        return;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0)
+    {
+        cerr << "Error: Unable to stat file at " << path << endl;
+        close(fd);
+        fd = -1;
+        return;
+    }
+    fileSize = static_cast<size_t>(fileStat.st_size);
+}
+
+MappedFile::~MappedFile()
+{
+    if (fd >= 0) close(fd);
+}
+
+bool MappedFile::IsOpen() const
+{
+    return fd >= 0;
+}
+
+size_t MappedFile::GetSize() const
+{
+    return fileSize;
+}
+
+template <typename F>
+void MappedFile::EmitLine(string_view line, F& onLine)
+{
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    onLine(line);
+}
+
+template <typename F>
+void MappedFile::ForEachLine(F&& onLine)
+{
+    if (fd < 0) return;
+
+    // Partial line left at the end of the previous window
+    string carry;
+
+    for (size_t offset = 0; offset < fileSize; offset += windowBytes)
+    {
+        size_t length = min(windowBytes, fileSize - offset);
+        void* mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
+        if (mapping == MAP_FAILED)
+        {
+            cerr << "Error: Unable to map file at " << path << endl;
+            return;
+        }
+        madvise(mapping, length, MADV_SEQUENTIAL);
+
+        const char* cursor = static_cast<const char*>(mapping);
+        const char* end = cursor + length;
+
+        // Complete the line carried over from the previous window
+        if (!carry.empty())
+        {
+            const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            if (newline == nullptr)
+            {
+                carry.append(cursor, end);
+                munmap(mapping, length);
+                continue;
+            }
+            carry.append(cursor, newline);
+            EmitLine(carry, onLine);
+            carry.clear();
+            cursor = newline + 1;
+        }
+
+        // Hand out every complete line in place
+        while (cursor < end)
+        {
+            const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+            if (newline == nullptr)
+            {
+                carry.assign(cursor, end);
+                break;
+            }
+            EmitLine(string_view(cursor, newline - cursor), onLine);
+            cursor = newline + 1;
+        }
+
+        munmap(mapping, length);
+    }
+
+    // Last line without a trailing newline
+    if (!carry.empty()) EmitLine(carry, onLine);
+}
+
+#endif // MAPPED_FILE_HPP
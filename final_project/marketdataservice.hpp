@@ -11,6 +11,8 @@
 #ifndef MARKET_DATA_SERVICE_HPP
 #define MARKET_DATA_SERVICE_HPP
 
+#include "mappedfile.hpp"
+#include "productfactory.hpp"
 #include "soa.hpp"
 #include "utility.hpp"
 #include <string>
@@ -46,15 +48,15 @@ class Order
 public:
     // Constructors
     Order() = default;
-    Order(double _price, long _quantity, PricingSide _side);
+    Order(Tick256 _price, long _quantity, PricingSide _side);
 
     // Accessors
-    double GetPrice() const;
+    Tick256 GetPrice() const;
     long GetQuantity() const;
     PricingSide GetSide() const;
 
 private:
-    double price;
+    Tick256 price;
     long quantity;
     PricingSide side;
 };
@@ -79,11 +81,103 @@ private:
     Order offerOrder;
 };
 
+// ============================================================================
+// CLASS: BookSide<N>
+// ============================================================================
+
+// Maximum number of price levels held on each side of an order book
+constexpr size_t ORDER_BOOK_CAPACITY = 16;
+
+/**
+ * A price level: a price in 1/256 ticks and the total quantity resting there.
+ */
+struct PriceLevel
+{
+    Tick256 price;
+    long quantity;
+};
+
+/**
+ * A change to one price level of a book; a quantity <= 0 deletes the level.
+ */
+struct LevelUpdate
+{
+    PricingSide side;
+    Tick256 price;
+    long quantity;
+};
+
+/**
+ * One side of an order book, stored as a contiguous array of at most N price
+ * levels sorted best first (highest bid, lowest offer). Level 0 is the top of
+ * book. The side is aggregated by price: orders added at a price already
+ * held are summed into its level, so there is one level per distinct price.
+ * When the side is full, a new level better than the worst one pushes the
+ * worst level out; either way a level is lost, and GetDroppedLevelCount
+ * counts it.
+ */
+template <size_t N>
+class BookSide
+{
+public:
+    explicit BookSide(PricingSide _side = BID);
+
+    // Number of populated levels
+    size_t GetLevelCount() const;
+    bool IsEmpty() const;
+
+    // Level by depth, 0 being the best price
+    const PriceLevel& GetLevel(size_t depth) const;
+    const PriceLevel& GetBest() const;
+
+    // Add quantity at a price, creating the level if it is new
+    void AddLevel(Tick256 price, long quantity);
+
+    // Replace the quantity at a price; a quantity <= 0 deletes the level
+    void ModifyLevel(Tick256 price, long quantity);
+
+    // Remove the level at a price, if present
+    void DeleteLevel(Tick256 price);
+
+    // Replace the levels with those of source pooled into buckets of
+    // bucketTicks ticks, in one pass: bids round down and offers up to their
+    // bucket, so no bucket quotes better than the orders in it
+    void AssignBucketed(const BookSide<N>& source, long bucketTicks);
+
+    // Remove all levels
+    void Clear();
+
+    // Append the updates that turn this side into target: deletions first,
+    // so applying them in order never overflows the side, then new or
+    // changed levels
+    void AppendDelta(const BookSide<N>& target, vector<LevelUpdate>& updates) const;
+
+    // Levels lost to a full side since construction (Clear keeps the count)
+    size_t GetDroppedLevelCount() const;
+
+private:
+    // Whether price a ranks ahead of price b on this side
+    bool IsBetter(Tick256 a, Tick256 b) const;
+
+    // Index of the level at price, or of where it would be inserted
+    size_t FindLevel(Tick256 price, bool& found) const;
+
+    void InsertLevel(size_t index, Tick256 price, long quantity);
+
+    PriceLevel levels[N];
+    size_t levelCount;
+    size_t droppedLevels;
+    PricingSide side;
+};
+
 // ============================================================================
 // CLASS: OrderBook<T>
 // ============================================================================
 /**
  * An order book containing a bid stack and an offer stack.
+ * Both stacks are fixed-capacity arrays of price levels in integer ticks,
+ * kept sorted so the top of book is read in O(1), and can be updated in
+ * place level by level.
  * Type T is the product type.
  */
 template <typename T>
@@ -91,22 +185,90 @@ class OrderBook
 {
 public:
     // Constructors
-    OrderBook() = default;
+    OrderBook();
     OrderBook(const T& _product, const vector<Order>& _bidStack,
               const vector<Order>& _offerStack);
 
     // Accessors
     const T& GetProduct() const;
-    const vector<Order>& GetBidStack() const;
-    const vector<Order>& GetOfferStack() const;
+    void SetProduct(const T& _product);
+
+    // One order per price level, best first, holding the total quantity at
+    // that price (orders at the same price are merged when added)
+    vector<Order> GetBidStack() const;
+    vector<Order> GetOfferStack() const;
+
+    // The level arrays themselves
+    const BookSide<ORDER_BOOK_CAPACITY>& GetBids() const;
+    const BookSide<ORDER_BOOK_CAPACITY>& GetOffers() const;
 
     // Retrieve the highest bid and the lowest offer
     const BidOffer GetBidOffer() const;
 
+    // Incremental updates, prices in 1/256 ticks
+    void AddLevel(PricingSide side, Tick256 price, long quantity);
+    void ModifyLevel(PricingSide side, Tick256 price, long quantity);
+    void DeleteLevel(PricingSide side, Tick256 price);
+    void ApplyUpdate(const LevelUpdate& update);
+
+    // Append the updates that turn this book into target, deletions first
+    void AppendDelta(const OrderBook<T>& target, vector<LevelUpdate>& updates) const;
+
+    // Levels lost to a full side, over both sides
+    size_t GetDroppedLevelCount() const;
+
+    // Replace this book with source pooled into buckets of bucketTicks ticks
+    void AssignBucketed(const OrderBook<T>& source, long bucketTicks);
+
+    // Remove every level on both sides
+    void Clear();
+
+private:
+    BookSide<ORDER_BOOK_CAPACITY>& GetSide(PricingSide side);
+
+    ProductRef<T> product;
+    BookSide<ORDER_BOOK_CAPACITY> bidLevels;
+    BookSide<ORDER_BOOK_CAPACITY> offerLevels;
+};
+
+// ============================================================================
+// CLASS: TopOfBook<T>
+// ============================================================================
+/**
+ * The inside market of an order book: best bid and offer price (in 1/256
+ * ticks) and size, with a flag telling whether any of them differ from the
+ * previous top of book published for the product.
+ * Type T is the product type.
+ */
+template <typename T>
+class TopOfBook
+{
+public:
+    // Constructors
+    TopOfBook() = default;
+    TopOfBook(const OrderBook<T>& _book, bool _changed = true);
+
+    // Accessors
+    const T& GetProduct() const;
+    Tick256 GetBidPrice() const;
+    Tick256 GetOfferPrice() const;
+    long GetBidQuantity() const;
+    long GetOfferQuantity() const;
+
+    // Whether the inside market moved since the previous event for the product
+    bool IsChanged() const;
+    void SetChanged(bool _changed);
+
+    // Same best prices and sizes
+    bool SameInside(const TopOfBook<T>& _other) const;
+
 private:
-    T product;
-    vector<Order> bidStack;
-    vector<Order> offerStack;
+    ProductRef<T> product;
+    Tick256 bidPrice;
+    long bidQuantity = 0;
+    Tick256 offerPrice;
+    long offerQuantity = 0;
+    bool changed = false;
 };
 
 // Forward declaration
@@ -134,12 +296,26 @@ public:
     // Callback for new or updated data invoked by the connector
     void OnMessage(OrderBook<T>& _data) override;
 
+    // Store a book and pass it to bookSink(OrderBook<T>&) and its top of
+    // book to topSink(TopOfBook<T>&) instead of the listeners
+    template <typename BookSink, typename TopSink>
+    void OnMessage(OrderBook<T>& _data, BookSink&& bookSink, TopSink&& topSink);
+
     // Add a listener
     void AddListener(ServiceListener<OrderBook<T>>* listener) override;
 
     // Retrieve all listeners
     const vector<ServiceListener<OrderBook<T>>*>& GetListeners() const override;
 
+    // Add a listener for the top of book event published with every book
+    void AddTopOfBookListener(ServiceListener<TopOfBook<T>>* listener);
+
+    // Retrieve all top of book listeners
+    const vector<ServiceListener<TopOfBook<T>>*>& GetTopOfBookListeners() const;
+
+    // Last top of book published for a product
+    const TopOfBook<T>& GetTopOfBook(const string& productId);
+
     // Get the associated connector
     MarketDataConnector<T>* GetConnector();
 
@@ -149,15 +325,55 @@ public:
     // Return the best (highest bid, lowest offer) for a given product ID
     const BidOffer GetBestBidOffer(const string& productId);
 
-    // Aggregate orders at each price level for a given product ID
-    const OrderBook<T>& AggregateDepth(const string& productId);
+    // Depth of a product pooled into price buckets of bucketTicks ticks
+    // (e.g. 8 for 32nds) in a caller-owned book, best bucket first; returns
+    // false (and clears out) if the product has no book. Books already hold
+    // one level per price (see BookSide), so a bucket of 1 tick is a plain
+    // copy. Only reads the service, so concurrent callers are safe as long
+    // as no book is being updated at the time.
+    bool AggregateDepth(const string& productId, long bucketTicks, OrderBook<T>& out) const;
+
+    // As above, returning the aggregated book (empty if there is none)
+    OrderBook<T> AggregateDepth(const string& productId, long bucketTicks) const;
+
+    // Apply one level delta (price in ticks, quantity <= 0 deletes the level)
+    // to the stored book for the product and notify listeners
+    void ApplyLevelUpdate(const T& product, PricingSide side, Tick256 price, long quantity);
+
+    // Apply level deltas in order to the stored book for the product, in
+    // place, then notify listeners once with the updated book
+    void ApplyLevelUpdates(const T& product, Span<LevelUpdate> updates);
+
+    // As above, passing the book to bookSink(OrderBook<T>&) and its top of
+    // book to topSink(TopOfBook<T>&) instead of the listeners
+    template <typename BookSink, typename TopSink>
+    void ApplyLevelUpdates(const T& product, Span<LevelUpdate> updates, BookSink&& bookSink, TopSink&& topSink);
+
+    // The stored book of a product, or nullptr if it has none
+    const OrderBook<T>* FindOrderBook(ProductIndex productIndex) const;
+
+    // Store a book (e.g. from a snapshot) as the product's current book and
+    // last published top of book, without notifying listeners
+    void RestoreOrderBook(const OrderBook<T>& book);
+
+    // Call f(book) for every stored book, in product index order
+    template <typename F>
+    void ForEachOrderBook(F&& f);
 
 private:
     // Internal container of order books, keyed by product identifier
-    map<string, OrderBook<T>> orderBooks;
+    ProductStore<OrderBook<T>> orderBooks;
 
     // Listeners
     vector<ServiceListener<OrderBook<T>>*> listeners;
+    vector<ServiceListener<TopOfBook<T>>*> topListeners;
+
+    // Last top of book published for each product
+    ProductStore<TopOfBook<T>> topsOfBook;
+
+    // Record the book's top of book, flag whether it moved and pass it to topSink
+    template <typename TopSink>
+    void PublishTopOfBook(const OrderBook<T>& book, TopSink&& topSink);
 
     // Connector
     MarketDataConnector<T>* connector;
@@ -186,20 +402,45 @@ public:
     // Subscribe data from an ifstream
     void Subscribe(ifstream& data) override;
 
+    // Subscribe data from a memory-mapped file, scanning it in place
+    void Subscribe(MappedFile& _data);
+
+    // Parse one "productId,price,quantity,side" record into the pending
+    // snapshot; a completed snapshot is applied to the service's book as
+    // level updates, and the listeners notified
+    void ProcessLine(string_view line);
+
+    // As above, passing each updated book to bookSink(OrderBook<T>&) and its
+    // top of book to topSink(TopOfBook<T>&) instead of the listeners
+    template <typename BookSink, typename TopSink>
+    void ProcessLine(string_view line, BookSink&& bookSink, TopSink&& topSink);
+
+    // Levels dropped from snapshots deeper than an order book holds
+    size_t GetDroppedLevelCount() const;
+
 private:
     // Pointer to the MarketDataService
     MarketDataService<T>* service;
+
+    // Snapshot currently being read, and the updates that apply it
+    OrderBook<T> pendingBook;
+    vector<LevelUpdate> pendingUpdates;
+    long orderCount;
+    size_t reportedDrops;
+
+    // Scratch field storage reused across lines
+    LineFields tokens;
 };
 
 // ============================================================================
 // IMPLEMENTATION: Order
 // ============================================================================
-Order::Order(double _price, long _quantity, PricingSide _side)
+Order::Order(Tick256 _price, long _quantity, PricingSide _side)
     : price(_price), quantity(_quantity), side(_side)
 {
 }
 
-double Order::GetPrice() const
+Tick256 Order::GetPrice() const
 {
     return price;
 }
@@ -232,66 +473,403 @@ const Order& BidOffer::GetOfferOrder() const
     return offerOrder;
 }
 
+// ============================================================================
+// IMPLEMENTATION: BookSide<N>
+// ============================================================================
+template <size_t N>
+BookSide<N>::BookSide(PricingSide _side)
+    : levels(), levelCount(0), droppedLevels(0), side(_side)
+{
+}
+
+template <size_t N>
+size_t BookSide<N>::GetLevelCount() const
+{
+    return levelCount;
+}
+
+template <size_t N>
+bool BookSide<N>::IsEmpty() const
+{
+    return levelCount == 0;
+}
+
+template <size_t N>
+const PriceLevel& BookSide<N>::GetLevel(size_t depth) const
+{
+    return levels[depth];
+}
+
+template <size_t N>
+const PriceLevel& BookSide<N>::GetBest() const
+{
+    return levels[0];
+}
+
+template <size_t N>
+bool BookSide<N>::IsBetter(Tick256 a, Tick256 b) const
+{
+    return (side == BID) ? (a > b) : (a < b);
+}
+
+template <size_t N>
+size_t BookSide<N>::FindLevel(Tick256 price, bool& found) const
+{
+    // A handful of levels: a linear scan over one or two cache lines
+    size_t i = 0;
+    while (i < levelCount && IsBetter(levels[i].price, price)) ++i;
+    found = (i < levelCount && levels[i].price == price);
+    return i;
+}
+
+template <size_t N>
+void BookSide<N>::InsertLevel(size_t index, Tick256 price, long quantity)
+{
+    // Past the worst level of a full side: nothing to keep
+    if (index >= N)
+    {
+        ++droppedLevels;
+        return;
+    }
+
+    // A full side pushes its worst level out
+    if (levelCount == N) ++droppedLevels;
+    size_t last = (levelCount < N) ? levelCount : N - 1;
+    for (size_t i = last; i > index; --i)
+    {
+        levels[i] = levels[i - 1];
+    }
+    levels[index] = PriceLevel{price, quantity};
+    if (levelCount < N) ++levelCount;
+}
+
+template <size_t N>
+void BookSide<N>::AddLevel(Tick256 price, long quantity)
+{
+    bool found = false;
+    size_t index = FindLevel(price, found);
+    if (found)
+        levels[index].quantity += quantity;
+    else
+        InsertLevel(index, price, quantity);
+}
+
+template <size_t N>
+void BookSide<N>::ModifyLevel(Tick256 price, long quantity)
+{
+    if (quantity <= 0)
+    {
+        DeleteLevel(price);
+        return;
+    }
+
+    bool found = false;
+    size_t index = FindLevel(price, found);
+    if (found)
+        levels[index].quantity = quantity;
+    else
+        InsertLevel(index, price, quantity);
+}
+
+template <size_t N>
+void BookSide<N>::DeleteLevel(Tick256 price)
+{
+    bool found = false;
+    size_t index = FindLevel(price, found);
+    if (!found) return;
+
+    for (size_t i = index + 1; i < levelCount; ++i)
+    {
+        levels[i - 1] = levels[i];
+    }
+    --levelCount;
+}
+
+template <size_t N>
+void BookSide<N>::AssignBucketed(const BookSide<N>& source, long bucketTicks)
+{
+    bucketTicks = max(bucketTicks, 1L);
+    levelCount = 0;
+    for (size_t i = 0; i < source.levelCount; ++i)
+    {
+        // Rounding keeps the order, so each bucket's levels are adjacent
+        long ticks = source.levels[i].price.Ticks();
+        long offset = ticks % bucketTicks;
+        if (offset < 0) offset += bucketTicks;
+        if (side == BID)
+            ticks -= offset;
+        else if (offset != 0)
+            ticks += bucketTicks - offset;
+
+        Tick256 bucket(ticks);
+        if (levelCount > 0 && levels[levelCount - 1].price == bucket)
+            levels[levelCount - 1].quantity += source.levels[i].quantity;
+        else
+            levels[levelCount++] = PriceLevel{bucket, source.levels[i].quantity};
+    }
+}
+
+template <size_t N>
+void BookSide<N>::Clear()
+{
+    levelCount = 0;
+}
+
+template <size_t N>
+void BookSide<N>::AppendDelta(const BookSide<N>& target, vector<LevelUpdate>& updates) const
+{
+    // Both sides are sorted best first: walk them together once per pass
+    size_t i = 0, j = 0;
+    while (i < levelCount)
+    {
+        if (j < target.levelCount && !IsBetter(levels[i].price, target.levels[j].price))
+        {
+            if (target.levels[j].price == levels[i].price) ++i;
+            ++j;
+            continue;
+        }
+        updates.push_back(LevelUpdate{side, levels[i].price, 0});
+        ++i;
+    }
+
+    i = 0;
+    for (j = 0; j < target.levelCount; ++j)
+    {
+        const PriceLevel& level = target.levels[j];
+        while (i < levelCount && IsBetter(levels[i].price, level.price)) ++i;
+        if (i < levelCount && levels[i].price == level.price && levels[i].quantity == level.quantity) continue;
+        updates.push_back(LevelUpdate{side, level.price, level.quantity});
+    }
+}
+
+template <size_t N>
+size_t BookSide<N>::GetDroppedLevelCount() const
+{
+    return droppedLevels;
+}
+
 // ============================================================================
 // IMPLEMENTATION: OrderBook<T>
 // ============================================================================
+template <typename T>
+OrderBook<T>::OrderBook()
+    : bidLevels(BID), offerLevels(OFFER)
+{
+}
+
 template <typename T>
 OrderBook<T>::OrderBook(const T& _product,
                         const vector<Order>& _bidStack,
                         const vector<Order>& _offerStack)
-    : product(_product), bidStack(_bidStack), offerStack(_offerStack)
+    : product(_product), bidLevels(BID), offerLevels(OFFER)
 {
+    for (auto& bid : _bidStack)
+    {
+        bidLevels.AddLevel(bid.GetPrice(), bid.GetQuantity());
+    }
+    for (auto& offer : _offerStack)
+    {
+        offerLevels.AddLevel(offer.GetPrice(), offer.GetQuantity());
+    }
 }
 
 template <typename T>
 const T& OrderBook<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
 }
 
 template <typename T>
-const vector<Order>& OrderBook<T>::GetBidStack() const
+void OrderBook<T>::SetProduct(const T& _product)
 {
-    return bidStack;
+    product = ProductRef<T>(_product);
 }
 
 template <typename T>
-const vector<Order>& OrderBook<T>::GetOfferStack() const
+vector<Order> OrderBook<T>::GetBidStack() const
 {
-    return offerStack;
+    vector<Order> stack;
+    stack.reserve(bidLevels.GetLevelCount());
+    for (size_t i = 0; i < bidLevels.GetLevelCount(); ++i)
+    {
+        const PriceLevel& level = bidLevels.GetLevel(i);
+        stack.emplace_back(level.price, level.quantity, BID);
+    }
+    return stack;
+}
+
+template <typename T>
+vector<Order> OrderBook<T>::GetOfferStack() const
+{
+    vector<Order> stack;
+    stack.reserve(offerLevels.GetLevelCount());
+    for (size_t i = 0; i < offerLevels.GetLevelCount(); ++i)
+    {
+        const PriceLevel& level = offerLevels.GetLevel(i);
+        stack.emplace_back(level.price, level.quantity, OFFER);
+    }
+    return stack;
+}
+
+template <typename T>
+const BookSide<ORDER_BOOK_CAPACITY>& OrderBook<T>::GetBids() const
+{
+    return bidLevels;
+}
+
+template <typename T>
+const BookSide<ORDER_BOOK_CAPACITY>& OrderBook<T>::GetOffers() const
+{
+    return offerLevels;
 }
 
 template <typename T>
 const BidOffer OrderBook<T>::GetBidOffer() const
 {
-    // Determine highest bid
-    Order bestBid(bidStack[0]);
-    double bestBidPrice = bestBid.GetPrice();
-    for (size_t i = 1; i < bidStack.size(); ++i)
+    // Levels are kept sorted, so the best prices sit at the front
+    Order bestBid(Tick256(), 0, BID);
+    if (!bidLevels.IsEmpty())
     {
-        double currentPrice = bidStack[i].GetPrice();
-        if (currentPrice > bestBidPrice)
-        {
-            bestBid = bidStack[i];
-            bestBidPrice = currentPrice;
-        }
+        const PriceLevel& level = bidLevels.GetBest();
+        bestBid = Order(level.price, level.quantity, BID);
     }
 
-    // Determine lowest offer
-    Order bestOffer(offerStack[0]);
-    double bestOfferPrice = bestOffer.GetPrice();
-    for (size_t j = 1; j < offerStack.size(); ++j)
+    Order bestOffer(Tick256(), 0, OFFER);
+    if (!offerLevels.IsEmpty())
     {
-        double currentPrice = offerStack[j].GetPrice();
-        if (currentPrice < bestOfferPrice)
-        {
-            bestOffer = offerStack[j];
-            bestOfferPrice = currentPrice;
-        }
+        const PriceLevel& level = offerLevels.GetBest();
+        bestOffer = Order(level.price, level.quantity, OFFER);
     }
     return BidOffer(bestBid, bestOffer);
 }
 
+template <typename T>
+BookSide<ORDER_BOOK_CAPACITY>& OrderBook<T>::GetSide(PricingSide side)
+{
+    return (side == BID) ? bidLevels : offerLevels;
+}
+
+template <typename T>
+void OrderBook<T>::AddLevel(PricingSide side, Tick256 price, long quantity)
+{
+    GetSide(side).AddLevel(price, quantity);
+}
+
+template <typename T>
+void OrderBook<T>::ModifyLevel(PricingSide side, Tick256 price, long quantity)
+{
+    GetSide(side).ModifyLevel(price, quantity);
+}
+
+template <typename T>
+void OrderBook<T>::DeleteLevel(PricingSide side, Tick256 price)
+{
+    GetSide(side).DeleteLevel(price);
+}
+
+template <typename T>
+void OrderBook<T>::ApplyUpdate(const LevelUpdate& update)
+{
+    GetSide(update.side).ModifyLevel(update.price, update.quantity);
+}
+
+template <typename T>
+void OrderBook<T>::AppendDelta(const OrderBook<T>& target, vector<LevelUpdate>& updates) const
+{
+    bidLevels.AppendDelta(target.bidLevels, updates);
+    offerLevels.AppendDelta(target.offerLevels, updates);
+}
+
+template <typename T>
+size_t OrderBook<T>::GetDroppedLevelCount() const
+{
+    return bidLevels.GetDroppedLevelCount() + offerLevels.GetDroppedLevelCount();
+}
+
+template <typename T>
+void OrderBook<T>::AssignBucketed(const OrderBook<T>& source, long bucketTicks)
+{
+    product = source.product;
+    bidLevels.AssignBucketed(source.bidLevels, bucketTicks);
+    offerLevels.AssignBucketed(source.offerLevels, bucketTicks);
+}
+
+template <typename T>
+void OrderBook<T>::Clear()
+{
+    bidLevels.Clear();
+    offerLevels.Clear();
+}
+
+// ============================================================================
+// IMPLEMENTATION: TopOfBook<T>
+// ============================================================================
+template <typename T>
+TopOfBook<T>::TopOfBook(const OrderBook<T>& _book, bool _changed)
+    : product(_book.GetProduct()), changed(_changed)
+{
+    // An empty side reads as price 0, size 0, as in GetBidOffer
+    if (!_book.GetBids().IsEmpty())
+    {
+        bidPrice = _book.GetBids().GetBest().price;
+        bidQuantity = _book.GetBids().GetBest().quantity;
+    }
+    if (!_book.GetOffers().IsEmpty())
+    {
+        offerPrice = _book.GetOffers().GetBest().price;
+        offerQuantity = _book.GetOffers().GetBest().quantity;
+    }
+}
+
+template <typename T>
+const T& TopOfBook<T>::GetProduct() const
+{
+    return product.Get();
+}
+
+template <typename T>
+Tick256 TopOfBook<T>::GetBidPrice() const
+{
+    return bidPrice;
+}
+
+template <typename T>
+Tick256 TopOfBook<T>::GetOfferPrice() const
+{
+    return offerPrice;
+}
+
+template <typename T>
+long TopOfBook<T>::GetBidQuantity() const
+{
+    return bidQuantity;
+}
+
+template <typename T>
+long TopOfBook<T>::GetOfferQuantity() const
+{
+    return offerQuantity;
+}
+
+template <typename T>
+bool TopOfBook<T>::IsChanged() const
+{
+    return changed;
+}
+
+template <typename T>
+void TopOfBook<T>::SetChanged(bool _changed)
+{
+    changed = _changed;
+}
+
+template <typename T>
+bool TopOfBook<T>::SameInside(const TopOfBook<T>& _other) const
+{
+    return bidPrice == _other.bidPrice && bidQuantity == _other.bidQuantity &&
+           offerPrice == _other.offerPrice && offerQuantity == _other.offerQuantity;
+}
+
 // ============================================================================
 // IMPLEMENTATION: MarketDataService<T>
 // ============================================================================
@@ -311,21 +889,40 @@ MarketDataService<T>::~MarketDataService()
 template <typename T>
 OrderBook<T>& MarketDataService<T>::GetData(string _key)
 {
-    return orderBooks[_key];
+    return orderBooks.Get(_key);
 }
 
 template <typename T>
 void MarketDataService<T>::OnMessage(OrderBook<T>& _data)
+{
+    // Notify all listeners
+    OnMessage(_data, ListenerSink<OrderBook<T>>(listeners), ListenerSink<TopOfBook<T>>(topListeners));
+}
+
+template <typename T>
+template <typename BookSink, typename TopSink>
+void MarketDataService<T>::OnMessage(OrderBook<T>& _data, BookSink&& bookSink, TopSink&& topSink)
 {
     // Insert or update the order book
-    string prodId = _data.GetProduct().GetProductId();
-    orderBooks[prodId] = _data;
+    orderBooks[_data.GetProduct().GetProductIndex()] = _data;
 
-    // Notify all listeners
-    for (auto& ls : listeners)
-    {
-        ls->ProcessAdd(_data);
-    }
+    bookSink(_data);
+    PublishTopOfBook(_data, topSink);
+}
+
+template <typename T>
+template <typename TopSink>
+void MarketDataService<T>::PublishTopOfBook(const OrderBook<T>& book, TopSink&& topSink)
+{
+    ProductIndex prodIndex = book.GetProduct().GetProductIndex();
+    bool seen = topsOfBook.Contains(prodIndex);
+    TopOfBook<T>& last = topsOfBook[prodIndex];
+
+    TopOfBook<T> top(book);
+    top.SetChanged(!seen || !top.SameInside(last));
+    last = top;
+
+    topSink(top);
 }
 
 template <typename T>
@@ -340,6 +937,24 @@ const vector<ServiceListener<OrderBook<T>>*>& MarketDataService<T>::GetListeners
     return listeners;
 }
 
+template <typename T>
+void MarketDataService<T>::AddTopOfBookListener(ServiceListener<TopOfBook<T>>* listener)
+{
+    topListeners.push_back(listener);
+}
+
+template <typename T>
+const vector<ServiceListener<TopOfBook<T>>*>& MarketDataService<T>::GetTopOfBookListeners() const
+{
+    return topListeners;
+}
+
+template <typename T>
+const TopOfBook<T>& MarketDataService<T>::GetTopOfBook(const string& productId)
+{
+    return topsOfBook.Get(productId);
+}
+
 template <typename T>
 MarketDataConnector<T>* MarketDataService<T>::GetConnector()
 {
@@ -355,61 +970,85 @@ int MarketDataService<T>::GetOrderBookDepth() const
 template <typename T>
 const BidOffer MarketDataService<T>::GetBestBidOffer(const string& productId)
 {
-    return orderBooks[productId].GetBidOffer();
+    return orderBooks.Get(productId).GetBidOffer();
 }
 
 template <typename T>
-const OrderBook<T>& MarketDataService<T>::AggregateDepth(const string& productId)
+bool MarketDataService<T>::AggregateDepth(const string& productId, long bucketTicks, OrderBook<T>& out) const
 {
-    // Retrieve original product and stacks
-    T& productRef = orderBooks[productId].GetProduct();
-    vector<Order>& originalBids = const_cast<vector<Order>&>(orderBooks[productId].GetBidStack());
-    vector<Order>& originalOffers = const_cast<vector<Order>&>(orderBooks[productId].GetOfferStack());
-
-    // Build aggregated bid map
-    unordered_map<double, long> aggregatedBids;
-    for (auto& oneBid : originalBids)
+    // Look up without registering, so the call never writes shared state
+    const OrderBook<T>* book = orderBooks.Find(ProductRegistry::Instance().Find(productId));
+    if (!book)
     {
-        double p = oneBid.GetPrice();
-        long q = oneBid.GetQuantity();
-        aggregatedBids[p] += q;
+        out.Clear();
+        return false;
     }
 
-    // Create new bid stack
-    vector<Order> newBidStack;
-    for (auto& kv : aggregatedBids)
-    {
-        double aggPrice = kv.first;
-        long aggQty = kv.second;
-        Order bidOrder(aggPrice, aggQty, BID);
-        newBidStack.push_back(bidOrder);
-    }
+    // Both sides are already sorted best first: one merge pass each
+    out.AssignBucketed(*book, bucketTicks);
+    return true;
+}
 
-    // Build aggregated offer map
-    unordered_map<double, long> aggregatedOffers;
-    for (auto& oneOffer : originalOffers)
-    {
-        double p = oneOffer.GetPrice();
-        long q = oneOffer.GetQuantity();
-        aggregatedOffers[p] += q;
-    }
+template <typename T>
+OrderBook<T> MarketDataService<T>::AggregateDepth(const string& productId, long bucketTicks) const
+{
+    OrderBook<T> aggregated;
+    AggregateDepth(productId, bucketTicks, aggregated);
+    return aggregated;
+}
+
+template <typename T>
+void MarketDataService<T>::ApplyLevelUpdate(const T& product, PricingSide side,
+                                            Tick256 price, long quantity)
+{
+    LevelUpdate update{side, price, quantity};
+    ApplyLevelUpdates(product, Span<LevelUpdate>(&update, 1));
+}
 
-    // Create new offer stack
-    vector<Order> newOfferStack;
-    for (auto& kv : aggregatedOffers)
+template <typename T>
+void MarketDataService<T>::ApplyLevelUpdates(const T& product, Span<LevelUpdate> updates)
+{
+    ApplyLevelUpdates(product, updates, ListenerSink<OrderBook<T>>(listeners),
+                      ListenerSink<TopOfBook<T>>(topListeners));
+}
+
+template <typename T>
+template <typename BookSink, typename TopSink>
+void MarketDataService<T>::ApplyLevelUpdates(const T& product, Span<LevelUpdate> updates,
+                                             BookSink&& bookSink, TopSink&& topSink)
+{
+    ProductIndex prodIndex = product.GetProductIndex();
+    bool seen = orderBooks.Contains(prodIndex);
+    OrderBook<T>& book = orderBooks[prodIndex];
+    if (!seen) book.SetProduct(product);
+    for (const LevelUpdate& update : updates)
     {
-        double aggPrice = kv.first;
-        long aggQty = kv.second;
-        Order offerOrder(aggPrice, aggQty, OFFER);
-        newOfferStack.push_back(offerOrder);
+        book.ApplyUpdate(update);
     }
 
-    // Create a temporary aggregated OrderBook
-    // Note: This returns a temporary object. If you want to store it,
-    // you could update orderBooks[productId] with it.
-    static OrderBook<T> aggregatedBook(productRef, newBidStack, newOfferStack);
-    aggregatedBook = OrderBook<T>(productRef, newBidStack, newOfferStack);
-    return aggregatedBook;
+    bookSink(book);
+    PublishTopOfBook(book, topSink);
+}
+
+template <typename T>
+const OrderBook<T>* MarketDataService<T>::FindOrderBook(ProductIndex productIndex) const
+{
+    return orderBooks.Find(productIndex);
+}
+
+template <typename T>
+void MarketDataService<T>::RestoreOrderBook(const OrderBook<T>& book)
+{
+    ProductIndex prodIndex = book.GetProduct().GetProductIndex();
+    orderBooks[prodIndex] = book;
+    topsOfBook[prodIndex] = TopOfBook<T>(book, false);
+}
+
+template <typename T>
+template <typename F>
+void MarketDataService<T>::ForEachOrderBook(F&& f)
+{
+    orderBooks.ForEach([&f](ProductIndex, OrderBook<T>& book) { f(book); });
 }
 
 // ============================================================================
@@ -417,7 +1056,7 @@ const OrderBook<T>& MarketDataService<T>::AggregateDepth(const string& productId
 // ============================================================================
 template <typename T>
 MarketDataConnector<T>::MarketDataConnector(MarketDataService<T>* _service)
-    : service(_service)
+    : service(_service), orderCount(0), reportedDrops(0)
 {
 }
 
@@ -430,56 +1069,77 @@ void MarketDataConnector<T>::Publish(OrderBook<T>& _data)
 template <typename T>
 void MarketDataConnector<T>::Subscribe(ifstream& data)
 {
-    // Each product ID cycle will process 2 * bookDepth orders
-    // (one for BID, one for OFFER, repeated)
-    int depthVal = service->GetOrderBookDepth();
-    int combinedThreshold = depthVal * 2;
-    long orderCount = 0;
+    LineReader reader(data);
+    string_view lineContent;
+    while (reader.NextLine(lineContent))
+    {
+        ProcessLine(lineContent);
+    }
+}
+
+template <typename T>
+void MarketDataConnector<T>::Subscribe(MappedFile& _data)
+{
+    _data.ForEachLine([this](string_view line) { ProcessLine(line); });
+}
 
-    vector<Order> tempBidStack;
-    vector<Order> tempOfferStack;
+template <typename T>
+void MarketDataConnector<T>::ProcessLine(string_view lineContent)
+{
+    ProcessLine(lineContent, ListenerSink<OrderBook<T>>(service->GetListeners()),
+                ListenerSink<TopOfBook<T>>(service->GetTopOfBookListeners()));
+}
 
-    string lineContent;
-    while (getline(data, lineContent))
-    {
-        if (lineContent.empty()) continue;
+template <typename T>
+size_t MarketDataConnector<T>::GetDroppedLevelCount() const
+{
+    return pendingBook.GetDroppedLevelCount();
+}
 
-        stringstream ss(lineContent);
-        string token;
-        vector<string> tokens;
-        while (getline(ss, token, ','))
-        {
-            tokens.push_back(token);
-        }
+template <typename T>
+template <typename BookSink, typename TopSink>
+void MarketDataConnector<T>::ProcessLine(string_view lineContent, BookSink&& bookSink, TopSink&& topSink)
+{
+    if (lineContent.empty()) return;
 
-        if (tokens.size() < 4) continue;  // Expected: productId, price, quantity, side
+    // Expected: productId, price, quantity, side
+    if (SplitFields(lineContent, tokens) < 4) return;
 
-        // Parse fields
-        string productIdStr = tokens[0];
-        double parsedPrice = string2price(tokens[1]);
-        long parsedQty = stol(tokens[2]);
-        PricingSide parsedSide = (tokens[3] == "BID") ? BID : OFFER;
+    // Parse fields
+    Tick256 parsedPrice = Tick256::FromString(tokens[1]);
+    long parsedQty = ParseLong(tokens[2]);
+    PricingSide parsedSide = (tokens[3] == "BID") ? BID : OFFER;
 
-        // Create order
-        Order newOrder(parsedPrice, parsedQty, parsedSide);
-        if (parsedSide == BID)
-            tempBidStack.push_back(newOrder);
-        else
-            tempOfferStack.push_back(newOrder);
+    // Add the order to its price level of the snapshot
+    pendingBook.AddLevel(parsedSide, parsedPrice, parsedQty);
 
-        ++orderCount;
+    ++orderCount;
 
-        // After reading combinedThreshold orders, create an OrderBook and notify
-        if (orderCount % combinedThreshold == 0)
-        {
-            T productObj = GetBond(productIdStr);  // or suitable product creation
-            OrderBook<T> assembledBook(productObj, tempBidStack, tempOfferStack);
-            service->OnMessage(assembledBook);
+    // Each product ID cycle will process 2 * bookDepth orders
+    // (one for BID, one for OFFER, repeated)
+    int combinedThreshold = service->GetOrderBookDepth() * 2;
 
-            // Reset the stacks for the next batch
-            tempBidStack.clear();
-            tempOfferStack.clear();
+    // After reading combinedThreshold orders, update the stored book by
+    // the levels that changed and notify
+    if (orderCount % combinedThreshold == 0)
+    {
+        static const OrderBook<T> emptyBook;
+        const T& product = GetProduct<T>(tokens[0]);
+        const OrderBook<T>* current = service->FindOrderBook(product.GetProductIndex());
+
+        pendingUpdates.clear();
+        (current ? *current : emptyBook).AppendDelta(pendingBook, pendingUpdates);
+        service->ApplyLevelUpdates(product, Span<LevelUpdate>(pendingUpdates), bookSink, topSink);
+
+        if (pendingBook.GetDroppedLevelCount() != reportedDrops)
+        {
+            cerr << "Error: " << product.GetProductId() << " snapshot deeper than the order book; dropped "
+                 << pendingBook.GetDroppedLevelCount() - reportedDrops << " levels" << endl;
+            reportedDrops = pendingBook.GetDroppedLevelCount();
         }
+
+        // Start the next snapshot
+        pendingBook.Clear();
     }
 }
 
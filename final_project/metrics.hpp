@@ -0,0 +1,371 @@
+/**
+ * metrics.hpp
+ * Defines the counters behind the SOA layer's instrumentation. Every
+ * instrumented edge (a listener registered on a service, or a connector
+ * feeding one) gets a ListenerMetrics counting its calls and messages and
+ * timing one call in 2^METRICS_SAMPLE_SHIFT with the CPU cycle counter.
+ * Queue depths are read through registered callbacks. MetricsRegistry
+ * exports all of it as Prometheus text or as a short summary, and
+ * MetricsReporter rewrites a Prometheus text file periodically.
+ *
+ * Counters have one writer (the thread calling the edge) and are read
+ * with relaxed atomics, so recording needs no locked instruction. Building
+ * with -DSOA_NO_METRICS compiles the hooks in soa.hpp out entirely.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+using namespace std;
+
+// One call in 2^METRICS_SAMPLE_SHIFT per edge is timed
+constexpr unsigned METRICS_SAMPLE_SHIFT = 6;
+constexpr uint64_t METRICS_SAMPLE_MASK = (uint64_t(1) << METRICS_SAMPLE_SHIFT) - 1;
+
+// Time stamp counter where available, steady_clock nanoseconds elsewhere
+uint64_t ReadCycleCounter()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/**
+ * MetricCounter
+ * A 64-bit counter with a single writer; readers on other threads see a
+ * recent value. Add is a plain load and store, not a read-modify-write.
+ */
+class MetricCounter
+{
+public:
+    void Add(uint64_t amount = 1) { value.store(value.load(memory_order_relaxed) + amount, memory_order_relaxed); }
+    void Max(uint64_t candidate) { if (candidate > value.load(memory_order_relaxed)) value.store(candidate, memory_order_relaxed); }
+    uint64_t Get() const { return value.load(memory_order_relaxed); }
+
+private:
+    atomic<uint64_t> value{0};
+};
+
+/**
+ * ListenerMetrics
+ * Counters of one edge into a service: how often it was called, how many
+ * messages those calls carried (more than one for a batch), and the cycle
+ * cost of the sampled calls. A call's time includes everything the listener
+ * does downstream, so the difference between an edge and the edges leaving
+ * its service is that service's own cost. Only one thread may record into
+ * it at a time.
+ */
+struct ListenerMetrics
+{
+    ListenerMetrics(string_view _service, string_view _source) : service(_service), source(_source) {}
+
+    string service;  // the service receiving the calls
+    string source;   // where they come from: an upstream service or a feed
+    MetricCounter calls;
+    MetricCounter messages;
+    MetricCounter sampledCalls;
+    MetricCounter sampledCycles;
+    MetricCounter maxSampledCycles;
+
+    // Count one call carrying _messages messages and run it, timing it if sampled
+    template <typename Call>
+    void Measure(uint64_t _messages, Call&& call)
+    {
+        uint64_t callNumber = calls.Get();
+        calls.Add();
+        messages.Add(_messages);
+        if ((callNumber & METRICS_SAMPLE_MASK) != 0)
+        {
+            call();
+            return;
+        }
+
+        uint64_t start = ReadCycleCounter();
+        call();
+        uint64_t elapsed = ReadCycleCounter() - start;
+        sampledCalls.Add();
+        sampledCycles.Add(elapsed);
+        maxSampledCycles.Max(elapsed);
+    }
+};
+
+/**
+ * MetricsRegistry
+ * Process-wide list of instrumented edges and queues. Instrumentation is
+ * off until Enable is called, so uninstrumented runs wire their listeners
+ * directly. Registration and export are serialised; register everything
+ * before the feeds start.
+ */
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry& Instance();
+
+    void Enable();
+    bool IsEnabled() const;
+
+    // Counters for a new edge; the reference stays valid for the process
+    ListenerMetrics& AddListener(string_view service, string_view source);
+
+    // A queue whose depth is read by depth() at export time
+    void AddQueue(string_view name, function<size_t()> depth);
+
+    // Prometheus text exposition format
+    void WritePrometheus(ostream& out) const;
+
+    // Write the Prometheus text to path, replacing it atomically
+    bool WritePrometheusFile(const string& path) const;
+
+    // One line per edge and queue, for a console dump
+    void WriteSummary(ostream& out) const;
+
+private:
+    MetricsRegistry();
+
+    struct QueueGauge
+    {
+        string name;
+        function<size_t()> depth;
+    };
+
+    // Cycle counter ticks per nanosecond, measured since the registry was created
+    double CyclesPerNanosecond() const;
+
+    atomic<bool> enabled;
+    mutable mutex registryMutex;
+    deque<ListenerMetrics> edges;
+    vector<QueueGauge> queues;
+    uint64_t startCycles;
+    chrono::steady_clock::time_point startTime;
+};
+
+/**
+ * MetricsReporter
+ * Rewrites a Prometheus text file (e.g. for node_exporter's textfile
+ * collector) from a background thread every interval, and once more when
+ * stopped.
+ */
+class MetricsReporter
+{
+public:
+    MetricsReporter(string _path, chrono::milliseconds _interval,
+                    MetricsRegistry& _registry = MetricsRegistry::Instance());
+
+    // Writes a final snapshot and joins the thread
+    ~MetricsReporter();
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    void Stop();
+
+private:
+    void Run();
+
+    string path;
+    chrono::milliseconds interval;
+    MetricsRegistry& registry;
+    mutex stopMutex;
+    condition_variable stopSignal;
+    bool stopping;
+    thread worker;
+};
+
+// -------------------- Implementation of MetricsRegistry --------------------
+
+MetricsRegistry& MetricsRegistry::Instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : enabled(false), startCycles(ReadCycleCounter()), startTime(chrono::steady_clock::now())
+{
+}
+
+void MetricsRegistry::Enable()
+{
+    enabled.store(true, memory_order_relaxed);
+}
+
+bool MetricsRegistry::IsEnabled() const
+{
+    return enabled.load(memory_order_relaxed);
+}
+
+ListenerMetrics& MetricsRegistry::AddListener(string_view service, string_view source)
+{
+    lock_guard<mutex> lock(registryMutex);
+    edges.emplace_back(service, source);
+    return edges.back();
+}
+
+void MetricsRegistry::AddQueue(string_view name, function<size_t()> depth)
+{
+    lock_guard<mutex> lock(registryMutex);
+    queues.push_back(QueueGauge{string(name), std::move(depth)});
+}
+
+double MetricsRegistry::CyclesPerNanosecond() const
+{
+    auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - startTime).count();
+    if (elapsed <= 0) return 1.0;
+    return static_cast<double>(ReadCycleCounter() - startCycles) / static_cast<double>(elapsed);
+}
+
+void MetricsRegistry::WritePrometheus(ostream& out) const
+{
+    lock_guard<mutex> lock(registryMutex);
+    double nanosPerCycle = 1.0 / CyclesPerNanosecond();
+    auto labels = [](const ListenerMetrics& edge) {
+        return "{service=\"" + edge.service + "\",source=\"" + edge.source + "\"}";
+    };
+
+    // Per-service totals over every edge into the service
+    map<string, uint64_t> serviceMessages;
+    for (const auto& edge : edges) serviceMessages[edge.service] += edge.messages.Get();
+
+    out << "# HELP soa_service_messages_total Messages received by a service over all its inputs.\n"
+        << "# TYPE soa_service_messages_total counter\n";
+    for (const auto& [service, count] : serviceMessages)
+    {
+        out << "soa_service_messages_total{service=\"" << service << "\"} " << count << "\n";
+    }
+
+    out << "# HELP soa_listener_calls_total Calls into a service through one edge.\n"
+        << "# TYPE soa_listener_calls_total counter\n";
+    for (const auto& edge : edges) out << "soa_listener_calls_total" << labels(edge) << " " << edge.calls.Get() << "\n";
+
+    out << "# HELP soa_listener_messages_total Messages carried by those calls.\n"
+        << "# TYPE soa_listener_messages_total counter\n";
+    for (const auto& edge : edges) out << "soa_listener_messages_total" << labels(edge) << " " << edge.messages.Get() << "\n";
+
+    out << "# HELP soa_listener_sampled_calls_total Calls that were timed.\n"
+        << "# TYPE soa_listener_sampled_calls_total counter\n";
+    for (const auto& edge : edges) out << "soa_listener_sampled_calls_total" << labels(edge) << " " << edge.sampledCalls.Get() << "\n";
+
+    out << "# HELP soa_listener_sampled_seconds_total Time spent in the timed calls.\n"
+        << "# TYPE soa_listener_sampled_seconds_total counter\n";
+    for (const auto& edge : edges)
+    {
+        out << "soa_listener_sampled_seconds_total" << labels(edge) << " "
+            << static_cast<double>(edge.sampledCycles.Get()) * nanosPerCycle * 1e-9 << "\n";
+    }
+
+    out << "# HELP soa_listener_max_sampled_seconds Slowest timed call.\n"
+        << "# TYPE soa_listener_max_sampled_seconds gauge\n";
+    for (const auto& edge : edges)
+    {
+        out << "soa_listener_max_sampled_seconds" << labels(edge) << " "
+            << static_cast<double>(edge.maxSampledCycles.Get()) * nanosPerCycle * 1e-9 << "\n";
+    }
+
+    if (queues.empty()) return;
+    out << "# HELP soa_queue_depth Messages waiting in a queue.\n"
+        << "# TYPE soa_queue_depth gauge\n";
+    for (const auto& queue : queues)
+    {
+        out << "soa_queue_depth{queue=\"" << queue.name << "\"} " << queue.depth() << "\n";
+    }
+}
+
+bool MetricsRegistry::WritePrometheusFile(const string& path) const
+{
+    // Write aside and rename, so a scraper never reads a partial file
+    const string tempPath = path + ".tmp";
+    {
+        ofstream file(tempPath, ios::out | ios::trunc);
+        if (!file.is_open())
+        {
+            cerr << "Error: Unable to open metrics file " << tempPath << endl;
+            return false;
+        }
+        WritePrometheus(file);
+    }
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        cerr << "Error: Unable to replace metrics file " << path << endl;
+        return false;
+    }
+    return true;
+}
+
+void MetricsRegistry::WriteSummary(ostream& out) const
+{
+    lock_guard<mutex> lock(registryMutex);
+    double nanosPerCycle = 1.0 / CyclesPerNanosecond();
+    for (const auto& edge : edges)
+    {
+        uint64_t sampled = edge.sampledCalls.Get();
+        double meanNanos = sampled ? static_cast<double>(edge.sampledCycles.Get()) * nanosPerCycle / sampled : 0.0;
+        out << "  " << edge.service << " <- " << edge.source << ": " << edge.messages.Get() << " messages in "
+            << edge.calls.Get() << " calls, mean " << fixed << setprecision(0) << meanNanos << "ns, max "
+            << static_cast<double>(edge.maxSampledCycles.Get()) * nanosPerCycle << "ns\n";
+    }
+    for (const auto& queue : queues)
+    {
+        out << "  queue " << queue.name << ": depth " << queue.depth() << "\n";
+    }
+    out << defaultfloat << setprecision(6);
+}
+
+// -------------------- Implementation of MetricsReporter --------------------
+
+MetricsReporter::MetricsReporter(string _path, chrono::milliseconds _interval, MetricsRegistry& _registry)
+    : path(std::move(_path)), interval(_interval), registry(_registry), stopping(false)
+{
+    worker = thread(&MetricsReporter::Run, this);
+}
+
+MetricsReporter::~MetricsReporter()
+{
+    Stop();
+}
+
+void MetricsReporter::Stop()
+{
+    if (!worker.joinable()) return;
+    {
+        lock_guard<mutex> lock(stopMutex);
+        stopping = true;
+    }
+    stopSignal.notify_one();
+    worker.join();
+    registry.WritePrometheusFile(path);
+}
+
+void MetricsReporter::Run()
+{
+    unique_lock<mutex> lock(stopMutex);
+    while (!stopSignal.wait_for(lock, interval, [this]() { return stopping; }))
+    {
+        registry.WritePrometheusFile(path);
+    }
+}
+
+#endif // METRICS_HPP
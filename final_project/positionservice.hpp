@@ -9,14 +9,20 @@
 #ifndef POSITION_SERVICE_HPP
 #define POSITION_SERVICE_HPP
 
+#include "bookregistry.hpp"
 #include "tradebookingservice.hpp"
+#include <array>
 #include <map>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 
 using namespace std;
 
 /**
  * Position class representing holdings in a particular book.
+ * Per-book quantities live in a fixed array indexed by BookIndex, and the
+ * aggregate across books is kept up to date as quantities are added.
  * Type T is the product type (e.g., Bond).
  */
 template <typename T>
@@ -30,24 +36,36 @@ public:
     // Return the product associated with this position
     const T& GetProduct() const;
 
-    // Return the position quantity for a specific book
-    long GetPosition(const std::string& book);
+    // Return the position quantity for a specific book (0 if none)
+    long GetPosition(const std::string& book) const;
+    long GetPosition(BookIndex book) const;
 
-    // Return the map of (book -> quantity)
-    map<string, long> GetPositions();
+    // Return a (book -> quantity) map of the books held
+    map<string, long> GetPositions() const;
 
-    // Add a position quantity to a specific book
+    // Number of books held
+    size_t GetBookCount() const;
+
+    // Call f(book name, quantity) for each book held, in book name order
+    template <typename F>
+    void ForEachBook(F&& f) const;
+
+    // Add a position quantity to a specific book (ignored for a book the
+    // BookRegistry has no room for)
     void AddPosition(const std::string& book, long qty);
+    void AddPosition(BookIndex book, long qty);
 
-    // Compute the aggregate position across all books
-    long GetAggregatePosition();
+    // The aggregate position across all books
+    long GetAggregatePosition() const;
 
     // Generate a list of strings for logging/printing
     vector<string> PrintFunction() const;
 
 private:
-    T product;                // The product (e.g. a Bond)
-    map<string, long> bookPositions; // Key: book name, Value: quantity
+    ProductRef<T> product;                   // The product (e.g. a Bond)
+    array<long, MAX_BOOKS> bookQuantities{}; // Quantity by BookIndex
+    uint32_t heldBooks = 0;                  // Bit b set once book b has been added to
+    long aggregatePosition = 0;              // Sum of bookQuantities
 };
 
 // -------------------- Implementation of Position<T> --------------------
@@ -61,36 +79,79 @@ Position<T>::Position(const T& prod)
 template <typename T>
 const T& Position<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
 }
 
 template <typename T>
-long Position<T>::GetPosition(const std::string& book)
+long Position<T>::GetPosition(const std::string& book) const
 {
-    return bookPositions[book];
+    return GetPosition(BookRegistry::Instance().Find(book));
 }
 
 template <typename T>
-map<string, long> Position<T>::GetPositions()
+long Position<T>::GetPosition(BookIndex book) const
 {
-    return bookPositions;
+    return (book < MAX_BOOKS) ? bookQuantities[book] : 0;
 }
 
 template <typename T>
-void Position<T>::AddPosition(const std::string& book, long qty)
+map<string, long> Position<T>::GetPositions() const
+{
+    map<string, long> positions;
+    ForEachBook([&positions](const string& book, long qty) { positions.emplace(book, qty); });
+    return positions;
+}
+
+template <typename T>
+size_t Position<T>::GetBookCount() const
 {
-    bookPositions[book] += qty;
+    return static_cast<size_t>(__builtin_popcount(heldBooks));
 }
 
 template <typename T>
-long Position<T>::GetAggregatePosition()
+template <typename F>
+void Position<T>::ForEachBook(F&& f) const
 {
-    long total = 0;
-    for (auto& kv : bookPositions)
+    // Order the held books by name, as a map keyed on the name would
+    const BookRegistry& registry = BookRegistry::Instance();
+    array<BookIndex, MAX_BOOKS> order;
+    size_t count = 0;
+    for (uint32_t mask = heldBooks; mask != 0; mask &= mask - 1)
     {
-        total += kv.second;
+        BookIndex book = static_cast<BookIndex>(__builtin_ctz(mask));
+        size_t slot = count++;
+        while (slot > 0 && registry.GetBook(book) < registry.GetBook(order[slot - 1]))
+        {
+            order[slot] = order[slot - 1];
+            --slot;
+        }
+        order[slot] = book;
     }
-    return total;
+    for (size_t i = 0; i < count; ++i)
+    {
+        f(registry.GetBook(order[i]), bookQuantities[order[i]]);
+    }
+}
+
+template <typename T>
+void Position<T>::AddPosition(const std::string& book, long qty)
+{
+    AddPosition(BookRegistry::Instance().Intern(book), qty);
+}
+
+template <typename T>
+void Position<T>::AddPosition(BookIndex book, long qty)
+{
+    if (book >= MAX_BOOKS) return;
+    bookQuantities[book] += qty;
+    heldBooks |= 1u << book;
+    aggregatePosition += qty;
+}
+
+template <typename T>
+long Position<T>::GetAggregatePosition() const
+{
+    return aggregatePosition;
 }
 
 template <typename T>
@@ -98,14 +159,13 @@ vector<string> Position<T>::PrintFunction() const
 {
     // First element: product ID
     vector<string> output;
-    output.push_back(product.GetProductId());
+    output.push_back(product.Get().GetProductId());
 
     // Then each book name + quantity
-    for (auto& kv : bookPositions)
-    {
-        output.push_back(kv.first);
-        output.push_back(to_string(kv.second));
-    }
+    ForEachBook([&output](const string& book, long qty) {
+        output.push_back(book);
+        output.push_back(to_string(qty));
+    });
     return output;
 }
 
@@ -143,10 +203,22 @@ public:
     // Add a trade (from TradeBookingService) to update positions
     virtual void AddTrade(const Trade<T>& tradeObj);
 
+    // As above, passing the updated stored position to sink(Position<T>&) instead of the listeners
+    template <typename Sink>
+    void AddTrade(const Trade<T>& tradeObj, Sink&& sink);
+
+    // Add a batch of trades, notifying each listener once with the new positions
+    void AddTradeBatch(Span<Trade<T>> tradeBatch);
+
+    // Call f(position) for every stored position, in product index order
+    template <typename F>
+    void ForEachPosition(F&& f);
+
 private:
-    map<string, Position<T>> positions;
+    ProductStore<Position<T>> positions;
     vector<ServiceListener<Position<T>>*> listeners;
     PositionServiceListener<T>* listener;
+    vector<Position<T>> positionBatch;
 };
 
 // -------------------- Implementation of PositionService<T> --------------------
@@ -154,7 +226,7 @@ private:
 template <typename T>
 PositionService<T>::PositionService()
 {
-    positions = map<string, Position<T>>();
+    positions = ProductStore<Position<T>>();
     listeners = vector<ServiceListener<Position<T>>*>();
     listener  = new PositionServiceListener<T>(this);
 }
@@ -162,14 +234,13 @@ PositionService<T>::PositionService()
 template <typename T>
 Position<T>& PositionService<T>::GetData(string key)
 {
-    return positions[key];
+    return positions.Get(key);
 }
 
 template <typename T>
 void PositionService<T>::OnMessage(Position<T>& data)
 {
-    string prodId = data.GetProduct().GetProductId();
-    positions[prodId] = data;
+    positions[data.GetProduct().GetProductIndex()] = data;
 }
 
 template <typename T>
@@ -192,37 +263,59 @@ const vector<ServiceListener<Position<T>>*>& PositionService<T>::GetListeners()
 
 template <typename T>
 void PositionService<T>::AddTrade(const Trade<T>& tradeObj)
+{
+    // Notify listeners
+    AddTrade(tradeObj, ListenerSink<Position<T>>(listeners));
+}
+
+template <typename T>
+template <typename Sink>
+void PositionService<T>::AddTrade(const Trade<T>& tradeObj, Sink&& sink)
 {
     // Extract details
-    T prod       = tradeObj.GetProduct();
-    string prodId  = prod.GetProductId();
-    string bookName = tradeObj.GetBook();
+    const T& prod   = tradeObj.GetProduct();
+    ProductIndex prodIndex = prod.GetProductIndex();
+    BookIndex book  = BookRegistry::Instance().Intern(tradeObj.GetBook());
     long tradeQty   = tradeObj.GetQuantity();
     Side side       = tradeObj.GetSide();
 
-    // If not present, create a new Position
-    Position<T> newPosition(prod);
-
-    // Add or subtract based on side
-    if (side == BUY)
-        newPosition.AddPosition(bookName, tradeQty);
-    else
-        newPosition.AddPosition(bookName, -tradeQty);
-
-    // Merge with any existing data
-    Position<T> oldPosition = positions[prodId];
-    map<string, long> oldMap = oldPosition.GetPositions();
-    for (auto& kv : oldMap)
+    // Feed trades in such a book were rejected by the connector already
+    if (book == INVALID_BOOK_INDEX)
     {
-        newPosition.AddPosition(kv.first, kv.second);
+        cerr << "Error: no room for book " << tradeObj.GetBook() << "; trade "
+             << tradeObj.GetTradeId() << " not booked" << endl;
+        return;
     }
-    positions[prodId] = newPosition;
 
-    // Notify listeners
-    for (auto& ls : listeners)
+    // Update the stored position in place, creating it on the product's first trade
+    bool isNew = !positions.Contains(prodIndex);
+    Position<T>& position = positions[prodIndex];
+    if (isNew) position = Position<T>(prod);
+
+    // Add or subtract based on side
+    position.AddPosition(book, (side == BUY) ? tradeQty : -tradeQty);
+
+    sink(position);
+}
+
+template <typename T>
+void PositionService<T>::AddTradeBatch(Span<Trade<T>> tradeBatch)
+{
+    // One position per trade, in trade order, reusing the batch buffer
+    positionBatch.clear();
+    for (Trade<T>& tradeObj : tradeBatch)
     {
-        ls->ProcessAdd(newPosition);
+        AddTrade(tradeObj, [this](Position<T>& position) { positionBatch.push_back(position); });
     }
+
+    for (auto* ls : listeners) ls->ProcessAddBatch(Span<Position<T>>(positionBatch));
+}
+
+template <typename T>
+template <typename F>
+void PositionService<T>::ForEachPosition(F&& f)
+{
+    positions.ForEach([&f](ProductIndex, Position<T>& position) { f(position); });
 }
 
 // -------------------------------------------------------------------------
@@ -242,6 +335,7 @@ public:
     void ProcessAdd(Trade<T>& data) override;
     void ProcessRemove(Trade<T>& data) override;
     void ProcessUpdate(Trade<T>& data) override;
+    void ProcessAddBatch(Span<Trade<T>> batch) override;
 
 private:
     PositionService<T>* service;
@@ -262,6 +356,12 @@ void PositionServiceListener<T>::ProcessAdd(Trade<T>& data)
     service->AddTrade(data);
 }
 
+template <typename T>
+void PositionServiceListener<T>::ProcessAddBatch(Span<Trade<T>> batch)
+{
+    service->AddTradeBatch(batch);
+}
+
 template <typename T>
 void PositionServiceListener<T>::ProcessRemove(Trade<T>& /*data*/)
 {
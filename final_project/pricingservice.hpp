@@ -13,6 +13,9 @@
 #ifndef PRICING_SERVICE_HPP
 #define PRICING_SERVICE_HPP
 
+#include "mappedfile.hpp"
+#include "productfactory.hpp"
+#include "soa.hpp"
 #include "utility.hpp"
 #include <string>
 #include <map>
@@ -27,6 +30,8 @@
 
 /**
  * A price object consisting of mid and bid/offer spread.
+ * The bid and offer are kept as Tick256, since the mid of two ticks can be
+ * a half tick; the mid is derived from them.
  * Type T is the product type.
  */
 template <typename T>
@@ -35,13 +40,15 @@ public:
     // Default constructor
     Price() = default;
 
-    // Constructor with product, mid, and bid-offer spread
-    Price(const T& _product, double _mid, double _bidOfferSpread);
+    // Constructor with product, bid and offer
+    Price(const T& _product, Tick256 _bid, Tick256 _offer);
 
     // Accessors
     const T& GetProduct() const;
+    Tick256 GetBid() const;
+    Tick256 GetOffer() const;
     double GetMid() const;
-    double GetBidOfferSpread() const;
+    Tick256 GetBidOfferSpread() const;
 
     // Convert attributes to strings (for printing or logging)
     std::vector<std::string> ToStrings() const;
@@ -49,36 +56,49 @@ public:
 
 private:
     // Private data members
-    T product;
-    double mid;
-    double bidOfferSpread;
+    ProductRef<T> product;
+    Tick256 bid;
+    Tick256 offer;
 };
 
 
 // ----------------- Implementation of Price<T> -----------------
 
 template <typename T>
-Price<T>::Price(const T& _product, double _mid, double _bidOfferSpread)
-    : product(_product), mid(_mid), bidOfferSpread(_bidOfferSpread)
+Price<T>::Price(const T& _product, Tick256 _bid, Tick256 _offer)
+    : product(_product), bid(_bid), offer(_offer)
 {
 }
 
 template <typename T>
 const T& Price<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
+}
+
+template <typename T>
+Tick256 Price<T>::GetBid() const
+{
+    return bid;
+}
+
+template <typename T>
+Tick256 Price<T>::GetOffer() const
+{
+    return offer;
 }
 
 template <typename T>
 double Price<T>::GetMid() const
 {
-    return mid;
+    // Exact in a double: at most a half tick
+    return (bid + offer).ToDecimal() / 2.0;
 }
 
 template <typename T>
-double Price<T>::GetBidOfferSpread() const
+Tick256 Price<T>::GetBidOfferSpread() const
 {
-    return bidOfferSpread;
+    return offer - bid;
 }
 
 template <typename T>
@@ -91,9 +111,9 @@ std::vector<std::string> Price<T>::ToStrings() const
 template <typename T>
 std::vector<std::string> Price<T>::PrintFunction() const
 {
-    std::string productIdStr = product.GetProductId();
-    std::string midStr = price2string(mid);
-    std::string spreadStr = price2string(bidOfferSpread);
+    std::string productIdStr = product.Get().GetProductId();
+    std::string midStr = price2string(GetMid());
+    std::string spreadStr = GetBidOfferSpread().ToString();
 
     std::vector<std::string> outputVec;
     outputVec.push_back(productIdStr);
@@ -126,9 +146,19 @@ public:
     // Retrieve data by product ID
     Price<T>& GetData(std::string _key);
 
+    // Latest price of a product, or nullptr if none has arrived
+    const Price<T>* FindData(ProductIndex _index) const;
+
     // Callback for new or updated price data
     void OnMessage(Price<T>& _data);
 
+    // Store a price and pass it to sink(Price<T>&) instead of the listeners
+    template <typename Sink>
+    void OnMessage(Price<T>& _data, Sink&& sink);
+
+    // Store a batch of prices, then notify each listener once with the whole batch
+    void OnMessageBatch(Span<Price<T>> _batch) override;
+
     // Add a service listener
     void AddListener(ServiceListener<Price<T>>* listener);
 
@@ -139,8 +169,8 @@ public:
     PricingConnector<T>* GetConnector();
 
 private:
-    // Internal container storing prices by product ID
-    std::map<std::string, Price<T>> internalPriceMap;
+    // Internal container storing prices by product index
+    ProductStore<Price<T>> internalPriceMap;
 
     // List of service listeners
     std::vector<ServiceListener<Price<T>>*> priceSrvListeners;
@@ -165,7 +195,32 @@ public:
     // Subscribe data from an input stream
     void Subscribe(std::ifstream& _data) override;
 
+    // Subscribe data from a memory-mapped file, scanning it in place
+    void Subscribe(MappedFile& _data);
+
+    // Parse one "productId,bid,offer" record and pass it to the service
+    void ProcessLine(std::string_view line);
+
+    // Parse one record and pass the price to deliver(Price<T>&)
+    template <typename Deliver>
+    void ProcessLine(std::string_view line, Deliver&& deliver);
+
+    // Records per OnMessageBatch call (1 = one OnMessage per record)
+    void SetBatchSize(size_t batchSize);
+
+    // Count and sample the calls into the service (see InstrumentInput)
+    void SetMetrics(ListenerMetrics* metrics);
+
+    // Pass any records still held for a batch to the service
+    void Flush();
+
 private:
+    // Groups parsed records into batches for the service
+    MessageBatcher<std::string, Price<T>> batcher;
+
+    // Scratch field storage reused across lines
+    LineFields parsedFields;
+
     // Pointer back to the associated PricingService
     PricingService<T>* serviceRef;
 };
@@ -178,7 +233,7 @@ PricingService<T>::PricingService()
     : internalPriceMap(), priceSrvListeners(), pricingConn(nullptr)
 {
     // Initialize internal structures
-    internalPriceMap = std::map<std::string, Price<T>>();
+    internalPriceMap = ProductStore<Price<T>>();
     priceSrvListeners = std::vector<ServiceListener<Price<T>>*>();
     pricingConn = new PricingConnector<T>(this);
 }
@@ -193,21 +248,41 @@ template <typename T>
 Price<T>& PricingService<T>::GetData(std::string _key)
 {
     // Return reference to the price object in the map
-    return internalPriceMap[_key];
+    return internalPriceMap.Get(_key);
+}
+
+template <typename T>
+const Price<T>* PricingService<T>::FindData(ProductIndex _index) const
+{
+    return internalPriceMap.Find(_index);
 }
 
 template <typename T>
 void PricingService<T>::OnMessage(Price<T>& _data)
+{
+    // Notify all listeners of a new Add event
+    OnMessage(_data, ListenerSink<Price<T>>(priceSrvListeners));
+}
+
+template <typename T>
+template <typename Sink>
+void PricingService<T>::OnMessage(Price<T>& _data, Sink&& sink)
 {
     // Insert or update the price in the map
-    std::string pid = _data.GetProduct().GetProductId();
-    internalPriceMap[pid] = _data;  // Overwrites existing if present
+    internalPriceMap[_data.GetProduct().GetProductIndex()] = _data;  // Overwrites existing if present
 
-    // Notify all listeners of a new Add event
-    for (auto& lst : priceSrvListeners)
+    sink(_data);
+}
+
+template <typename T>
+void PricingService<T>::OnMessageBatch(Span<Price<T>> _batch)
+{
+    for (Price<T>& priceObj : _batch)
     {
-        lst->ProcessAdd(_data);
+        internalPriceMap[priceObj.GetProduct().GetProductIndex()] = priceObj;
     }
+
+    for (auto* ls : priceSrvListeners) ls->ProcessAddBatch(_batch);
 }
 
 template <typename T>
@@ -233,7 +308,7 @@ PricingConnector<T>* PricingService<T>::GetConnector()
 // ============================================================================
 template <typename T>
 PricingConnector<T>::PricingConnector(PricingService<T>* srvPtr)
-    : serviceRef(srvPtr)
+    : batcher(srvPtr), serviceRef(srvPtr)
 {
 }
 
@@ -247,42 +322,67 @@ template <typename T>
 void PricingConnector<T>::Subscribe(std::ifstream& _data)
 {
     // Read each line from the ifstream
-    std::string singleLine;
-    while (std::getline(_data, singleLine))
+    LineReader reader(_data);
+    std::string_view singleLine;
+    while (reader.NextLine(singleLine))
     {
-        if (singleLine.empty()) continue;
+        ProcessLine(singleLine);
+    }
+    Flush();
+}
+
+template <typename T>
+void PricingConnector<T>::Subscribe(MappedFile& _data)
+{
+    _data.ForEachLine([this](std::string_view line) { ProcessLine(line); });
+    Flush();
+}
+
+template <typename T>
+void PricingConnector<T>::ProcessLine(std::string_view singleLine)
+{
+    ProcessLine(singleLine, [this](Price<T>& priceObj) { batcher.Add(priceObj); });
+}
 
-        std::stringstream lineStream(singleLine);
-        std::string segment;
-        std::vector<std::string> parsedFields;
+template <typename T>
+void PricingConnector<T>::SetBatchSize(size_t batchSize)
+{
+    batcher.SetBatchSize(batchSize);
+}
+
+template <typename T>
+void PricingConnector<T>::SetMetrics(ListenerMetrics* metrics)
+{
+    batcher.SetMetrics(metrics);
+}
 
-        // Split by comma
-        while (std::getline(lineStream, segment, ','))
-        {
-            parsedFields.push_back(segment);
-        }
+template <typename T>
+void PricingConnector<T>::Flush()
+{
+    batcher.Flush();
+}
 
-        // Expect at least 3 columns: productId, bid_price, offer_price
-        if (parsedFields.size() < 3) continue;
+template <typename T>
+template <typename Deliver>
+void PricingConnector<T>::ProcessLine(std::string_view singleLine, Deliver&& deliver)
+{
+    if (singleLine.empty()) return;
 
-        // Extract fields
-        std::string _productId = parsedFields[0];
-        double bidVal = string2price(parsedFields[1]);
-        double offerVal = string2price(parsedFields[2]);
+    // Expect at least 3 columns: productId, bid_price, offer_price
+    if (SplitFields(singleLine, parsedFields) < 3) return;
 
-        // Convert productId to product object, e.g. Bond
-        T bondObj = GetBond(_productId);
+    // Extract fields
+    Tick256 bidVal = Tick256::FromString(parsedFields[1]);
+    Tick256 offerVal = Tick256::FromString(parsedFields[2]);
 
-        // Calculate mid and spread
-        double midVal = (bidVal + offerVal) / 2.0;
-        double spreadVal = offerVal - bidVal;
+    // Convert productId to product object, e.g. Bond
+    const T& productObj = GetProduct<T>(parsedFields[0]);
 
-        // Create a new Price<T> object
-        Price<T> priceObj(bondObj, midVal, spreadVal);
+    // Create a new Price<T> object
+    Price<T> priceObj(productObj, bidVal, offerVal);
 
-        // Pass the price to the service
-        serviceRef->OnMessage(priceObj);
-    }
+    // Pass the price on
+    deliver(priceObj);
 }
 
 #endif // PRICING_SERVICE_HPP
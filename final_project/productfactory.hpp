@@ -0,0 +1,102 @@
+/**
+ * productfactory.hpp
+ * Defines ProductTraits, the per-product-type layer connectors, journals
+ * and services use to construct and describe a product T, so none of them
+ * is tied to Bond. Specialised for Bond and IRSwap; a new product type
+ * needs a specialisation here and nothing else in the services.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef PRODUCT_FACTORY_HPP
+#define PRODUCT_FACTORY_HPP
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "products.hpp"
+#include "utility.hpp"
+
+using namespace std;
+
+// Reasonable PV01 values of the bonds
+// from the internet
+const map<string, double> bondPV01({{
+  {"912828V23", 0.019},
+  {"912828W22", 0.028},
+  {"912828X21", 0.046},
+  {"912828Y20", 0.064},
+  {"912828Z19", 0.091},
+  {"912810FZ8", 0.142},
+  {"912810GZ6", 0.183}
+}
+
+});
+
+// PV01 per unit notional of the par swaps, roughly their annuity / 10000
+const map<string, double> swapPV01({
+  {"USSW2", 0.0190},
+  {"USSW3", 0.0281},
+  {"USSW5", 0.0452},
+  {"USSW7", 0.0610},
+  {"USSW10", 0.0828},
+  {"USSW20", 0.1390},
+  {"USSW30", 0.1790}
+});
+
+/**
+ * ProductTraits
+ * For a product type T:
+ *   type           the ProductType tag
+ *   name           a short name, used e.g. for output directories
+ *   Get(id)        the cached T for an identifier (throws std::out_of_range)
+ *   GetProductIds  every identifier of the type, in term order
+ *   GetUnitPV01    PV01 of one unit of the product
+ */
+template <typename T>
+struct ProductTraits;
+
+template <>
+struct ProductTraits<Bond>
+{
+    static constexpr ProductType type = BOND;
+    static constexpr const char* name = "Bond";
+
+    static const Bond& Get(string_view id) { return GetBond(id); }
+
+    static vector<string> GetProductIds()
+    {
+        vector<string> ids;
+        for (const auto& entry : bondMap) ids.push_back(entry.second.first);
+        return ids;
+    }
+
+    static double GetUnitPV01(const Bond& bond) { return bondPV01.at(bond.GetProductId()); }
+};
+
+template <>
+struct ProductTraits<IRSwap>
+{
+    static constexpr ProductType type = IRSWAP;
+    static constexpr const char* name = "IRSwap";
+
+    static const IRSwap& Get(string_view id) { return GetSwap(id); }
+
+    static vector<string> GetProductIds()
+    {
+        vector<string> ids;
+        for (const auto& entry : swapMap) ids.push_back(entry.second);
+        return ids;
+    }
+
+    static double GetUnitPV01(const IRSwap& swap) { return swapPV01.at(swap.GetProductId()); }
+};
+
+// The cached product of type T for an identifier
+template <typename T>
+const T& GetProduct(string_view id)
+{
+    return ProductTraits<T>::Get(id);
+}
+
+#endif // PRODUCT_FACTORY_HPP
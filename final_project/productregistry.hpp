@@ -0,0 +1,283 @@
+/**
+ * productregistry.hpp
+ * Defines the ProductRegistry, which interns product identifiers (CUSIPs)
+ * to small dense integer indices, ProductStore, a dense per-product
+ * container that services use in place of std::map<string, V>, and
+ * ProductRef, the handle messages hold instead of a product copy.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef PRODUCT_REGISTRY_HPP
+#define PRODUCT_REGISTRY_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// Dense product index handed out by the registry
+typedef uint32_t ProductIndex;
+
+// Index of a product that was never registered (e.g. a default-constructed one)
+constexpr ProductIndex INVALID_PRODUCT_INDEX = UINT32_MAX;
+
+// Upper bound on distinct products in one process
+constexpr size_t MAX_PRODUCTS = 4096;
+
+/**
+ * ProductRegistry
+ * Process-wide table assigning each product identifier a stable index
+ * 0, 1, 2, ... in order of first registration. Registration is serialised;
+ * reading an already published identifier needs no lock.
+ */
+class ProductRegistry
+{
+public:
+    // The single registry shared by all services
+    static ProductRegistry& Instance();
+
+    // Index for the identifier, registering it if it is new
+    ProductIndex Intern(string_view productId);
+
+    // Index for the identifier, or INVALID_PRODUCT_INDEX if unknown
+    ProductIndex Find(string_view productId) const;
+
+    // Identifier registered at an index
+    const string& GetProductId(ProductIndex index) const;
+
+    // Number of registered products
+    size_t Size() const;
+
+private:
+    ProductRegistry();
+
+    mutable mutex registryMutex;
+    map<string, ProductIndex, less<>> indices;
+    vector<string> productIds;
+    atomic<size_t> productCount;
+};
+
+// -------------------- Implementation of ProductRegistry --------------------
+
+ProductRegistry& ProductRegistry::Instance()
+{
+    static ProductRegistry registry;
+    return registry;
+}
+
+ProductRegistry::ProductRegistry()
+    : productCount(0)
+{
+    // Never reallocate, so published identifiers can be read without the lock
+    productIds.reserve(MAX_PRODUCTS);
+}
+
+ProductIndex ProductRegistry::Intern(string_view productId)
+{
+    lock_guard<mutex> lock(registryMutex);
+    auto it = indices.find(productId);
+    if (it != indices.end()) return it->second;
+
+    if (productIds.size() >= MAX_PRODUCTS)
+    {
+        throw length_error("ProductRegistry is full");
+    }
+    ProductIndex index = static_cast<ProductIndex>(productIds.size());
+    productIds.emplace_back(productId);
+    indices.emplace(string(productId), index);
+    productCount.store(productIds.size(), memory_order_release);
+    return index;
+}
+
+ProductIndex ProductRegistry::Find(string_view productId) const
+{
+    lock_guard<mutex> lock(registryMutex);
+    auto it = indices.find(productId);
+    return (it != indices.end()) ? it->second : INVALID_PRODUCT_INDEX;
+}
+
+const string& ProductRegistry::GetProductId(ProductIndex index) const
+{
+    if (index >= productCount.load(memory_order_acquire))
+    {
+        throw out_of_range("Unknown product index");
+    }
+    return productIds[index];
+}
+
+size_t ProductRegistry::Size() const
+{
+    return productCount.load(memory_order_acquire);
+}
+
+/**
+ * ProductStore
+ * One V per product, held in a vector indexed by ProductIndex. Slots are
+ * created default-constructed on first access, like std::map::operator[];
+ * a lookup by identifier never creates one.
+ * As with a vector, references are invalidated when the store grows to
+ * cover a newly registered product.
+ */
+template <typename V>
+class ProductStore
+{
+public:
+    ProductStore();
+
+    // Slot for a product index
+    V& operator[](ProductIndex index);
+
+    // Compatibility lookup by identifier: the populated slot, or for an
+    // unknown identifier or empty slot a default V that is not stored
+    V& Get(string_view productId);
+
+    // Whether a slot has been populated for the product
+    bool Contains(ProductIndex index) const;
+
+    // Populated slot for the product, or nullptr
+    const V* Find(ProductIndex index) const;
+
+    // Number of populated slots
+    size_t Size() const;
+
+    // Call f(index, value) for each populated slot in index order
+    template <typename F>
+    void ForEach(F&& f);
+
+private:
+    vector<V> values;
+    vector<uint8_t> present;
+    size_t populated;
+    V emptyValue;
+};
+
+// -------------------- Implementation of ProductStore<V> --------------------
+
+template <typename V>
+ProductStore<V>::ProductStore()
+    : values(), present(), populated(0), emptyValue()
+{
+}
+
+template <typename V>
+V& ProductStore<V>::operator[](ProductIndex index)
+{
+    if (index == INVALID_PRODUCT_INDEX)
+    {
+        throw out_of_range("ProductStore access with an unregistered product");
+    }
+    if (index >= values.size())
+    {
+        // Grow to cover every product registered so far in one step
+        size_t newSize = max<size_t>(index + 1, ProductRegistry::Instance().Size());
+        values.resize(newSize);
+        present.resize(newSize, 0);
+    }
+    if (!present[index])
+    {
+        present[index] = 1;
+        ++populated;
+    }
+    return values[index];
+}
+
+template <typename V>
+V& ProductStore<V>::Get(string_view productId)
+{
+    // A miss must not register the identifier or populate a slot, or every
+    // ForEach would see it; hand out a fresh default instead
+    ProductIndex index = ProductRegistry::Instance().Find(productId);
+    if (Contains(index)) return values[index];
+    emptyValue = V();
+    return emptyValue;
+}
+
+template <typename V>
+bool ProductStore<V>::Contains(ProductIndex index) const
+{
+    return index < present.size() && present[index];
+}
+
+template <typename V>
+const V* ProductStore<V>::Find(ProductIndex index) const
+{
+    return Contains(index) ? &values[index] : nullptr;
+}
+
+template <typename V>
+size_t ProductStore<V>::Size() const
+{
+    return populated;
+}
+
+template <typename V>
+template <typename F>
+void ProductStore<V>::ForEach(F&& f)
+{
+    for (size_t i = 0; i < values.size(); ++i)
+    {
+        if (present[i]) f(static_cast<ProductIndex>(i), values[i]);
+    }
+}
+
+/**
+ * ProductRef
+ * Non-owning handle to a product that outlives every message referring to
+ * it, normally one built once by a product cache such as GetBond. Messages
+ * copy the pointer rather than the product's strings. Binding to a
+ * temporary is rejected at compile time, and binding to any other product
+ * must be spelled out, since a local would dangle just the same; a
+ * default-constructed handle refers to a shared default-constructed product.
+ */
+template <typename T>
+class ProductRef
+{
+public:
+    ProductRef();
+    explicit ProductRef(const T& _product);
+    ProductRef(T&&) = delete;
+
+    // The referenced product
+    const T& Get() const;
+
+private:
+    static const T& DefaultProduct();
+
+    const T* product;
+};
+
+// -------------------- Implementation of ProductRef<T> --------------------
+
+template <typename T>
+ProductRef<T>::ProductRef()
+    : product(&DefaultProduct())
+{
+}
+
+template <typename T>
+ProductRef<T>::ProductRef(const T& _product)
+    : product(&_product)
+{
+}
+
+template <typename T>
+const T& ProductRef<T>::Get() const
+{
+    return *product;
+}
+
+template <typename T>
+const T& ProductRef<T>::DefaultProduct()
+{
+    static const T defaultProduct{};
+    return defaultProduct;
+}
+
+#endif // PRODUCT_REGISTRY_HPP
@@ -11,6 +11,7 @@
 #include <string>
 
 #include "boost/date_time/gregorian/gregorian.hpp"
+#include "productregistry.hpp"
 
 using namespace std;
 using namespace boost::gregorian;
@@ -35,9 +36,13 @@ public:
   // Ge the product type
   ProductType GetProductType() const;
 
+  // Get the dense index the product identifier was interned to
+  ProductIndex GetProductIndex() const;
+
 private:
   string productId;
   ProductType productType;
+  ProductIndex productIndex = INVALID_PRODUCT_INDEX;
 
 };
 
@@ -164,6 +169,7 @@ Product::Product(string _productId, ProductType _productType)
 {
   productId = _productId;
   productType = _productType;
+  productIndex = ProductRegistry::Instance().Intern(productId);
 }
 
 const string& Product::GetProductId() const
@@ -176,6 +182,11 @@ ProductType Product::GetProductType() const
   return productType;
 }
 
+ProductIndex Product::GetProductIndex() const
+{
+  return productIndex;
+}
+
 Bond::Bond(string _productId, BondIdType _bondIdType, string _ticker, float _coupon, date _maturityDate) : Product(_productId, BOND)
 {
   bondIdType = _bondIdType;
@@ -228,7 +239,7 @@ IRSwap::IRSwap(string _productId, DayCountConvention _fixedLegDayCountConvention
   terminationDate =_terminationDate;
 }
 
-IRSwap::IRSwap() : Product(0, IRSWAP)
+IRSwap::IRSwap() : Product()
 {
 }
 
@@ -0,0 +1,255 @@
+/**
+ * replay.hpp
+ * Defines ReplayDriver, which merges several input feeds into one
+ * time-ordered stream and delivers it at a chosen speed: real time, N
+ * times faster, or as fast as possible. Records are timestamped either by
+ * spreading a feed evenly over a duration or from a leading microsecond
+ * field on every line (e.g. "1500,912828V23,99-160,99-162"), which is
+ * stripped before the line reaches the feed's handler.
+ *
+ * The feeds are read and ordered before the run, so the paced loop does no
+ * I/O. Latency is measured from each record's scheduled time, not from when
+ * it was actually delivered, so time spent waiting behind a slow record is
+ * counted as latency as it would be in production.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "latencyhistogram.hpp"
+#include "mappedfile.hpp"
+
+using namespace std;
+
+// Shorter waits than this are spun rather than slept, for pacing accuracy
+constexpr chrono::microseconds REPLAY_SPIN_THRESHOLD(50);
+
+/**
+ * What one feed saw during a run. Latency is scheduled time to handler
+ * return, in nanoseconds.
+ */
+struct ReplayFeedStats
+{
+    string name;
+    size_t records = 0;
+    LatencyHistogram latency;
+};
+
+/**
+ * What a run saw. lag is how late records were handed to their handlers
+ * (scheduled time to handler call, in nanoseconds).
+ */
+struct ReplayStats
+{
+    size_t records = 0;
+    double seconds = 0.0;
+    LatencyHistogram lag;
+    vector<ReplayFeedStats> feeds;
+};
+
+/**
+ * ReplayDriver
+ * Collects feeds (the records of a file, a timing for them and a handler
+ * for each record), then runs them interleaved in timestamp order on the
+ * calling thread. Records with equal timestamps go in the order their
+ * feeds were added, and in file order within a feed.
+ *
+ * A feed's optional flush callback is run whenever the driver is about to
+ * wait and once at the end, so connectors that batch records never hold
+ * one across an idle gap.
+ */
+class ReplayDriver
+{
+public:
+    using Handler = function<void(string_view)>;
+
+    ReplayDriver();
+
+    // Timestamp a feed's records evenly from startMicros over durationMicros
+    void AddFeed(const string& name, MappedFile& data, Handler handler, int64_t durationMicros,
+                 function<void()> flush = {}, int64_t startMicros = 0);
+
+    // Take a feed's timestamps from the leading microsecond field of each line
+    void AddTimestampedFeed(const string& name, MappedFile& data, Handler handler,
+                            function<void()> flush = {});
+
+    // 1 replays in real time, N runs N times faster, 0 as fast as possible
+    void SetSpeed(double _speed);
+
+    // Number of records loaded so far, over all feeds
+    size_t GetRecordCount() const;
+
+    // Deliver every record; the driver can be run again with the same feeds
+    ReplayStats Run();
+
+private:
+    struct Feed
+    {
+        string name;
+        Handler handler;
+        function<void()> flush;
+        string lines;  // the feed's records, back to back
+    };
+
+    struct Event
+    {
+        int64_t timestamp;
+        uint32_t feed;
+        uint32_t length;
+        size_t offset;
+    };
+
+    // Copy a line into a feed and schedule it
+    void AddEvent(size_t feed, int64_t timestamp, string_view line);
+
+    // Run every feed's flush callback
+    void FlushFeeds();
+
+    vector<Feed> feeds;
+    vector<Event> events;
+    bool sorted;
+    double speed;
+};
+
+// -------------------- Implementation of ReplayDriver --------------------
+
+ReplayDriver::ReplayDriver()
+    : sorted(true), speed(1.0)
+{
+}
+
+void ReplayDriver::AddFeed(const string& name, MappedFile& data, Handler handler, int64_t durationMicros,
+                           function<void()> flush, int64_t startMicros)
+{
+    size_t feed = feeds.size();
+    feeds.push_back(Feed{name, std::move(handler), std::move(flush), string()});
+    feeds.back().lines.reserve(data.GetSize());
+
+    size_t first = events.size();
+    data.ForEachLine([&](string_view line) {
+        if (!line.empty()) AddEvent(feed, 0, line);
+    });
+
+    // Spread the records evenly now that their number is known
+    size_t count = events.size() - first;
+    for (size_t i = 0; i < count; ++i)
+    {
+        events[first + i].timestamp =
+            startMicros + static_cast<int64_t>(static_cast<double>(durationMicros) * i / count);
+    }
+    sorted = false;
+}
+
+void ReplayDriver::AddTimestampedFeed(const string& name, MappedFile& data, Handler handler,
+                                      function<void()> flush)
+{
+    size_t feed = feeds.size();
+    feeds.push_back(Feed{name, std::move(handler), std::move(flush), string()});
+    feeds.back().lines.reserve(data.GetSize());
+
+    data.ForEachLine([&](string_view line) {
+        size_t comma = line.find(',');
+        int64_t timestamp = 0;
+        auto result = from_chars(line.data(), line.data() + min(comma, line.size()), timestamp);
+        if (comma == string_view::npos || result.ptr != line.data() + comma)
+        {
+            if (!line.empty()) cerr << "Error: " << name << " record without a timestamp: " << line << endl;
+            return;
+        }
+        AddEvent(feed, timestamp, line.substr(comma + 1));
+    });
+    sorted = false;
+}
+
+void ReplayDriver::SetSpeed(double _speed)
+{
+    speed = max(0.0, _speed);
+}
+
+size_t ReplayDriver::GetRecordCount() const
+{
+    return events.size();
+}
+
+ReplayStats ReplayDriver::Run()
+{
+    using Clock = chrono::steady_clock;
+
+    if (!sorted)
+    {
+        // Stable, so ties keep feed order and then file order
+        stable_sort(events.begin(), events.end(),
+                    [](const Event& a, const Event& b) { return a.timestamp < b.timestamp; });
+        sorted = true;
+    }
+
+    ReplayStats stats;
+    for (const Feed& feed : feeds)
+    {
+        stats.feeds.emplace_back();
+        stats.feeds.back().name = feed.name;
+    }
+
+    const bool paced = speed > 0.0;
+    const int64_t origin = events.empty() ? 0 : events.front().timestamp;
+    const Clock::time_point start = Clock::now();
+    for (const Event& event : events)
+    {
+        Clock::time_point due = start;
+        if (paced)
+        {
+            due += chrono::duration_cast<Clock::duration>(
+                chrono::duration<double, micro>((event.timestamp - origin) / speed));
+            if (Clock::now() < due)
+            {
+                FlushFeeds();
+                if (due - Clock::now() > REPLAY_SPIN_THRESHOLD) this_thread::sleep_until(due - REPLAY_SPIN_THRESHOLD);
+                while (Clock::now() < due) {}
+            }
+        }
+
+        Clock::time_point delivered = Clock::now();
+        if (!paced) due = delivered;
+        Feed& feed = feeds[event.feed];
+        feed.handler(string_view(feed.lines.data() + event.offset, event.length));
+        Clock::time_point handled = Clock::now();
+
+        stats.lag.Record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(delivered - due).count()));
+        ReplayFeedStats& feedStats = stats.feeds[event.feed];
+        ++feedStats.records;
+        feedStats.latency.Record(static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(handled - due).count()));
+    }
+    FlushFeeds();
+
+    stats.records = events.size();
+    stats.seconds = chrono::duration<double>(Clock::now() - start).count();
+    return stats;
+}
+
+void ReplayDriver::AddEvent(size_t feed, int64_t timestamp, string_view line)
+{
+    string& lines = feeds[feed].lines;
+    events.push_back(Event{timestamp, static_cast<uint32_t>(feed), static_cast<uint32_t>(line.size()), lines.size()});
+    lines.append(line.data(), line.size());
+}
+
+void ReplayDriver::FlushFeeds()
+{
+    for (Feed& feed : feeds)
+    {
+        if (feed.flush) feed.flush();
+    }
+}
+
+#endif // REPLAY_HPP
@@ -0,0 +1,324 @@
+/**
+ * ringbuffer.hpp
+ * Defines bounded, lock-free ring buffers used to hand records between
+ * threads: SPSCQueue for one producer and MPSCQueue for several, each
+ * with a single consumer.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Assumed cache line size, used to keep producer and consumer state apart
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * SPSCQueue
+ * A fixed-capacity ring of T with exactly one pushing thread and one popping
+ * thread. Capacity is rounded up to a power of two. T must be default
+ * constructible and move assignable.
+ */
+template <typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(size_t _capacity);
+
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+    // Producer side: returns false if the ring is full
+    bool TryPush(T&& item);
+    bool TryPush(const T& item);
+
+    // Consumer side: returns false if the ring is empty
+    bool TryPop(T& item);
+
+    // Consumer side: call f(T&) in place on up to maxItems queued items,
+    // then release their slots at once; returns how many were consumed
+    template <typename F>
+    size_t ConsumeBatch(F&& f, size_t maxItems);
+
+    // Approximate number of queued items (exact when called from either end)
+    size_t Size() const;
+
+    // Number of slots in the ring
+    size_t Capacity() const;
+
+private:
+    template <typename U>
+    bool Push(U&& item);
+
+    vector<T> slots;
+    size_t mask;
+
+    // Consumer's line: next slot to pop, and the last tail it saw, so a pop
+    // reads the producer's line only when the queue looks empty
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head;
+    size_t cachedTail;
+
+    // Producer's line: next slot to push, and the last head it saw, so a
+    // push reads the consumer's line only when the queue looks full
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail;
+    size_t cachedHead;
+
+    // Keep whatever follows the queue off the producer's line
+    char padding[CACHE_LINE_SIZE - sizeof(atomic<size_t>) - sizeof(size_t)];
+};
+
+// -------------------- Implementation of SPSCQueue<T> --------------------
+
+template <typename T>
+SPSCQueue<T>::SPSCQueue(size_t _capacity)
+    : head(0), cachedTail(0), tail(0), cachedHead(0)
+{
+    size_t roundedCapacity = 1;
+    while (roundedCapacity < _capacity) roundedCapacity <<= 1;
+    slots.resize(roundedCapacity);
+    mask = roundedCapacity - 1;
+}
+
+template <typename T>
+template <typename U>
+bool SPSCQueue<T>::Push(U&& item)
+{
+    size_t currentTail = tail.load(memory_order_relaxed);
+    if (currentTail - cachedHead == slots.size())
+    {
+        cachedHead = head.load(memory_order_acquire);
+        if (currentTail - cachedHead == slots.size()) return false;
+    }
+    slots[currentTail & mask] = std::forward<U>(item);
+    tail.store(currentTail + 1, memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool SPSCQueue<T>::TryPush(T&& item)
+{
+    return Push(std::move(item));
+}
+
+template <typename T>
+bool SPSCQueue<T>::TryPush(const T& item)
+{
+    return Push(item);
+}
+
+template <typename T>
+bool SPSCQueue<T>::TryPop(T& item)
+{
+    size_t currentHead = head.load(memory_order_relaxed);
+    if (currentHead == cachedTail)
+    {
+        cachedTail = tail.load(memory_order_acquire);
+        if (currentHead == cachedTail) return false;
+    }
+    item = std::move(slots[currentHead & mask]);
+    head.store(currentHead + 1, memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename F>
+size_t SPSCQueue<T>::ConsumeBatch(F&& f, size_t maxItems)
+{
+    size_t currentHead = head.load(memory_order_relaxed);
+    if (currentHead == cachedTail)
+    {
+        cachedTail = tail.load(memory_order_acquire);
+    }
+    size_t count = min(cachedTail - currentHead, maxItems);
+    for (size_t i = 0; i < count; ++i)
+    {
+        f(slots[(currentHead + i) & mask]);
+    }
+    if (count > 0) head.store(currentHead + count, memory_order_release);
+    return count;
+}
+
+template <typename T>
+size_t SPSCQueue<T>::Size() const
+{
+    // Read head first so a concurrent pop can never make it pass tail
+    size_t currentHead = head.load(memory_order_acquire);
+    size_t currentTail = tail.load(memory_order_acquire);
+    return currentTail - currentHead;
+}
+
+template <typename T>
+size_t SPSCQueue<T>::Capacity() const
+{
+    return slots.size();
+}
+
+/**
+ * MPSCQueue
+ * A fixed-capacity ring of T that any number of threads may push to and
+ * exactly one thread pops from (a bounded Vyukov queue). Each slot carries
+ * a sequence number, so producers claim slots with one compare-and-swap
+ * and never wait on each other. Capacity is rounded up to a power of two.
+ * T must be default constructible and move assignable.
+ */
+template <typename T>
+class MPSCQueue
+{
+public:
+    explicit MPSCQueue(size_t _capacity);
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    // Producer side (any thread): returns false if the ring is full
+    bool TryPush(T&& item);
+    bool TryPush(const T& item);
+
+    // Consumer side: returns false if the ring is empty
+    bool TryPop(T& item);
+
+    // Consumer side: call f(T&) in place on up to maxItems published items;
+    // returns how many were consumed
+    template <typename F>
+    size_t ConsumeBatch(F&& f, size_t maxItems);
+
+    // Approximate number of queued items, counting claimed but unpublished slots
+    size_t Size() const;
+
+    // Number of slots in the ring
+    size_t Capacity() const;
+
+private:
+    struct Slot
+    {
+        atomic<size_t> sequence;
+        T value;
+    };
+
+    template <typename U>
+    bool Push(U&& item);
+
+    vector<Slot> slots;
+    size_t mask;
+
+    // Next position to claim, shared by the producers
+    alignas(CACHE_LINE_SIZE) atomic<size_t> tail;
+
+    // Next position to pop, written only by the consumer
+    alignas(CACHE_LINE_SIZE) atomic<size_t> head;
+};
+
+// -------------------- Implementation of MPSCQueue<T> --------------------
+
+template <typename T>
+MPSCQueue<T>::MPSCQueue(size_t _capacity)
+    : tail(0), head(0)
+{
+    size_t roundedCapacity = 1;
+    while (roundedCapacity < _capacity) roundedCapacity <<= 1;
+    slots = vector<Slot>(roundedCapacity);
+    mask = roundedCapacity - 1;
+    for (size_t i = 0; i < roundedCapacity; ++i)
+    {
+        slots[i].sequence.store(i, memory_order_relaxed);
+    }
+}
+
+template <typename T>
+template <typename U>
+bool MPSCQueue<T>::Push(U&& item)
+{
+    size_t position = tail.load(memory_order_relaxed);
+    Slot* slot;
+    while (true)
+    {
+        slot = &slots[position & mask];
+        size_t sequence = slot->sequence.load(memory_order_acquire);
+        intptr_t lag = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (lag == 0)
+        {
+            // Slot is free for this position: try to claim it
+            if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) break;
+        }
+        else if (lag < 0)
+        {
+            // Slot still holds the item from one lap ago: ring is full
+            return false;
+        }
+        else
+        {
+            // Another producer claimed this position first
+            position = tail.load(memory_order_relaxed);
+        }
+    }
+    slot->value = std::forward<U>(item);
+    slot->sequence.store(position + 1, memory_order_release);
+    return true;
+}
+
+template <typename T>
+bool MPSCQueue<T>::TryPush(T&& item)
+{
+    return Push(std::move(item));
+}
+
+template <typename T>
+bool MPSCQueue<T>::TryPush(const T& item)
+{
+    return Push(item);
+}
+
+template <typename T>
+bool MPSCQueue<T>::TryPop(T& item)
+{
+    size_t position = head.load(memory_order_relaxed);
+    Slot& slot = slots[position & mask];
+    if (slot.sequence.load(memory_order_acquire) != position + 1) return false;
+
+    item = std::move(slot.value);
+    slot.sequence.store(position + slots.size(), memory_order_release);
+    head.store(position + 1, memory_order_release);
+    return true;
+}
+
+template <typename T>
+template <typename F>
+size_t MPSCQueue<T>::ConsumeBatch(F&& f, size_t maxItems)
+{
+    size_t position = head.load(memory_order_relaxed);
+    size_t count = 0;
+    while (count < maxItems)
+    {
+        Slot& slot = slots[(position + count) & mask];
+        if (slot.sequence.load(memory_order_acquire) != position + count + 1) break;
+        f(slot.value);
+        slot.sequence.store(position + count + slots.size(), memory_order_release);
+        ++count;
+    }
+    if (count > 0) head.store(position + count, memory_order_release);
+    return count;
+}
+
+template <typename T>
+size_t MPSCQueue<T>::Size() const
+{
+    size_t currentHead = head.load(memory_order_acquire);
+    size_t currentTail = tail.load(memory_order_acquire);
+    return currentTail - currentHead;
+}
+
+template <typename T>
+size_t MPSCQueue<T>::Capacity() const
+{
+    return slots.size();
+}
+
+#endif // RING_BUFFER_HPP
@@ -0,0 +1,647 @@
+/**
+ * riskreport.hpp
+ * Defines PositionHistory, a columnar store of persisted positions and risk
+ * loaded from the historical files (binary journals or .txt outputs), and
+ * RiskReport, which aggregates it: bucketed PV01, per-book exposure and PV01
+ * time series, as of any point in the history.
+ *
+ * Every column is a contiguous vector, so the kernels stream through one
+ * field at a time. Scans over rows are split in chunks across threads and
+ * their partial results reduced on the calling thread; products and books
+ * are dense indices, so per-product sums run in four independent lanes as
+ * RiskEngine's do.
+ *
+ * A position record is the full state of a product's books, and a risk
+ * record the full risk of a product, so "as of t" means each product's last
+ * record at or before t. Rows keep the order they were loaded in: load the
+ * files of several runs oldest first.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef RISK_REPORT_HPP
+#define RISK_REPORT_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "journal.hpp"
+#include "mappedfile.hpp"
+#include "positionservice.hpp"
+#include "productfactory.hpp"
+#include "riskservice.hpp"
+
+using namespace std;
+
+// Rows a worker is given at least, so small histories are not fanned out
+constexpr size_t REPORT_MIN_CHUNK_ROWS = 1 << 15;
+
+// Journal records read per block
+constexpr size_t REPORT_JOURNAL_BLOCK = 4096;
+
+/**
+ * Positions as columns, one row per book of a position record.
+ */
+struct PositionColumns
+{
+    vector<int64_t> timestamps;  // microseconds since the epoch
+    vector<ProductIndex> products;
+    vector<BookIndex> books;
+    vector<double> quantities;
+
+    size_t Size() const { return timestamps.size(); }
+};
+
+/**
+ * Risk as columns, one row per risk record.
+ */
+struct RiskColumns
+{
+    vector<int64_t> timestamps;  // microseconds since the epoch
+    vector<ProductIndex> products;
+    vector<double> pv01s;        // PV01 of one unit
+    vector<double> quantities;
+
+    size_t Size() const { return timestamps.size(); }
+};
+
+/**
+ * What one book holds: its net quantity and the PV01 of it.
+ */
+struct BookExposure
+{
+    string book;
+    double quantity = 0.0;
+    double pv01 = 0.0;
+};
+
+/**
+ * PositionHistory
+ * Historical positions and risk of product type T. A file is read as a
+ * journal if it starts with a journal header, and as the comma-separated
+ * text output otherwise.
+ */
+template <typename T>
+class PositionHistory
+{
+public:
+    PositionHistory();
+
+    // Append the records of a positions file; returns the rows added
+    size_t LoadPositions(const string& path);
+
+    // Append the records of a risk file; returns the rows added
+    size_t LoadRisk(const string& path);
+
+    const PositionColumns& GetPositions() const;
+    const RiskColumns& GetRisk() const;
+
+    // Earliest and latest timestamp over both stores (0 if empty)
+    int64_t GetFirstTimestamp() const;
+    int64_t GetLastTimestamp() const;
+
+private:
+    // Read the records of a V journal with append(record); returns false if
+    // path is not a journal, leaving the file to be read as text
+    template <typename V, typename Append>
+    static bool ReadJournal(const string& path, Append&& append);
+
+    // Index of a product identifier, or false if it is not a T
+    static bool FindProduct(string_view productId, ProductIndex& index);
+
+    // Microseconds since the epoch of a to_simple_string timestamp
+    bool ParseTimestamp(string_view field, int64_t& micros);
+
+    void AddExtent(int64_t timestamp);
+
+    PositionColumns positions;
+    RiskColumns risk;
+    string cachedDate;        // date part of the last text timestamp parsed
+    int64_t cachedDateMicros; // and its midnight
+    int64_t firstTimestamp;
+    int64_t lastTimestamp;
+};
+
+/**
+ * RiskReport
+ * Aggregates a PositionHistory with up to threadCount threads. The history
+ * must not be loaded into while a report over it is in use.
+ */
+template <typename T>
+class RiskReport
+{
+public:
+    explicit RiskReport(const PositionHistory<T>& history, size_t threadCount = thread::hardware_concurrency());
+
+    // PV01 of a sector from its members' last risk records at or before asOf
+    PV01<BucketedSector<T>> GetBucketedRisk(const BucketedSector<T>& sector, int64_t asOf = INT64_MAX) const;
+
+    // Quantity and PV01 of every book from each product's last position at
+    // or before asOf, valued at the unit PV01s of ProductTraits<T>
+    vector<BookExposure> GetBookExposure(int64_t asOf = INT64_MAX) const;
+
+    // Total PV01 at the close of each of count intervals from start
+    vector<double> GetPV01Series(int64_t start, int64_t interval, size_t count) const;
+
+    // As above, over the members of a sector
+    vector<double> GetPV01Series(const BucketedSector<T>& sector, int64_t start, int64_t interval,
+                                 size_t count) const;
+
+private:
+    // Number of chunks a scan over n rows is split in
+    size_t GetChunkCount(size_t n) const;
+
+    // Run f(begin, end, chunk) over GetChunkCount(n) chunks of the rows, the
+    // first on the calling thread
+    template <typename F>
+    void ParallelFor(size_t n, F&& f) const;
+
+    // Per key, one past the last row at or before asOf, or 0 if there is none
+    template <typename Key>
+    vector<size_t> LatestRows(const vector<int64_t>& timestamps, Key&& key, size_t keyCount, int64_t asOf) const;
+
+    // Per product, 1.0 for the members of a sector
+    vector<double> GetMemberColumn(const BucketedSector<T>& sector) const;
+
+    // PV01 series of the risk deltas weighted by weights[product]
+    vector<double> GetWeightedSeries(const vector<double>& weights, int64_t start, int64_t interval,
+                                     size_t count) const;
+
+    // sum of a[i] * b[i] * c[i], in four independent lanes so it vectorises
+    static double Dot(const double* a, const double* b, const double* c, size_t n);
+
+    const PositionHistory<T>& history;
+    size_t threadCount;
+    size_t productCount;
+    vector<double> unitPV01s;   // per product, from ProductTraits<T>
+    vector<double> riskDeltas;  // per risk row, its change to the product's risk
+};
+
+// -------------------- Implementation of PositionHistory<T> --------------------
+
+template <typename T>
+PositionHistory<T>::PositionHistory()
+    : cachedDateMicros(0), firstTimestamp(INT64_MAX), lastTimestamp(INT64_MIN)
+{
+}
+
+template <typename T>
+size_t PositionHistory<T>::LoadPositions(const string& path)
+{
+    const size_t before = positions.Size();
+    auto addRow = [this](int64_t timestamp, ProductIndex product, string_view book, double quantity) {
+        // A book beyond MAX_BOOKS was never booked, so it has no rows to load
+        BookIndex bookIndex = BookRegistry::Instance().Intern(book);
+        if (bookIndex == INVALID_BOOK_INDEX) return;
+        positions.timestamps.push_back(timestamp);
+        positions.products.push_back(product);
+        positions.books.push_back(bookIndex);
+        positions.quantities.push_back(quantity);
+        AddExtent(timestamp);
+    };
+
+    bool journal = ReadJournal<Position<T>>(path, [&](const PositionRecord& record) {
+        ProductIndex product;
+        if (!FindProduct(record.productId.View(), product)) return;
+        for (uint32_t i = 0; i < record.bookCount && i < JOURNAL_MAX_BOOKS; ++i)
+        {
+            addRow(record.timestamp, product, record.books[i].View(), static_cast<double>(record.quantities[i]));
+        }
+    });
+    if (journal) return positions.Size() - before;
+
+    MappedFile data(path);
+    if (!data.IsOpen()) return 0;
+    positions.timestamps.reserve(before + data.GetSize() / 32);
+
+    // timestamp,product,book,quantity,book,quantity,...,
+    data.ForEachLine([&](string_view line) {
+        if (line.empty()) return;
+        size_t comma = line.find(',');
+        int64_t timestamp;
+        if (comma == string_view::npos || !ParseTimestamp(line.substr(0, comma), timestamp))
+        {
+            cerr << "Error: position record without a timestamp: " << line << endl;
+            return;
+        }
+        string_view rest = line.substr(comma + 1);
+        comma = rest.find(',');
+        ProductIndex product;
+        if (!FindProduct(rest.substr(0, comma), product)) return;
+
+        while (comma != string_view::npos)
+        {
+            size_t bookEnd = rest.find(',', comma + 1);
+            if (bookEnd == string_view::npos) break;
+            size_t quantityEnd = rest.find(',', bookEnd + 1);
+            string_view book = rest.substr(comma + 1, bookEnd - comma - 1);
+            string_view quantity = rest.substr(bookEnd + 1, quantityEnd - min(quantityEnd, bookEnd + 1));
+            try
+            {
+                addRow(timestamp, product, book, static_cast<double>(ParseLong(quantity)));
+            }
+            catch (const invalid_argument&)
+            {
+                cerr << "Error: bad position quantity in " << line << endl;
+                return;
+            }
+            comma = quantityEnd;
+        }
+    });
+    return positions.Size() - before;
+}
+
+template <typename T>
+size_t PositionHistory<T>::LoadRisk(const string& path)
+{
+    const size_t before = risk.Size();
+    auto addRow = [this](int64_t timestamp, ProductIndex product, double pv01, double quantity) {
+        risk.timestamps.push_back(timestamp);
+        risk.products.push_back(product);
+        risk.pv01s.push_back(pv01);
+        risk.quantities.push_back(quantity);
+        AddExtent(timestamp);
+    };
+
+    bool journal = ReadJournal<PV01<T>>(path, [&](const PV01Record& record) {
+        ProductIndex product;
+        if (FindProduct(record.productId.View(), product))
+        {
+            addRow(record.timestamp, product, record.pv01, static_cast<double>(record.quantity));
+        }
+    });
+    if (journal) return risk.Size() - before;
+
+    MappedFile data(path);
+    if (!data.IsOpen()) return 0;
+    risk.timestamps.reserve(before + data.GetSize() / 48);
+
+    // timestamp,product,pv01,quantity,
+    data.ForEachLine([&](string_view line) {
+        if (line.empty()) return;
+        LineFields fields;
+        int64_t timestamp;
+        if (SplitFields(line, fields) < 4 || !ParseTimestamp(fields[0], timestamp))
+        {
+            cerr << "Error: malformed risk record: " << line << endl;
+            return;
+        }
+        ProductIndex product;
+        if (!FindProduct(fields[1], product)) return;
+
+        // strtod rather than from_chars, which not every standard library has for double
+        string pv01Text(fields[2]);
+        char* pv01End = nullptr;
+        double pv01 = strtod(pv01Text.c_str(), &pv01End);
+        try
+        {
+            if (pv01End != pv01Text.c_str() + pv01Text.size()) throw invalid_argument("Invalid PV01 field");
+            addRow(timestamp, product, pv01, static_cast<double>(ParseLong(fields[3])));
+        }
+        catch (const invalid_argument&)
+        {
+            cerr << "Error: malformed risk record: " << line << endl;
+        }
+    });
+    return risk.Size() - before;
+}
+
+template <typename T>
+const PositionColumns& PositionHistory<T>::GetPositions() const
+{
+    return positions;
+}
+
+template <typename T>
+const RiskColumns& PositionHistory<T>::GetRisk() const
+{
+    return risk;
+}
+
+template <typename T>
+int64_t PositionHistory<T>::GetFirstTimestamp() const
+{
+    return firstTimestamp <= lastTimestamp ? firstTimestamp : 0;
+}
+
+template <typename T>
+int64_t PositionHistory<T>::GetLastTimestamp() const
+{
+    return firstTimestamp <= lastTimestamp ? lastTimestamp : 0;
+}
+
+template <typename T>
+template <typename V, typename Append>
+bool PositionHistory<T>::ReadJournal(const string& path, Append&& append)
+{
+    ifstream input(path, ios::binary);
+    JournalHeader header;
+    if (!input.is_open() || !ReadJournalHeader(input, header)) return false;
+    if (!MatchesJournal<V>(header))
+    {
+        cerr << "Error: " << path << " is not a journal of the expected records" << endl;
+        return true;
+    }
+
+    // Records are read raw, without building a V for each
+    using Record = typename JournalTraits<V>::Record;
+    vector<Record> block(REPORT_JOURNAL_BLOCK);
+    while (input)
+    {
+        input.read(reinterpret_cast<char*>(block.data()), block.size() * sizeof(Record));
+        size_t count = static_cast<size_t>(input.gcount()) / sizeof(Record);
+        for (size_t i = 0; i < count; ++i) append(block[i]);
+    }
+    return true;
+}
+
+template <typename T>
+bool PositionHistory<T>::FindProduct(string_view productId, ProductIndex& index)
+{
+    try
+    {
+        index = GetProduct<T>(productId).GetProductIndex();
+        return true;
+    }
+    catch (const out_of_range&)
+    {
+        cerr << "Error: unknown product " << productId << endl;
+        return false;
+    }
+}
+
+template <typename T>
+bool PositionHistory<T>::ParseTimestamp(string_view field, int64_t& micros)
+{
+    // "2026-Oct-14 06:36:41.806256", without the fraction on whole seconds
+    size_t space = field.find(' ');
+    if (space == string_view::npos || field.size() < space + 9) return false;
+    string_view datePart = field.substr(0, space);
+    if (datePart != cachedDate)
+    {
+        try
+        {
+            cachedDateMicros = ToJournalTime(boost::posix_time::time_from_string(string(datePart) + " 00:00:00"));
+        }
+        catch (const exception&)
+        {
+            return false;
+        }
+        cachedDate = string(datePart);
+    }
+
+    const char* p = field.data() + space + 1;
+    const char* end = field.data() + field.size();
+    int hours = 0, minutes = 0, seconds = 0;
+    auto h = from_chars(p, end, hours);
+    if (h.ec != errc() || h.ptr == end || *h.ptr != ':') return false;
+    auto m = from_chars(h.ptr + 1, end, minutes);
+    if (m.ec != errc() || m.ptr == end || *m.ptr != ':') return false;
+    auto s = from_chars(m.ptr + 1, end, seconds);
+    if (s.ec != errc()) return false;
+
+    int64_t fraction = 0;
+    if (s.ptr != end)
+    {
+        if (*s.ptr != '.') return false;
+        auto f = from_chars(s.ptr + 1, end, fraction);
+        if (f.ec != errc() || f.ptr != end) return false;
+        for (ptrdiff_t digits = f.ptr - (s.ptr + 1); digits < 6; ++digits) fraction *= 10;
+    }
+    micros = cachedDateMicros + ((hours * 60LL + minutes) * 60LL + seconds) * 1000000LL + fraction;
+    return true;
+}
+
+template <typename T>
+void PositionHistory<T>::AddExtent(int64_t timestamp)
+{
+    firstTimestamp = min(firstTimestamp, timestamp);
+    lastTimestamp = max(lastTimestamp, timestamp);
+}
+
+// -------------------- Implementation of RiskReport<T> --------------------
+
+template <typename T>
+RiskReport<T>::RiskReport(const PositionHistory<T>& _history, size_t _threadCount)
+    : history(_history), threadCount(max<size_t>(_threadCount, 1)),
+      productCount(ProductRegistry::Instance().Size())
+{
+    unitPV01s.assign(productCount, 0.0);
+    for (const string& id : ProductTraits<T>::GetProductIds())
+    {
+        const T& product = GetProduct<T>(id);
+        if (product.GetProductIndex() < productCount)
+        {
+            unitPV01s[product.GetProductIndex()] = ProductTraits<T>::GetUnitPV01(product);
+        }
+    }
+
+    // Each risk record replaces its product's risk, so its contribution to the
+    // total is the difference from the product's previous record
+    const RiskColumns& risk = history.GetRisk();
+    const size_t n = risk.Size();
+    riskDeltas.resize(n);
+    const double* pv01s = risk.pv01s.data();
+    const double* quantities = risk.quantities.data();
+    double* deltas = riskDeltas.data();
+    for (size_t i = 0; i < n; ++i) deltas[i] = pv01s[i] * quantities[i];
+
+    vector<double> previous(productCount, 0.0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        double& last = previous[risk.products[i]];
+        double current = deltas[i];
+        deltas[i] = current - last;
+        last = current;
+    }
+}
+
+template <typename T>
+PV01<BucketedSector<T>> RiskReport<T>::GetBucketedRisk(const BucketedSector<T>& sector, int64_t asOf) const
+{
+    const RiskColumns& risk = history.GetRisk();
+    const ProductIndex* products = risk.products.data();
+    vector<size_t> latest = LatestRows(
+        risk.timestamps, [products](size_t row) { return products[row]; }, productCount, asOf);
+
+    // Gather each product's latest record into a dense column per field
+    vector<double> pv01s(productCount, 0.0);
+    vector<double> quantities(productCount, 0.0);
+    for (size_t p = 0; p < productCount; ++p)
+    {
+        if (latest[p] == 0) continue;
+        pv01s[p] = risk.pv01s[latest[p] - 1];
+        quantities[p] = risk.quantities[latest[p] - 1];
+    }
+
+    vector<double> members = GetMemberColumn(sector);
+    double total = Dot(pv01s.data(), quantities.data(), members.data(), productCount);
+    return PV01<BucketedSector<T>>(sector, total, 1);
+}
+
+template <typename T>
+vector<BookExposure> RiskReport<T>::GetBookExposure(int64_t asOf) const
+{
+    // Keyed on (product, book), so a book keeps its quantity from the
+    // product's last record that held it
+    const PositionColumns& positions = history.GetPositions();
+    const ProductIndex* products = positions.products.data();
+    const BookIndex* books = positions.books.data();
+    const size_t keyCount = productCount * MAX_BOOKS;
+    vector<size_t> latest = LatestRows(
+        positions.timestamps, [products, books](size_t row) { return products[row] * MAX_BOOKS + books[row]; },
+        keyCount, asOf);
+
+    vector<double> quantities(keyCount, 0.0);
+    vector<double> pv01s(keyCount, 0.0);
+    for (size_t key = 0; key < keyCount; ++key)
+    {
+        pv01s[key] = unitPV01s[key / MAX_BOOKS];
+        if (latest[key] != 0) quantities[key] = positions.quantities[latest[key] - 1];
+    }
+
+    vector<BookExposure> exposures;
+    const vector<double> ones(keyCount, 1.0);
+    vector<double> members(keyCount);
+    for (size_t b = 0; b < BookRegistry::Instance().Size(); ++b)
+    {
+        for (size_t key = 0; key < keyCount; ++key) members[key] = (key % MAX_BOOKS == b) ? 1.0 : 0.0;
+
+        BookExposure exposure;
+        exposure.book = BookRegistry::Instance().GetBook(static_cast<BookIndex>(b));
+        exposure.quantity = Dot(quantities.data(), ones.data(), members.data(), keyCount);
+        exposure.pv01 = Dot(quantities.data(), pv01s.data(), members.data(), keyCount);
+        exposures.push_back(exposure);
+    }
+    return exposures;
+}
+
+template <typename T>
+vector<double> RiskReport<T>::GetPV01Series(int64_t start, int64_t interval, size_t count) const
+{
+    return GetWeightedSeries(vector<double>(productCount, 1.0), start, interval, count);
+}
+
+template <typename T>
+vector<double> RiskReport<T>::GetPV01Series(const BucketedSector<T>& sector, int64_t start, int64_t interval,
+                                            size_t count) const
+{
+    return GetWeightedSeries(GetMemberColumn(sector), start, interval, count);
+}
+
+template <typename T>
+size_t RiskReport<T>::GetChunkCount(size_t n) const
+{
+    return max<size_t>(1, min(threadCount, n / REPORT_MIN_CHUNK_ROWS));
+}
+
+template <typename T>
+template <typename F>
+void RiskReport<T>::ParallelFor(size_t n, F&& f) const
+{
+    const size_t chunks = GetChunkCount(n);
+    const size_t chunkRows = (n + chunks - 1) / chunks;
+    vector<thread> workers;
+    for (size_t c = 1; c < chunks; ++c)
+    {
+        size_t begin = min(n, c * chunkRows);
+        size_t end = min(n, begin + chunkRows);
+        workers.emplace_back([&f, begin, end, c]() { f(begin, end, c); });
+    }
+    f(0, min(n, chunkRows), 0);
+    for (auto& worker : workers) worker.join();
+}
+
+template <typename T>
+template <typename Key>
+vector<size_t> RiskReport<T>::LatestRows(const vector<int64_t>& timestamps, Key&& key, size_t keyCount,
+                                         int64_t asOf) const
+{
+    const size_t n = timestamps.size();
+    vector<vector<size_t>> partials(GetChunkCount(n), vector<size_t>(keyCount, 0));
+    ParallelFor(n, [&](size_t begin, size_t end, size_t chunk) {
+        vector<size_t>& latest = partials[chunk];
+        for (size_t i = begin; i < end; ++i)
+        {
+            if (timestamps[i] <= asOf) latest[key(i)] = i + 1;
+        }
+    });
+
+    // Later chunks hold later rows, so the largest row wins
+    vector<size_t>& latest = partials[0];
+    for (size_t c = 1; c < partials.size(); ++c)
+    {
+        for (size_t k = 0; k < keyCount; ++k) latest[k] = max(latest[k], partials[c][k]);
+    }
+    return std::move(latest);
+}
+
+template <typename T>
+vector<double> RiskReport<T>::GetMemberColumn(const BucketedSector<T>& sector) const
+{
+    vector<double> members(productCount, 0.0);
+    for (auto& p : sector.GetProducts())
+    {
+        if (p.GetProductIndex() < productCount) members[p.GetProductIndex()] = 1.0;
+    }
+    return members;
+}
+
+template <typename T>
+vector<double> RiskReport<T>::GetWeightedSeries(const vector<double>& weights, int64_t start, int64_t interval,
+                                                size_t count) const
+{
+    if (interval <= 0 || count == 0) return vector<double>(count, 0.0);
+
+    // Slot 0 collects everything before start, slot b + 1 interval b
+    const RiskColumns& risk = history.GetRisk();
+    const size_t n = risk.Size();
+    const int64_t end = start + interval * static_cast<int64_t>(count);
+    vector<vector<double>> partials(GetChunkCount(n), vector<double>(count + 1, 0.0));
+    ParallelFor(n, [&](size_t begin, size_t stop, size_t chunk) {
+        vector<double>& slots = partials[chunk];
+        for (size_t i = begin; i < stop; ++i)
+        {
+            int64_t timestamp = risk.timestamps[i];
+            if (timestamp >= end) continue;
+            size_t slot = timestamp < start ? 0 : static_cast<size_t>((timestamp - start) / interval) + 1;
+            slots[slot] += riskDeltas[i] * weights[risk.products[i]];
+        }
+    });
+
+    for (size_t c = 1; c < partials.size(); ++c)
+    {
+        for (size_t s = 0; s <= count; ++s) partials[0][s] += partials[c][s];
+    }
+
+    // The deltas sum to the risk held at the close of each interval
+    vector<double> series(count);
+    double total = partials[0][0];
+    for (size_t b = 0; b < count; ++b)
+    {
+        total += partials[0][b + 1];
+        series[b] = total;
+    }
+    return series;
+}
+
+template <typename T>
+double RiskReport<T>::Dot(const double* a, const double* b, const double* c, size_t n)
+{
+    double lanes[4] = {0.0, 0.0, 0.0, 0.0};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        for (size_t k = 0; k < 4; ++k) lanes[k] += a[i + k] * b[i + k] * c[i + k];
+    }
+    for (; i < n; ++i) lanes[0] += a[i] * b[i] * c[i];
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+#endif // RISK_REPORT_HPP
@@ -9,21 +9,26 @@
 #define RISK_SERVICE_HPP
 
 #include "positionservice.hpp"
+#include "productfactory.hpp"
 #include "soa.hpp"
+#include <memory>
 
-// Reasonable PV01 values of the bonds
-// from the internet
-const map<string, double> bondPV01({{
-  {"912828V23", 0.019},
-  {"912828W22", 0.028},
-  {"912828X21", 0.046},
-  {"912828Y20", 0.064},
-  {"912828Z19", 0.091},
-  {"912810FZ8", 0.142},
-  {"912810GZ6", 0.183}
-}
+template <typename T> class BucketedSector;
 
-});
+/**
+ * How a PV01 holds what it is the risk of. Products are cached for the
+ * life of the process and referenced; bucketed sectors are built by
+ * callers, often as temporaries, so a sector's PV01 keeps its own copy.
+ */
+template <typename T> struct PV01Subject {
+    using Type = ProductRef<T>;
+    static const T& Get(const Type& _subject) { return _subject.Get(); }
+};
+
+template <typename T> struct PV01Subject<BucketedSector<T>> {
+    using Type = BucketedSector<T>;
+    static const BucketedSector<T>& Get(const Type& _subject) { return _subject; }
+};
 
 /**
  * PV01 risk.
@@ -51,7 +56,7 @@ template <typename T> class PV01 {
     vector<string> PrintFunction() const;
 
   private:
-    T product;
+    typename PV01Subject<T>::Type product;
     double pv01;
     long quantity;
 };
@@ -63,7 +68,7 @@ PV01<T>::PV01(const T& _product, double _pv01, long _quantity)
     quantity = _quantity;
 }
 
-template <typename T> const T& PV01<T>::GetProduct() const { return product; }
+template <typename T> const T& PV01<T>::GetProduct() const { return PV01Subject<T>::Get(product); }
 
 template <typename T> double PV01<T>::GetPV01() const { return pv01; }
 
@@ -72,7 +77,7 @@ template <typename T> long PV01<T>::GetQuantity() const { return quantity; }
 template <typename T> void PV01<T>::SetQuantity(long _q) { quantity = _q; }
 
 template <typename T> vector<string> PV01<T>::PrintFunction() const {
-    string _product = product.GetProductId();
+    string _product = GetProduct().GetProductId();
     string _pv01 = to_string(pv01);
     string _quantity = to_string(quantity);
 
@@ -116,6 +121,176 @@ template <typename T> const string& BucketedSector<T>::GetName() const {
     return name;
 }
 
+// Index of a sector registered with a RiskEngine
+typedef uint32_t SectorIndex;
+
+// Index of a sector that was never registered
+constexpr SectorIndex INVALID_SECTOR_INDEX = UINT32_MAX;
+
+/**
+ * Risk engine keeping the PV01 x quantity of every product in columns
+ * indexed by ProductIndex (structure of arrays), and the aggregate of every
+ * registered sector. Each update applies its delta (new - old) to the
+ * sectors holding the product, so reading a sector's risk is O(1); a full
+ * recompute is a vectorisable dot product over the columns.
+ * Type T is the product type.
+ */
+template <typename T> class RiskEngine {
+
+  public:
+    // ctor
+    RiskEngine();
+
+    // Register a sector; its aggregate includes positions already held
+    SectorIndex AddSector(const BucketedSector<T>& _sector);
+
+    // Number of registered sectors
+    size_t GetSectorCount() const;
+
+    // A registered sector
+    const BucketedSector<T>& GetSector(SectorIndex _index) const;
+
+    // Index of the sector with this name, or INVALID_SECTOR_INDEX
+    SectorIndex FindSector(const string& _name) const;
+
+    // PV01 per unit of a product, looked up once and then cached
+    double GetUnitPV01(const T& _product);
+
+    // Record a product's new PV01 and quantity, updating its sectors
+    void Update(ProductIndex _index, double _unitPV01, long _quantity);
+
+    // Incrementally maintained risk (sum of PV01 x quantity) of a sector
+    double GetSectorRisk(SectorIndex _index) const;
+
+    // Risk of a sector computed from scratch over the columns
+    double ComputeSectorRisk(SectorIndex _index) const;
+
+    // Risk of any set of products computed from the columns
+    double ComputeRisk(const vector<T>& _products) const;
+
+    // Recompute every sector from scratch, discarding accumulated rounding
+    void Recompute();
+
+  private:
+    void Grow(size_t _size);
+
+    // sum of a[i] * b[i] * c[i], in four independent lanes so it vectorises
+    static double Dot(const double* _a, const double* _b, const double* _c, size_t _n);
+
+    vector<double> unitPV01s;
+    vector<double> quantities;
+    vector<uint8_t> knownUnitPV01s;
+    vector<unique_ptr<BucketedSector<T>>> sectors;
+    vector<vector<double>> sectorMembers;       // per sector, 1.0 at each member's index
+    vector<vector<SectorIndex>> productSectors; // per product, the sectors holding it
+    vector<double> sectorRisks;
+};
+
+template <typename T> RiskEngine<T>::RiskEngine() {}
+
+template <typename T>
+SectorIndex RiskEngine<T>::AddSector(const BucketedSector<T>& _sector) {
+    SectorIndex _index = static_cast<SectorIndex>(sectors.size());
+    sectors.emplace_back(new BucketedSector<T>(_sector));
+    sectorMembers.emplace_back(unitPV01s.size(), 0.0);
+    for (auto& p : _sector.GetProducts()) {
+        ProductIndex _product = p.GetProductIndex();
+        if (_product >= unitPV01s.size()) Grow(_product + 1);
+        if (sectorMembers[_index][_product] != 0.0) continue;
+        sectorMembers[_index][_product] = 1.0;
+        productSectors[_product].push_back(_index);
+    }
+    sectorRisks.push_back(ComputeSectorRisk(_index));
+    return _index;
+}
+
+template <typename T> size_t RiskEngine<T>::GetSectorCount() const {
+    return sectors.size();
+}
+
+template <typename T>
+const BucketedSector<T>& RiskEngine<T>::GetSector(SectorIndex _index) const {
+    return *sectors.at(_index);
+}
+
+template <typename T>
+SectorIndex RiskEngine<T>::FindSector(const string& _name) const {
+    for (size_t i = 0; i < sectors.size(); ++i) {
+        if (sectors[i]->GetName() == _name) return static_cast<SectorIndex>(i);
+    }
+    return INVALID_SECTOR_INDEX;
+}
+
+template <typename T> double RiskEngine<T>::GetUnitPV01(const T& _product) {
+    ProductIndex _index = _product.GetProductIndex();
+    if (_index >= unitPV01s.size()) Grow(_index + 1);
+    if (!knownUnitPV01s[_index]) {
+        unitPV01s[_index] = ProductTraits<T>::GetUnitPV01(_product);
+        knownUnitPV01s[_index] = 1;
+    }
+    return unitPV01s[_index];
+}
+
+template <typename T>
+void RiskEngine<T>::Update(ProductIndex _index, double _unitPV01, long _quantity) {
+    if (_index >= unitPV01s.size()) Grow(_index + 1);
+    double _old = unitPV01s[_index] * quantities[_index];
+    unitPV01s[_index] = _unitPV01;
+    knownUnitPV01s[_index] = 1;
+    quantities[_index] = static_cast<double>(_quantity);
+    double _delta = _unitPV01 * quantities[_index] - _old;
+    for (SectorIndex _sector : productSectors[_index]) sectorRisks[_sector] += _delta;
+}
+
+template <typename T> double RiskEngine<T>::GetSectorRisk(SectorIndex _index) const {
+    return sectorRisks.at(_index);
+}
+
+template <typename T>
+double RiskEngine<T>::ComputeSectorRisk(SectorIndex _index) const {
+    const vector<double>& _members = sectorMembers.at(_index);
+    // A sector's member column may be shorter than products registered since
+    size_t _n = min(_members.size(), unitPV01s.size());
+    return Dot(unitPV01s.data(), quantities.data(), _members.data(), _n);
+}
+
+template <typename T>
+double RiskEngine<T>::ComputeRisk(const vector<T>& _products) const {
+    double _risk = 0.0;
+    for (auto& p : _products) {
+        ProductIndex _index = p.GetProductIndex();
+        if (_index < unitPV01s.size()) _risk += unitPV01s[_index] * quantities[_index];
+    }
+    return _risk;
+}
+
+template <typename T> void RiskEngine<T>::Recompute() {
+    for (size_t i = 0; i < sectors.size(); ++i) {
+        sectorRisks[i] = ComputeSectorRisk(static_cast<SectorIndex>(i));
+    }
+}
+
+template <typename T> void RiskEngine<T>::Grow(size_t _size) {
+    // Cover every product registered so far, as ProductStore does
+    size_t _newSize = max(_size, ProductRegistry::Instance().Size());
+    unitPV01s.resize(_newSize, 0.0);
+    quantities.resize(_newSize, 0.0);
+    knownUnitPV01s.resize(_newSize, 0);
+    productSectors.resize(_newSize);
+    for (auto& _members : sectorMembers) _members.resize(_newSize, 0.0);
+}
+
+template <typename T>
+double RiskEngine<T>::Dot(const double* _a, const double* _b, const double* _c, size_t _n) {
+    double _lanes[4] = {0.0, 0.0, 0.0, 0.0};
+    size_t i = 0;
+    for (; i + 4 <= _n; i += 4) {
+        for (size_t k = 0; k < 4; ++k) _lanes[k] += _a[i + k] * _b[i + k] * _c[i + k];
+    }
+    for (; i < _n; ++i) _lanes[0] += _a[i] * _b[i] * _c[i];
+    return (_lanes[0] + _lanes[1]) + (_lanes[2] + _lanes[3]);
+}
+
 // Pre-declearations to avoid errors
 template <typename T> class RiskServiceListener;
 
@@ -131,16 +306,37 @@ template <typename T> class RiskService : public Service<string, PV01<T>> {
     // Add a position that the service will risk
     void AddPosition(Position<T>& position);
 
-    // Get the bucketed risk for the bucket sector
-    const PV01<BucketedSector<T>>&
-    GetBucketedRisk(const BucketedSector<T>& sector) const;
+    // As above, passing the PV01 to sink(PV01<T>&) instead of the listeners
+    template <typename Sink>
+    void AddPosition(Position<T>& position, Sink&& sink);
+
+    // Risk a batch of positions, notifying each listener once with all the PV01s
+    void AddPositionBatch(Span<Position<T>> positionBatch);
+
+    // Register a sector whose risk is then maintained on every update
+    SectorIndex AddBucketedSector(const BucketedSector<T>& sector);
+
+    // Get the bucketed risk for the bucket sector; registered sectors
+    // (matched by name) are read from the engine, others are summed
+    PV01<BucketedSector<T>> GetBucketedRisk(const BucketedSector<T>& sector) const;
+
+    // Get the bucketed risk of a registered sector
+    PV01<BucketedSector<T>> GetBucketedRisk(SectorIndex sector) const;
+
+    // The engine holding per-product and per-sector risk
+    RiskEngine<T>& GetRiskEngine();
 
     // Get data from the given key
     PV01<T>& GetData(string _key);
 
-    // Call back function receiving new data
+    // Call back function receiving new data (e.g. replayed from a journal);
+    // stores the PV01 and updates the engine with it
     void OnMessage(PV01<T>& _data);
 
+    // Call f(pv01) for every stored PV01, in product index order
+    template <typename F>
+    void ForEachPV01(F&& f);
+
     // Add a listener to the Service
     void AddListener(ServiceListener<PV01<T>>* _listener);
 
@@ -151,23 +347,33 @@ template <typename T> class RiskService : public Service<string, PV01<T>> {
     RiskServiceListener<T>* GetListener();
 
   private:
-    map<string, PV01<T>> pv01s;
+    ProductStore<PV01<T>> pv01s;
     vector<ServiceListener<PV01<T>>*> listeners;
     RiskServiceListener<T>* listener;
+    vector<PV01<T>> pv01Batch;
+    RiskEngine<T> engine;
 };
 
 template <typename T> RiskService<T>::RiskService() {
-    pv01s = map<string, PV01<T>>();
+    pv01s = ProductStore<PV01<T>>();
     listeners = vector<ServiceListener<PV01<T>>*>();
     listener = new RiskServiceListener<T>(this);
 }
 
 template <typename T> PV01<T>& RiskService<T>::GetData(string _key) {
-    return pv01s[_key];
+    return pv01s.Get(_key);
 }
 
 template <typename T> void RiskService<T>::OnMessage(PV01<T>& _data) {
-    pv01s[_data.GetProduct().GetProductId()] = _data;
+    ProductIndex _index = _data.GetProduct().GetProductIndex();
+    pv01s[_index] = _data;
+    engine.Update(_index, _data.GetPV01(), _data.GetQuantity());
+}
+
+template <typename T>
+template <typename F>
+void RiskService<T>::ForEachPV01(F&& f) {
+    pv01s.ForEach([&f](ProductIndex, PV01<T>& _pv01) { f(_pv01); });
 }
 
 template <typename T>
@@ -185,35 +391,68 @@ template <typename T> RiskServiceListener<T>* RiskService<T>::GetListener() {
 }
 
 template <typename T> void RiskService<T>::AddPosition(Position<T>& _position) {
-    T _product = _position.GetProduct();
-    string _id = _product.GetProductId();
-    double _pv01Value = bondPV01.at(_id);
+    AddPosition(_position, ListenerSink<PV01<T>>(listeners));
+}
+
+template <typename T>
+template <typename Sink>
+void RiskService<T>::AddPosition(Position<T>& _position, Sink&& sink) {
+    const T& _product = _position.GetProduct();
+    double _pv01Value = engine.GetUnitPV01(_product);
     long _quantity = _position.GetAggregatePosition();
     PV01<T> _pv01(_product, _pv01Value, _quantity);
-    pv01s[_id] = _pv01;
+    pv01s[_product.GetProductIndex()] = _pv01;
+    engine.Update(_product.GetProductIndex(), _pv01Value, _quantity);
+
+    sink(_pv01);
+}
 
-    for (auto& l : listeners) {
-        l->ProcessAdd(_pv01);
+template <typename T>
+void RiskService<T>::AddPositionBatch(Span<Position<T>> _positionBatch) {
+    // Every position still yields its own PV01, since historical risk keeps each one
+    pv01Batch.clear();
+    for (Position<T>& _position : _positionBatch) {
+        AddPosition(_position, [this](PV01<T>& _pv01) { pv01Batch.push_back(_pv01); });
     }
+
+    for (auto* _listener : listeners) _listener->ProcessAddBatch(Span<PV01<T>>(pv01Batch));
+}
+
+template <typename T>
+SectorIndex RiskService<T>::AddBucketedSector(const BucketedSector<T>& _sector) {
+    return engine.AddSector(_sector);
 }
 
 template <typename T>
-const PV01<BucketedSector<T>>&
+PV01<BucketedSector<T>>
 RiskService<T>::GetBucketedRisk(const BucketedSector<T>& _sector) const {
-    BucketedSector<T> _product = _sector;
-    double _pv01 = 0.0;
-    long _quantity = 1;
+    SectorIndex _index = engine.FindSector(_sector.GetName());
+    if (_index != INVALID_SECTOR_INDEX) return GetBucketedRisk(_index);
+
+    return PV01<BucketedSector<T>>(_sector, engine.ComputeRisk(_sector.GetProducts()), 1);
+}
 
-    vector<T>& _products = _sector.GetProducts();
+template <typename T>
+PV01<BucketedSector<T>> RiskService<T>::GetBucketedRisk(SectorIndex _sector) const {
+    return PV01<BucketedSector<T>>(engine.GetSector(_sector), engine.GetSectorRisk(_sector), 1);
+}
 
-    for (auto& p : _products) {
-        string _pId = p.GetProductId();
-        long _q = pv01s[_pId].GetQuantity();
-        double _val = pv01s[_pId].GetPV01();
-        _pv01 += _val * (double)_q;
-    }
+template <typename T> RiskEngine<T>& RiskService<T>::GetRiskEngine() {
+    return engine;
+}
 
-    return PV01<BucketedSector<T>>(_product, _pv01, _quantity);
+/**
+ * The usual treasury buckets: front end (2Y, 3Y), belly (5Y, 7Y, 10Y)
+ * and long end (20Y, 30Y).
+ */
+vector<BucketedSector<Bond>> MakeTreasurySectors() {
+    auto _sector = [](const vector<int>& _maturities, const string& _name) {
+        vector<Bond> _bonds;
+        for (int m : _maturities) _bonds.push_back(GetBond(m));
+        return BucketedSector<Bond>(_bonds, _name);
+    };
+    return {_sector({2, 3}, "FrontEnd"), _sector({5, 7, 10}, "Belly"),
+            _sector({20, 30}, "LongEnd")};
 }
 
 /**
@@ -239,6 +478,9 @@ class RiskServiceListener : public ServiceListener<Position<T>> {
 
     // Listener callback to process an update event to the Service
     void ProcessUpdate(Position<T>& _data);
+
+    // Listener callback to process a batch of add events to the Service
+    void ProcessAddBatch(Span<Position<T>> _batch);
 };
 
 template <typename T>
@@ -251,6 +493,11 @@ void RiskServiceListener<T>::ProcessAdd(Position<T>& _data) {
     service->AddPosition(_data);
 }
 
+template <typename T>
+void RiskServiceListener<T>::ProcessAddBatch(Span<Position<T>> _batch) {
+    service->AddPositionBatch(_batch);
+}
+
 template <typename T>
 void RiskServiceListener<T>::ProcessRemove(Position<T>& _data) {}
 
@@ -0,0 +1,311 @@
+/**
+ * sharding.hpp
+ * Defines ShardedPipeline, which splits the main.cpp topology by product:
+ * N shards each own a full StaticPipeline (market data, algo execution,
+ * execution, trade booking, position, risk and the rest) on a worker
+ * thread, and a router on the calling thread sends every input record to
+ * the shard of its product. Every service is keyed by product, so shards
+ * share no state; the one cross-product figure, bucketed risk, is summed
+ * over the shards by GetBucketedRisk.
+ *
+ * Records of one product always reach the same shard in file order, and
+ * the feeds are routed one after another as in a sequential run. What a
+ * shard counts across its products (e.g. AlgoExecutionService's order
+ * numbers, which also pick the side) is counted per shard, so order IDs
+ * carry the shard number. Each shard writes its own historical files under
+ * "<outputDirectory>shard<i>/".
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef SHARDING_HPP
+#define SHARDING_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include "eventbus.hpp"
+#include "mappedfile.hpp"
+#include "productfactory.hpp"
+#include "ringbuffer.hpp"
+#include "staticpipeline.hpp"
+
+using namespace std;
+
+// Longest input record the router can carry to a shard
+constexpr size_t SHARD_LINE_CAPACITY = 118;
+
+// The input feed a routed record came from
+enum class ShardFeed : uint8_t
+{
+    PRICES,
+    MARKET_DATA,
+    TRADES,
+    INQUIRIES
+};
+
+/**
+ * One input record copied into a shard's queue.
+ */
+struct ShardLine
+{
+    ShardFeed feed;
+    uint8_t length;
+    char text[SHARD_LINE_CAPACITY];
+
+    string_view View() const { return string_view(text, length); }
+};
+
+/**
+ * ShardedPipeline
+ * Routes the four input feeds of a product type T to shardCount worker
+ * threads, pinned to cores 0..shardCount-1 if asked. A product's shard is
+ * its registry index modulo shardCount, so products spread evenly as more
+ * are added to the universe.
+ */
+template <typename T>
+class ShardedPipeline
+{
+public:
+    ShardedPipeline(size_t shardCount, const string& outputDirectory = DEFAULT_OUTPUT_DIRECTORY,
+                    bool pinThreads = false, size_t queueCapacity = DEFAULT_HANDOFF_CAPACITY);
+
+    ShardedPipeline(const ShardedPipeline&) = delete;
+    ShardedPipeline& operator=(const ShardedPipeline&) = delete;
+
+    // Persist and publish the GUI of every shard on background writer threads
+    void EnableAsync();
+
+    // Register a bucketed sector with every shard's risk service
+    void AddBucketedSector(const BucketedSector<T>& sector);
+
+    // Route prices, market data, trades and inquiries from inputDirectory in
+    // turn; returns once every shard has processed all of its records
+    void Run(const string& inputDirectory);
+
+    size_t GetShardCount() const;
+
+    // Shard that owns a product
+    size_t GetShardIndex(ProductIndex product) const;
+
+    // A shard's pipeline; only to be used while Run is not in progress
+    StaticPipeline<T>& GetShard(size_t shard);
+
+    // Records routed to each shard by the last Run
+    vector<size_t> GetRoutedCounts() const;
+
+    // Bucketed risk of a sector summed over the shards; only to be called
+    // while Run is not in progress
+    PV01<BucketedSector<T>> GetBucketedRisk(const BucketedSector<T>& sector);
+
+private:
+    struct Shard
+    {
+        explicit Shard(size_t queueCapacity) : queue(queueCapacity), closed(false), routed(0) {}
+
+        unique_ptr<StaticPipeline<T>> pipeline;
+        SPSCQueue<ShardLine> queue;
+        atomic<bool> closed;
+        size_t routed;
+    };
+
+    // Send every line of a feed to the shard of the product in field productField
+    void Route(ShardFeed feed, const string& path, size_t productField);
+
+    // Worker loop of a shard: process its records until it is closed and drained
+    static void Work(Shard& shard);
+
+    static void Process(StaticPipeline<T>& pipeline, const ShardLine& line);
+
+    vector<unique_ptr<Shard>> shards;
+    bool pinThreads;
+};
+
+// -------------------- Implementation of ShardedPipeline<T> --------------------
+
+template <typename T>
+ShardedPipeline<T>::ShardedPipeline(size_t shardCount, const string& outputDirectory, bool _pinThreads,
+                                    size_t queueCapacity)
+    : pinThreads(_pinThreads)
+{
+    shardCount = max<size_t>(shardCount, 1);
+    for (size_t i = 0; i < shardCount; ++i)
+    {
+        const string directory = outputDirectory + "shard" + to_string(i) + "/";
+        filesystem::create_directories(directory);
+
+        shards.emplace_back(new Shard(queueCapacity));
+        shards.back()->pipeline.reset(new StaticPipeline<T>(directory));
+        shards.back()->pipeline->GetAlgoExecutionService().SetOrderIdPrefix("S" + to_string(i) + "AlgoExec");
+    }
+}
+
+template <typename T>
+void ShardedPipeline<T>::EnableAsync()
+{
+    for (auto& shard : shards) shard->pipeline->EnableAsync();
+}
+
+template <typename T>
+void ShardedPipeline<T>::AddBucketedSector(const BucketedSector<T>& sector)
+{
+    for (auto& shard : shards) shard->pipeline->GetRiskService().AddBucketedSector(sector);
+}
+
+template <typename T>
+void ShardedPipeline<T>::Run(const string& inputDirectory)
+{
+    vector<thread> workers;
+    for (size_t i = 0; i < shards.size(); ++i)
+    {
+        Shard& shard = *shards[i];
+        shard.closed.store(false, memory_order_relaxed);
+        shard.routed = 0;
+        workers.emplace_back([&shard]() { Work(shard); });
+        if (pinThreads)
+        {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % max(1u, thread::hardware_concurrency()), &cpus);
+            pthread_setaffinity_np(workers.back().native_handle(), sizeof(cpu_set_t), &cpus);
+        }
+    }
+
+    // Same feed order as a sequential run; inquiries carry the product second
+    Route(ShardFeed::PRICES, inputDirectory + "prices.txt", 0);
+    Route(ShardFeed::MARKET_DATA, inputDirectory + "marketdata.txt", 0);
+    Route(ShardFeed::TRADES, inputDirectory + "trades.txt", 0);
+    Route(ShardFeed::INQUIRIES, inputDirectory + "inquiries.txt", 1);
+
+    for (auto& shard : shards) shard->closed.store(true, memory_order_release);
+    for (auto& worker : workers) worker.join();
+}
+
+template <typename T>
+size_t ShardedPipeline<T>::GetShardCount() const
+{
+    return shards.size();
+}
+
+template <typename T>
+size_t ShardedPipeline<T>::GetShardIndex(ProductIndex product) const
+{
+    return product % shards.size();
+}
+
+template <typename T>
+StaticPipeline<T>& ShardedPipeline<T>::GetShard(size_t shard)
+{
+    return *shards[shard]->pipeline;
+}
+
+template <typename T>
+vector<size_t> ShardedPipeline<T>::GetRoutedCounts() const
+{
+    vector<size_t> counts;
+    for (const auto& shard : shards) counts.push_back(shard->routed);
+    return counts;
+}
+
+template <typename T>
+PV01<BucketedSector<T>> ShardedPipeline<T>::GetBucketedRisk(const BucketedSector<T>& sector)
+{
+    double total = 0.0;
+    for (auto& shard : shards)
+    {
+        total += shard->pipeline->GetRiskService().GetBucketedRisk(sector).GetPV01();
+    }
+    return PV01<BucketedSector<T>>(sector, total, 1);
+}
+
+template <typename T>
+void ShardedPipeline<T>::Route(ShardFeed feed, const string& path, size_t productField)
+{
+    MappedFile data(path);
+    if (!data.IsOpen()) return;
+
+    data.ForEachLine([this, feed, productField](string_view line) {
+        if (line.empty()) return;
+        if (line.size() > SHARD_LINE_CAPACITY)
+        {
+            cerr << "Error: record too long to route: " << line << endl;
+            return;
+        }
+
+        // The product identifier is field productField of the record
+        string_view rest = line;
+        for (size_t i = 0; i < productField; ++i)
+        {
+            size_t comma = rest.find(',');
+            rest = (comma == string_view::npos) ? string_view() : rest.substr(comma + 1);
+        }
+        string_view productId = rest.substr(0, rest.find(','));
+
+        ProductIndex product;
+        try
+        {
+            product = GetProduct<T>(productId).GetProductIndex();
+        }
+        catch (const out_of_range&)
+        {
+            cerr << "Error: unknown product in " << line << endl;
+            return;
+        }
+
+        ShardLine record;
+        record.feed = feed;
+        record.length = static_cast<uint8_t>(line.size());
+        memcpy(record.text, line.data(), line.size());
+
+        Shard& shard = *shards[GetShardIndex(product)];
+        while (!shard.queue.TryPush(record))
+        {
+            this_thread::yield();
+        }
+        ++shard.routed;
+    });
+}
+
+template <typename T>
+void ShardedPipeline<T>::Work(Shard& shard)
+{
+    StaticPipeline<T>& pipeline = *shard.pipeline;
+    auto process = [&pipeline](ShardLine& line) { Process(pipeline, line); };
+    while (true)
+    {
+        // Read closed first, so nothing pushed before it was set is missed
+        bool closed = shard.closed.load(memory_order_acquire);
+        if (shard.queue.ConsumeBatch(process, DEFAULT_HANDOFF_CAPACITY) > 0) continue;
+        if (closed) return;
+        this_thread::yield();
+    }
+}
+
+template <typename T>
+void ShardedPipeline<T>::Process(StaticPipeline<T>& pipeline, const ShardLine& line)
+{
+    switch (line.feed)
+    {
+    case ShardFeed::PRICES:
+        pipeline.ProcessPriceLine(line.View());
+        break;
+    case ShardFeed::MARKET_DATA:
+        pipeline.ProcessMarketDataLine(line.View());
+        break;
+    case ShardFeed::TRADES:
+        pipeline.ProcessTradeLine(line.View());
+        break;
+    case ShardFeed::INQUIRIES:
+        pipeline.ProcessInquiryLine(line.View());
+        break;
+    }
+}
+
+#endif // SHARDING_HPP
@@ -0,0 +1,501 @@
+/**
+ * snapshot.hpp
+ * Defines a binary snapshot of the stateful services (positions, risk,
+ * inquiries and order books) for warm restarts. A snapshot is a header and
+ * one section per service of fixed-width records; positions, PV01s and
+ * inquiries reuse the journal record layouts of journal.hpp. Each of those
+ * sections also records how long its binary journal was when the snapshot
+ * was taken, so a restore loads the snapshot and replays only the journal
+ * records written after it.
+ *
+ * Journal records hold a product's or inquiry's full state, so replaying a
+ * record that the snapshot already reflects is harmless; journal lengths
+ * are therefore read before any state is serialised, once the historical
+ * services writing the journals have been flushed. A snapshot must be
+ * taken while no thread is updating the services.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "historicaldataservice.hpp"
+#include "inquiryservice.hpp"
+#include "journal.hpp"
+#include "marketdataservice.hpp"
+#include "positionservice.hpp"
+#include "riskservice.hpp"
+
+using namespace std;
+
+// Identifies a snapshot file and its layout revision
+constexpr char SNAPSHOT_MAGIC[8] = {'T', 'S', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+// Section type of order books, beyond the JournalRecordType values
+constexpr uint32_t SNAPSHOT_ORDER_BOOK = 16;
+
+/**
+ * Written once at the start of every snapshot file.
+ */
+struct SnapshotHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t sectionCount;
+    int64_t timestamp;
+};
+
+/**
+ * Precedes the records of one service. journalOffset is the byte length of
+ * the service's journal when the snapshot was taken (0 if it had none).
+ */
+struct SnapshotSection
+{
+    uint32_t recordType;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    uint64_t journalOffset;
+};
+
+struct OrderBookRecord
+{
+    FixedString<12> productId;
+    uint32_t bidCount;
+    uint32_t offerCount;
+    int32_t bidPrices[ORDER_BOOK_CAPACITY];
+    int32_t offerPrices[ORDER_BOOK_CAPACITY];
+    int64_t bidQuantities[ORDER_BOOK_CAPACITY];
+    int64_t offerQuantities[ORDER_BOOK_CAPACITY];
+};
+
+/**
+ * The binary journals replayed after a snapshot; an empty path has none.
+ */
+struct SnapshotJournals
+{
+    // The journals the historical services write under directory
+    explicit SnapshotJournals(const string& directory = DEFAULT_OUTPUT_DIRECTORY)
+        : positions(GetHistoricalFilePath("Position", HistoricalFormat::BINARY, directory)),
+          risk(GetHistoricalFilePath("Risk", HistoricalFormat::BINARY, directory)),
+          inquiries(GetHistoricalFilePath("Inquiry", HistoricalFormat::BINARY, directory))
+    {
+    }
+
+    // No journals: a restore loads the snapshot alone
+    static SnapshotJournals None()
+    {
+        SnapshotJournals journals;
+        journals.positions.clear();
+        journals.risk.clear();
+        journals.inquiries.clear();
+        return journals;
+    }
+
+    string positions;
+    string risk;
+    string inquiries;
+};
+
+/**
+ * What a restore loaded.
+ */
+struct SnapshotRestoreStats
+{
+    size_t snapshotRecords = 0;  // records read from the snapshot
+    size_t replayedRecords = 0;  // journal records replayed after it
+    size_t skippedRecords = 0;   // records of either that could not be decoded
+};
+
+/**
+ * ServiceSnapshot
+ * Saves and restores the state of one PositionService, RiskService,
+ * InquiryService and MarketDataService. SaveIfDue saves at most once per
+ * interval, for callers that reach a quiescent point regularly. The
+ * historical services that write the journals are registered with
+ * AddJournalWriter so each save can flush them first.
+ * Type T is the product type.
+ */
+template <typename T>
+class ServiceSnapshot
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    ServiceSnapshot(PositionService<T>& _positions, RiskService<T>& _risk,
+                    InquiryService<T>& _inquiries, MarketDataService<T>& _marketData,
+                    SnapshotJournals _journals = SnapshotJournals());
+
+    // Flush historicalService before each save, so the journal length
+    // recorded for its records covers everything published to it
+    template <typename V>
+    void AddJournalWriter(HistoricalDataService<V>& historicalService);
+
+    // Write the services' state to path, replacing any previous snapshot atomically
+    bool Save(const string& path);
+
+    // Save unless the previous save was less than interval ago
+    bool SaveIfDue(const string& path, chrono::milliseconds interval, Clock::time_point now = Clock::now());
+
+    // Load a snapshot into the services, then replay the journal tails;
+    // returns false if the snapshot is missing or unreadable
+    bool Restore(const string& path, SnapshotRestoreStats& stats);
+
+private:
+    // Write one section of journal-format records for the values f enumerates
+    template <typename V, typename ForEach>
+    void WriteSection(ofstream& out, const ptime& timestamp, const string& journal, ForEach&& forEach);
+
+    void WriteOrderBooks(ofstream& out);
+
+    // Read count records of a journal-format section into apply(V&),
+    // counting in skipped those that cannot be decoded
+    template <typename V, typename Apply>
+    bool ReadSection(ifstream& in, const SnapshotSection& section, size_t& skipped, Apply&& apply);
+
+    bool ReadOrderBooks(ifstream& in, const SnapshotSection& section, size_t& skipped);
+
+    // Replay the records of a journal from offset on into apply(V&); returns how many
+    template <typename V, typename Apply>
+    size_t ReplayJournalTail(const string& journal, uint64_t offset, size_t& skipped, Apply&& apply);
+
+    PositionService<T>& positions;
+    RiskService<T>& risk;
+    InquiryService<T>& inquiries;
+    MarketDataService<T>& marketData;
+    SnapshotJournals journals;
+    vector<function<void()>> journalWriters;
+    bool saved;
+    Clock::time_point lastSave;
+};
+
+// Byte length of a file, or 0 if it cannot be opened
+uint64_t GetFileLength(const string& path)
+{
+    if (path.empty()) return 0;
+    ifstream file(path, ios::in | ios::binary | ios::ate);
+    if (!file.is_open()) return 0;
+    return static_cast<uint64_t>(file.tellg());
+}
+
+// -------------------- Implementation of ServiceSnapshot<T> --------------------
+
+template <typename T>
+ServiceSnapshot<T>::ServiceSnapshot(PositionService<T>& _positions, RiskService<T>& _risk,
+                                    InquiryService<T>& _inquiries, MarketDataService<T>& _marketData,
+                                    SnapshotJournals _journals)
+    : positions(_positions), risk(_risk), inquiries(_inquiries), marketData(_marketData),
+      journals(std::move(_journals)), journalWriters(), saved(false)
+{
+}
+
+template <typename T>
+template <typename V>
+void ServiceSnapshot<T>::AddJournalWriter(HistoricalDataService<V>& historicalService)
+{
+    journalWriters.push_back([&historicalService]() { historicalService.Flush(); });
+}
+
+template <typename T>
+bool ServiceSnapshot<T>::Save(const string& path)
+{
+    // Records still queued or buffered would otherwise fall past the
+    // journal lengths read below and be missed by a restore
+    for (auto& flush : journalWriters) flush();
+
+    const string tempPath = path + ".tmp";
+    {
+        ofstream out(tempPath, ios::out | ios::trunc | ios::binary);
+        if (!out.is_open())
+        {
+            cerr << "Error: Unable to open snapshot file " << tempPath << endl;
+            return false;
+        }
+
+        ptime timestamp = microsec_clock::local_time();
+        SnapshotHeader header;
+        memset(&header, 0, sizeof(SnapshotHeader));
+        memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.version = SNAPSHOT_VERSION;
+        header.sectionCount = 4;
+        header.timestamp = ToJournalTime(timestamp);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        WriteSection<Position<T>>(out, timestamp, journals.positions,
+                                  [this](auto&& f) { positions.ForEachPosition(f); });
+        WriteSection<PV01<T>>(out, timestamp, journals.risk,
+                              [this](auto&& f) { risk.ForEachPV01(f); });
+        WriteSection<Inquiry<T>>(out, timestamp, journals.inquiries,
+                                 [this](auto&& f) { inquiries.ForEachInquiry(f); });
+        WriteOrderBooks(out);
+        if (!out)
+        {
+            cerr << "Error: Unable to write snapshot file " << tempPath << endl;
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        cerr << "Error: Unable to replace snapshot file " << path << endl;
+        return false;
+    }
+    saved = true;
+    lastSave = Clock::now();
+    return true;
+}
+
+template <typename T>
+bool ServiceSnapshot<T>::SaveIfDue(const string& path, chrono::milliseconds interval, Clock::time_point now)
+{
+    if (saved && now - lastSave < interval) return false;
+    return Save(path);
+}
+
+template <typename T>
+template <typename V, typename ForEach>
+void ServiceSnapshot<T>::WriteSection(ofstream& out, const ptime& timestamp, const string& journal,
+                                      ForEach&& forEach)
+{
+    using Record = typename JournalTraits<V>::Record;
+
+    // The journal length first: everything up to it is in the state below
+    SnapshotSection section;
+    memset(&section, 0, sizeof(SnapshotSection));
+    section.recordType = JournalTraits<V>::type;
+    section.recordSize = sizeof(Record);
+    section.journalOffset = GetFileLength(journal);
+
+    vector<Record> records;
+    forEach([&](const V& value) {
+        // A slot whose product was never set could not be restored
+        if (value.GetProduct().GetProductId().empty()) return;
+        records.emplace_back();
+        JournalTraits<V>::Encode(timestamp, value, records.back());
+    });
+    section.recordCount = records.size();
+
+    out.write(reinterpret_cast<const char*>(&section), sizeof(section));
+    out.write(reinterpret_cast<const char*>(records.data()),
+              static_cast<streamsize>(records.size() * sizeof(Record)));
+}
+
+template <typename T>
+void ServiceSnapshot<T>::WriteOrderBooks(ofstream& out)
+{
+    static_assert(is_trivially_copyable<OrderBookRecord>::value, "snapshot records must be trivially copyable");
+
+    vector<OrderBookRecord> records;
+    marketData.ForEachOrderBook([&records](const OrderBook<T>& book) {
+        if (book.GetProduct().GetProductId().empty()) return;
+        records.emplace_back();
+        OrderBookRecord& record = records.back();
+        memset(static_cast<void*>(&record), 0, sizeof(OrderBookRecord));
+        record.productId.Assign(book.GetProduct().GetProductId());
+        record.bidCount = static_cast<uint32_t>(book.GetBids().GetLevelCount());
+        record.offerCount = static_cast<uint32_t>(book.GetOffers().GetLevelCount());
+        for (uint32_t i = 0; i < record.bidCount; ++i)
+        {
+            record.bidPrices[i] = static_cast<int32_t>(book.GetBids().GetLevel(i).price.Ticks());
+            record.bidQuantities[i] = book.GetBids().GetLevel(i).quantity;
+        }
+        for (uint32_t i = 0; i < record.offerCount; ++i)
+        {
+            record.offerPrices[i] = static_cast<int32_t>(book.GetOffers().GetLevel(i).price.Ticks());
+            record.offerQuantities[i] = book.GetOffers().GetLevel(i).quantity;
+        }
+    });
+
+    SnapshotSection section;
+    memset(&section, 0, sizeof(SnapshotSection));
+    section.recordType = SNAPSHOT_ORDER_BOOK;
+    section.recordSize = sizeof(OrderBookRecord);
+    section.recordCount = records.size();
+    out.write(reinterpret_cast<const char*>(&section), sizeof(section));
+    out.write(reinterpret_cast<const char*>(records.data()),
+              static_cast<streamsize>(records.size() * sizeof(OrderBookRecord)));
+}
+
+template <typename T>
+bool ServiceSnapshot<T>::Restore(const string& path, SnapshotRestoreStats& stats)
+{
+    stats = SnapshotRestoreStats();
+    ifstream in(path, ios::in | ios::binary);
+    if (!in.is_open()) return false;
+
+    SnapshotHeader header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+        header.version != SNAPSHOT_VERSION)
+    {
+        cerr << "Error: " << path << " is not a snapshot" << endl;
+        return false;
+    }
+
+    for (uint32_t s = 0; s < header.sectionCount; ++s)
+    {
+        SnapshotSection section;
+        if (!in.read(reinterpret_cast<char*>(&section), sizeof(section)))
+        {
+            cerr << "Error: Snapshot " << path << " is truncated" << endl;
+            return false;
+        }
+
+        bool ok = true;
+        size_t skipped = 0;
+        switch (section.recordType)
+        {
+        case JOURNAL_POSITION:
+            ok = ReadSection<Position<T>>(in, section, skipped, [this](Position<T>& p) { positions.OnMessage(p); });
+            stats.replayedRecords += ReplayJournalTail<Position<T>>(
+                journals.positions, section.journalOffset, stats.skippedRecords, [this](Position<T>& p) { positions.OnMessage(p); });
+            break;
+        case JOURNAL_RISK:
+            ok = ReadSection<PV01<T>>(in, section, skipped, [this](PV01<T>& pv01) { risk.OnMessage(pv01); });
+            stats.replayedRecords += ReplayJournalTail<PV01<T>>(
+                journals.risk, section.journalOffset, stats.skippedRecords, [this](PV01<T>& pv01) { risk.OnMessage(pv01); });
+            break;
+        case JOURNAL_INQUIRY:
+            ok = ReadSection<Inquiry<T>>(in, section, skipped, [this](Inquiry<T>& i) { inquiries.Restore(i); });
+            stats.replayedRecords += ReplayJournalTail<Inquiry<T>>(
+                journals.inquiries, section.journalOffset, stats.skippedRecords, [this](Inquiry<T>& i) { inquiries.Restore(i); });
+            break;
+        case SNAPSHOT_ORDER_BOOK:
+            ok = ReadOrderBooks(in, section, skipped);
+            break;
+        default:
+            // A section this build does not know: skip it
+            in.seekg(static_cast<streamoff>(section.recordCount * section.recordSize), ios::cur);
+            continue;
+        }
+        if (!ok)
+        {
+            cerr << "Error: Snapshot " << path << " is truncated" << endl;
+            return false;
+        }
+        stats.snapshotRecords += section.recordCount - skipped;
+        stats.skippedRecords += skipped;
+    }
+    return true;
+}
+
+template <typename T>
+template <typename V, typename Apply>
+bool ServiceSnapshot<T>::ReadSection(ifstream& in, const SnapshotSection& section, size_t& skipped,
+                                     Apply&& apply)
+{
+    using Record = typename JournalTraits<V>::Record;
+    if (section.recordSize != sizeof(Record)) return false;
+
+    Record record;
+    ptime timestamp;
+    for (uint64_t i = 0; i < section.recordCount; ++i)
+    {
+        if (!in.read(reinterpret_cast<char*>(&record), sizeof(record))) return false;
+        try
+        {
+            V value = JournalTraits<V>::Decode(record, timestamp);
+            apply(value);
+        }
+        catch (const exception& e)
+        {
+            // e.g. a product this build does not know: skip just that record
+            cerr << "Error: Skipped a snapshot record: " << e.what() << endl;
+            ++skipped;
+        }
+    }
+    return true;
+}
+
+template <typename T>
+bool ServiceSnapshot<T>::ReadOrderBooks(ifstream& in, const SnapshotSection& section, size_t& skipped)
+{
+    if (section.recordSize != sizeof(OrderBookRecord)) return false;
+
+    OrderBookRecord record;
+    for (uint64_t i = 0; i < section.recordCount; ++i)
+    {
+        if (!in.read(reinterpret_cast<char*>(&record), sizeof(record))) return false;
+        OrderBook<T> book;
+        try
+        {
+            book.SetProduct(GetProduct<T>(record.productId.View()));
+        }
+        catch (const exception& e)
+        {
+            cerr << "Error: Skipped a snapshot order book: " << e.what() << endl;
+            ++skipped;
+            continue;
+        }
+        for (uint32_t l = 0; l < record.bidCount && l < ORDER_BOOK_CAPACITY; ++l)
+        {
+            book.AddLevel(BID, Tick256(record.bidPrices[l]), record.bidQuantities[l]);
+        }
+        for (uint32_t l = 0; l < record.offerCount && l < ORDER_BOOK_CAPACITY; ++l)
+        {
+            book.AddLevel(OFFER, Tick256(record.offerPrices[l]), record.offerQuantities[l]);
+        }
+        marketData.RestoreOrderBook(book);
+    }
+    return true;
+}
+
+template <typename T>
+template <typename V, typename Apply>
+size_t ServiceSnapshot<T>::ReplayJournalTail(const string& journal, uint64_t offset, size_t& skipped,
+                                             Apply&& apply)
+{
+    if (journal.empty()) return 0;
+    ifstream in(journal, ios::in | ios::binary);
+    if (!in.is_open()) return 0;
+
+    JournalHeader header;
+    if (!ReadJournalHeader(in, header) || !MatchesJournal<V>(header))
+    {
+        cerr << "Error: " << journal << " is not a matching journal" << endl;
+        return 0;
+    }
+
+    // Resume at the first whole record past the offset; a journal shorter
+    // than the offset was started afresh since, so replay all of it
+    const uint64_t recordSize = sizeof(typename JournalTraits<V>::Record);
+    uint64_t length = GetFileLength(journal);
+    if (offset > sizeof(JournalHeader) && offset <= length)
+    {
+        uint64_t records = (offset - sizeof(JournalHeader)) / recordSize;
+        in.seekg(static_cast<streamoff>(sizeof(JournalHeader) + records * recordSize));
+    }
+
+    size_t replayed = 0;
+    ptime timestamp;
+    V value;
+    while (true)
+    {
+        // A record that fails to decode has still been read, so carry on past it
+        try
+        {
+            if (!ReadJournalRecord(in, timestamp, value)) break;
+        }
+        catch (const exception& e)
+        {
+            cerr << "Error: Skipped a record of " << journal << ": " << e.what() << endl;
+            ++skipped;
+            continue;
+        }
+        apply(value);
+        ++replayed;
+    }
+    return replayed;
+}
+
+#endif // SNAPSHOT_HPP
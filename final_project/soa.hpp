@@ -13,11 +13,44 @@
 #include <vector>
 #include <map>
 #include <unordered_map>
+#include "metrics.hpp"
 #include "products.hpp"
 #include "utility.hpp"
 
 using namespace std;
 
+/**
+* A non-owning view of a contiguous run of values, used to pass a batch of
+* messages through one call.
+*/
+template<typename V>
+class Span
+{
+
+public:
+
+	Span() : first(nullptr), count(0) {}
+
+	Span(V* _first, size_t _count) : first(_first), count(_count) {}
+
+	Span(vector<V>& _values) : first(_values.data()), count(_values.size()) {}
+
+	V* begin() const { return first; }
+
+	V* end() const { return first + count; }
+
+	size_t size() const { return count; }
+
+	bool empty() const { return count == 0; }
+
+	V& operator[](size_t _index) const { return first[_index]; }
+
+private:
+
+	V* first;
+	size_t count;
+};
+
 /**
 * Definition of a generic base class ServiceListener to listen to add, update, and remove
 * events on a Service. This listener should be registered on a Service for the Service
@@ -38,6 +71,12 @@ public:
 	// Listener callback to process an update event to the Service
 	virtual void ProcessUpdate(V& _data) = 0;
 
+	// Listener callback to process a batch of add events, in order
+	virtual void ProcessAddBatch(Span<V> _batch)
+	{
+		for (V& data : _batch) ProcessAdd(data);
+	}
+
 };
 
 /**
@@ -56,6 +95,12 @@ public:
 	// The callback that a Connector should invoke for any new or updated data
 	virtual void OnMessage(V& _data) = 0;
 
+	// The callback for a batch of new or updated data, in order
+	virtual void OnMessageBatch(Span<V> _batch)
+	{
+		for (V& data : _batch) OnMessage(data);
+	}
+
 	// Add a listener to the Service for callbacks on add, remove, and update events for data to the Service.
 	virtual void AddListener(ServiceListener<V>* _listener) = 0;
 
@@ -64,6 +109,163 @@ public:
 
 };
 
+/**
+* A sink that passes data to the ProcessAdd callback of each listener in turn.
+* Services whose publish step is a template on where its output goes use this
+* for their dynamic listeners; staticpipeline.hpp passes concrete sinks instead.
+*/
+template<typename V>
+class ListenerSink
+{
+
+public:
+
+	explicit ListenerSink(const vector<ServiceListener<V>*>& _listeners) : listeners(_listeners) {}
+
+	void operator()(V& _data) const
+	{
+		for (auto* listener : listeners) listener->ProcessAdd(_data);
+	}
+
+private:
+
+	const vector<ServiceListener<V>*>& listeners;
+};
+
+/**
+* Collects the messages a subscriber Connector parses and hands them to
+* Service::OnMessageBatch in runs of up to batchSize. A batch size of 1 (the
+* default) calls OnMessage once per message; larger sizes amortise dispatch
+* at the cost of holding messages until the batch fills or is flushed.
+*/
+template<typename K, typename V>
+class MessageBatcher
+{
+
+public:
+
+	explicit MessageBatcher(Service<K, V>* _service, size_t _batchSize = 1)
+		: service(_service), batchSize(_batchSize), metrics(nullptr) {}
+
+	// Count and sample the calls made into the service (nullptr to stop)
+	void SetMetrics(ListenerMetrics* _metrics) { metrics = _metrics; }
+
+	void SetBatchSize(size_t _batchSize)
+	{
+		Flush();
+		batchSize = _batchSize;
+		pending.reserve(batchSize);
+	}
+
+	size_t GetBatchSize() const { return batchSize; }
+
+	// Queue one message, passing the batch on once it is full
+	void Add(V& _data)
+	{
+		if (batchSize <= 1)
+		{
+#ifndef SOA_NO_METRICS
+			if (metrics)
+			{
+				metrics->Measure(1, [&]() { service->OnMessage(_data); });
+				return;
+			}
+#endif
+			service->OnMessage(_data);
+			return;
+		}
+		pending.push_back(_data);
+		if (pending.size() >= batchSize) Flush();
+	}
+
+	// Pass on any partly filled batch
+	void Flush()
+	{
+		if (pending.empty()) return;
+#ifndef SOA_NO_METRICS
+		if (metrics)
+		{
+			metrics->Measure(pending.size(), [&]() { service->OnMessageBatch(Span<V>(pending)); });
+			pending.clear();
+			return;
+		}
+#endif
+		service->OnMessageBatch(Span<V>(pending));
+		pending.clear();
+	}
+
+private:
+
+	Service<K, V>* service;
+	size_t batchSize;
+	vector<V> pending;
+	ListenerMetrics* metrics;
+};
+
+/**
+* A listener that forwards every event to another listener, counting and
+* sampling the add events in a ListenerMetrics (see metrics.hpp).
+*/
+template<typename V>
+class InstrumentedListener : public ServiceListener<V>
+{
+
+public:
+
+	InstrumentedListener(ServiceListener<V>* _target, ListenerMetrics& _metrics)
+		: target(_target), metrics(_metrics) {}
+
+	void ProcessAdd(V& _data) override
+	{
+		metrics.Measure(1, [&]() { target->ProcessAdd(_data); });
+	}
+
+	void ProcessRemove(V& _data) override { target->ProcessRemove(_data); }
+
+	void ProcessUpdate(V& _data) override { target->ProcessUpdate(_data); }
+
+	void ProcessAddBatch(Span<V> _batch) override
+	{
+		metrics.Measure(_batch.size(), [&]() { target->ProcessAddBatch(_batch); });
+	}
+
+private:
+
+	ServiceListener<V>* target;
+	ListenerMetrics& metrics;
+};
+
+/**
+* Wrap a listener feeding _service from _source in an InstrumentedListener
+* if metrics are enabled; otherwise, or when built with -DSOA_NO_METRICS,
+* the listener itself is returned and calls to it cost nothing extra.
+*/
+template<typename V>
+ServiceListener<V>* Instrument(ServiceListener<V>* _listener, string_view _service, string_view _source)
+{
+#ifdef SOA_NO_METRICS
+	return _listener;
+#else
+	MetricsRegistry& registry = MetricsRegistry::Instance();
+	if (!registry.IsEnabled()) return _listener;
+	return new InstrumentedListener<V>(_listener, registry.AddListener(_service, _source));
+#endif
+}
+
+/**
+* Counters for a connector feeding _service from _source, for
+* MessageBatcher::SetMetrics; nullptr if metrics are disabled or compiled out.
+*/
+ListenerMetrics* InstrumentInput(string_view _service, string_view _source)
+{
+#ifdef SOA_NO_METRICS
+	return nullptr;
+#else
+	MetricsRegistry& registry = MetricsRegistry::Instance();
+	return registry.IsEnabled() ? &registry.AddListener(_service, _source) : nullptr;
+#endif
+}
+
 /**
 * Definition of a Connector class.
 * This will invoke the Service.OnMessage() method for subscriber Connectors
@@ -78,6 +280,9 @@ class Connector
 
 public:
 
+	// Services own their connectors and delete them through this base
+	virtual ~Connector() = default;
+
 	// Publish data to the Connector
 	virtual void Publish(V& _data) = 0;
 
@@ -0,0 +1,303 @@
+/**
+ * staticpipeline.hpp
+ * Defines StaticPipeline, the main.cpp service topology wired at compile
+ * time. Each hop calls the next service's sink-templated publish method
+ * directly (e.g. AlgoPublishPrice -> StreamingService -> PersistData),
+ * so no link goes through a ServiceListener or Connector virtual call and
+ * the optimiser can inline a whole chain. The services and their dynamic
+ * AddListener API are unchanged; this is an alternative wiring.
+ *
+ * The inquiry chain keeps its dynamic listener; it carries only a few
+ * records per product.
+ *
+ * A pipeline owns all of its state and shares none with a pipeline of
+ * another product type, so pipelines for Bond and IRSwap can run side by
+ * side on their own threads, each with its own input and output directory.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef STATIC_PIPELINE_HPP
+#define STATIC_PIPELINE_HPP
+
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include "AlgoExecutionService.hpp"
+#include "AlgoStreamingService.hpp"
+#include "GUIservice.hpp"
+#include "executionservice.hpp"
+#include "historicaldataservice.hpp"
+#include "inquiryservice.hpp"
+#include "mappedfile.hpp"
+#include "marketdataservice.hpp"
+#include "positionservice.hpp"
+#include "pricingservice.hpp"
+#include "riskservice.hpp"
+#include "streamingservice.hpp"
+#include "tradebookingservice.hpp"
+
+using namespace std;
+
+/**
+ * Fanout
+ * A sink passing each message to several sinks in order. The sinks are held
+ * by value in a tuple, so every call is direct.
+ */
+template <typename... Sinks>
+class Fanout
+{
+public:
+    explicit Fanout(Sinks... _sinks) : sinks(std::move(_sinks)...) {}
+
+    template <typename V>
+    void operator()(V& data)
+    {
+        apply([&data](auto&... sink) { (sink(data), ...); }, sinks);
+    }
+
+private:
+    tuple<Sinks...> sinks;
+};
+
+template <typename... Sinks>
+Fanout<Sinks...> MakeFanout(Sinks... sinks)
+{
+    return Fanout<Sinks...>(std::move(sinks)...);
+}
+
+/**
+ * StaticPipeline
+ * Owns one of each main.cpp service for product type T and pushes feed
+ * records through them with compile-time links, in the same order as the
+ * listener graph built in main.cpp, so the outputs are identical.
+ */
+template <typename T>
+class StaticPipeline
+{
+public:
+    // Persist the historical files and gui.txt under outputDirectory
+    explicit StaticPipeline(const string& outputDirectory = DEFAULT_OUTPUT_DIRECTORY);
+
+    // Persist and publish the GUI on background writer threads
+    void EnableAsync();
+
+    // Read prices, market data, trades and inquiries from inputDirectory in turn
+    void Run(const string& inputDirectory);
+
+    // Push every record of a feed through its chain
+    void SubscribePrices(MappedFile& data);
+    void SubscribeMarketData(MappedFile& data);
+    void SubscribeTrades(MappedFile& data);
+    void SubscribeInquiries(MappedFile& data);
+
+    // Push one record of a feed through its chain
+    void ProcessPriceLine(string_view line);
+    void ProcessMarketDataLine(string_view line);
+    void ProcessTradeLine(string_view line);
+    void ProcessInquiryLine(string_view line);
+
+    // Entry points for already parsed records
+    void OnPrice(Price<T>& price);
+    void OnOrderBook(OrderBook<T>& book);
+    void OnTrade(Trade<T>& trade);
+
+    // Risk of the products this pipeline has seen
+    RiskService<T>& GetRiskService();
+
+    AlgoExecutionService<T>& GetAlgoExecutionService();
+
+private:
+    void OnTopOfBook(TopOfBook<T>& top);
+    void OnAlgoStream(AlgoStream<T>& algoStream);
+    void OnAlgoExecution(AlgoExecution<T>& algoExecution);
+    void OnPosition(Position<T>& position);
+
+    MarketDataService<T> marketData;
+    PricingService<T> pricing;
+    TradeBookingService<T> tradeBooking;
+    PositionService<T> position;
+    RiskService<T> risk;
+    AlgoExecutionService<T> algoExecution;
+    AlgoStreamingService<T> algoStreaming;
+    ExecutionService<T> execution;
+    StreamingService<T> streaming;
+    InquiryService<T> inquiry;
+    GUIService<T> gui;
+    HistoricalDataService<Position<T>> historicalPosition;
+    HistoricalDataService<PV01<T>> historicalRisk;
+    HistoricalDataService<ExecutionOrder<T>> historicalExecution;
+    HistoricalDataService<PriceStream<T>> historicalStreaming;
+    HistoricalDataService<Inquiry<T>> historicalInquiry;
+};
+
+// -------------------- Implementation of StaticPipeline<T> --------------------
+
+template <typename T>
+StaticPipeline<T>::StaticPipeline(const string& outputDirectory)
+    : gui(outputDirectory + "gui.txt"),
+      historicalPosition("Position", FlushPolicy(), HistoricalFormat::TEXT, outputDirectory),
+      historicalRisk("Risk", FlushPolicy(), HistoricalFormat::TEXT, outputDirectory),
+      historicalExecution("Execution", FlushPolicy(), HistoricalFormat::TEXT, outputDirectory),
+      historicalStreaming("Streaming", FlushPolicy(), HistoricalFormat::TEXT, outputDirectory),
+      historicalInquiry("Inquiry", FlushPolicy(), HistoricalFormat::TEXT, outputDirectory)
+{
+    inquiry.AddListener(historicalInquiry.GetServiceListener());
+}
+
+template <typename T>
+void StaticPipeline<T>::EnableAsync()
+{
+    gui.EnableAsync();
+    historicalPosition.EnableAsync();
+    historicalRisk.EnableAsync();
+    historicalExecution.EnableAsync();
+    historicalStreaming.EnableAsync();
+    historicalInquiry.EnableAsync();
+}
+
+template <typename T>
+void StaticPipeline<T>::Run(const string& inputDirectory)
+{
+    MappedFile priceData(inputDirectory + "prices.txt");
+    SubscribePrices(priceData);
+    MappedFile marketData(inputDirectory + "marketdata.txt");
+    SubscribeMarketData(marketData);
+    MappedFile tradeData(inputDirectory + "trades.txt");
+    SubscribeTrades(tradeData);
+    MappedFile inquiryData(inputDirectory + "inquiries.txt");
+    SubscribeInquiries(inquiryData);
+}
+
+template <typename T>
+void StaticPipeline<T>::SubscribePrices(MappedFile& data)
+{
+    data.ForEachLine([this](string_view line) { ProcessPriceLine(line); });
+}
+
+template <typename T>
+void StaticPipeline<T>::SubscribeMarketData(MappedFile& data)
+{
+    data.ForEachLine([this](string_view line) { ProcessMarketDataLine(line); });
+}
+
+template <typename T>
+void StaticPipeline<T>::SubscribeTrades(MappedFile& data)
+{
+    data.ForEachLine([this](string_view line) { ProcessTradeLine(line); });
+}
+
+template <typename T>
+void StaticPipeline<T>::SubscribeInquiries(MappedFile& data)
+{
+    inquiry.GetConnector()->Subscribe(data);
+}
+
+template <typename T>
+void StaticPipeline<T>::ProcessPriceLine(string_view line)
+{
+    pricing.GetConnector()->ProcessLine(line, [this](Price<T>& price) { OnPrice(price); });
+}
+
+template <typename T>
+void StaticPipeline<T>::ProcessMarketDataLine(string_view line)
+{
+    marketData.GetConnector()->ProcessLine(line, [](OrderBook<T>&) {}, [this](TopOfBook<T>& top) { OnTopOfBook(top); });
+}
+
+template <typename T>
+void StaticPipeline<T>::ProcessTradeLine(string_view line)
+{
+    tradeBooking.GetConnector()->ProcessLine(line, [this](Trade<T>& trade) { OnTrade(trade); });
+}
+
+template <typename T>
+void StaticPipeline<T>::ProcessInquiryLine(string_view line)
+{
+    inquiry.GetConnector()->ProcessLine(line);
+}
+
+template <typename T>
+RiskService<T>& StaticPipeline<T>::GetRiskService()
+{
+    return risk;
+}
+
+template <typename T>
+AlgoExecutionService<T>& StaticPipeline<T>::GetAlgoExecutionService()
+{
+    return algoExecution;
+}
+
+template <typename T>
+void StaticPipeline<T>::OnPrice(Price<T>& price)
+{
+    // Pricing -> GUI, AlgoStreaming
+    pricing.OnMessage(price, MakeFanout(
+        [this](Price<T>& p) { gui.OnMessage(p); },
+        [this](Price<T>& p) {
+            algoStreaming.AlgoPublishPrice(p, [this](AlgoStream<T>& s) { OnAlgoStream(s); });
+        }));
+}
+
+template <typename T>
+void StaticPipeline<T>::OnAlgoStream(AlgoStream<T>& algoStream)
+{
+    // AlgoStreaming -> Streaming -> HistoricalStreaming
+    PriceStream<T>& priceStream = *algoStream.GetPriceStream();
+    streaming.OnMessage(priceStream);
+    historicalStreaming.PersistData(priceStream.GetProduct().GetProductId(), priceStream);
+}
+
+template <typename T>
+void StaticPipeline<T>::OnOrderBook(OrderBook<T>& book)
+{
+    // MarketData -> (top of book) AlgoExecution
+    marketData.OnMessage(book, [](OrderBook<T>&) {}, [this](TopOfBook<T>& top) { OnTopOfBook(top); });
+}
+
+template <typename T>
+void StaticPipeline<T>::OnTopOfBook(TopOfBook<T>& top)
+{
+    algoExecution.AlgoExecutionTrade(top, [this](AlgoExecution<T>& e) { OnAlgoExecution(e); });
+}
+
+template <typename T>
+void StaticPipeline<T>::OnAlgoExecution(AlgoExecution<T>& algoExecutionObj)
+{
+    // AlgoExecution -> Execution -> HistoricalExecution, TradeBooking
+    ExecutionOrder<T>& order = *algoExecutionObj.GetExecutionOrder();
+    execution.OnMessage(order);
+    execution.ExecuteOrder(order, MakeFanout(
+        [this](ExecutionOrder<T>& o) { historicalExecution.PersistData(o.GetProduct().GetProductId(), o); },
+        [this](ExecutionOrder<T>& o) {
+            tradeBooking.GetListener()->BookExecution(o, [this](Trade<T>& trade) {
+                auto toPosition = [this](Trade<T>& t) {
+                    position.AddTrade(t, [this](Position<T>& p) { OnPosition(p); });
+                };
+                tradeBooking.OnMessage(trade, toPosition);
+                tradeBooking.BookTrade(trade, toPosition);
+            });
+        }));
+}
+
+template <typename T>
+void StaticPipeline<T>::OnTrade(Trade<T>& trade)
+{
+    // TradeBooking -> Position
+    tradeBooking.OnMessage(trade, [this](Trade<T>& t) {
+        position.AddTrade(t, [this](Position<T>& p) { OnPosition(p); });
+    });
+}
+
+template <typename T>
+void StaticPipeline<T>::OnPosition(Position<T>& positionObj)
+{
+    // Position -> Risk -> HistoricalRisk, then HistoricalPosition
+    risk.AddPosition(positionObj, [this](PV01<T>& pv01) {
+        historicalRisk.PersistData(pv01.GetProduct().GetProductId(), pv01);
+    });
+    historicalPosition.PersistData(positionObj.GetProduct().GetProductId(), positionObj);
+}
+
+#endif // STATIC_PIPELINE_HPP
@@ -20,11 +20,11 @@ class PriceStreamOrder
 public:
     // Constructors
     PriceStreamOrder() = default;
-    PriceStreamOrder(double p, long visQty, long hidQty, PricingSide s);
+    PriceStreamOrder(Tick256 p, long visQty, long hidQty, PricingSide s);
 
     // Accessors
     PricingSide GetSide() const;
-    double GetPrice() const;
+    Tick256 GetPrice() const;
     long GetVisibleQuantity() const;
     long GetHiddenQuantity() const;
 
@@ -32,7 +32,7 @@ public:
     std::vector<std::string> PrintFunction() const;
 
 private:
-    double price;
+    Tick256 price;
     long visibleQuantity;
     long hiddenQuantity;
     PricingSide side;
@@ -60,19 +60,19 @@ public:
     std::vector<std::string> PrintFunction() const;
 
 private:
-    T product;
+    ProductRef<T> product;
     PriceStreamOrder bidOrder;
     PriceStreamOrder offerOrder;
 };
 
 // -------------------- Implementation of PriceStreamOrder --------------------
 
-PriceStreamOrder::PriceStreamOrder(double p, long visQty, long hidQty, PricingSide s)
+PriceStreamOrder::PriceStreamOrder(Tick256 p, long visQty, long hidQty, PricingSide s)
     : price(p), visibleQuantity(visQty), hiddenQuantity(hidQty), side(s)
 {
 }
 
-double PriceStreamOrder::GetPrice() const
+Tick256 PriceStreamOrder::GetPrice() const
 {
     return price;
 }
@@ -95,7 +95,7 @@ PricingSide PriceStreamOrder::GetSide() const
 std::vector<std::string> PriceStreamOrder::PrintFunction() const
 {
     // Convert numeric values to string
-    std::string priceStr   = price2string(price);
+    std::string priceStr   = price.ToString();
     std::string visibleStr = std::to_string(visibleQuantity);
     std::string hiddenStr  = std::to_string(hiddenQuantity);
     std::string sideStr    = (side == BID ? "BID" : "OFFER");
@@ -116,7 +116,7 @@ PriceStream<T>::PriceStream(const T& prod, const PriceStreamOrder& bidOrd, const
 template <typename T>
 const T& PriceStream<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
 }
 
 template <typename T>
@@ -135,7 +135,7 @@ template <typename T>
 std::vector<std::string> PriceStream<T>::PrintFunction() const
 {
     // Retrieve the product's ID (assuming T has GetProductId())
-    std::string prodIdStr = product.GetProductId();
+    std::string prodIdStr = product.Get().GetProductId();
 
     // Convert bid/offer orders to string fields
     std::vector<std::string> bidFields   = bidOrder.PrintFunction();
@@ -46,8 +46,11 @@ public:
     // Publish two-way prices
     void PublishPrice(PriceStream<T>& priceStreamObj);
 
+    // Publish a batch of two-way prices, notifying each listener once
+    void PublishPriceBatch(Span<PriceStream<T>> priceStreamBatch);
+
 private:
-    std::map<std::string, PriceStream<T>> priceStreams;
+    ProductStore<PriceStream<T>> priceStreams;
     std::vector<ServiceListener<PriceStream<T>>*> listeners;
     ServiceListener<AlgoStream<T>>* listener;
 };
@@ -57,7 +60,7 @@ private:
 template<typename T>
 StreamingService<T>::StreamingService()
 {
-    priceStreams = std::map<std::string, PriceStream<T>>();
+    priceStreams = ProductStore<PriceStream<T>>();
     listeners    = std::vector<ServiceListener<PriceStream<T>>*>();
     listener     = new StreamingServiceListener<T>(this);
 }
@@ -65,14 +68,13 @@ StreamingService<T>::StreamingService()
 template<typename T>
 PriceStream<T>& StreamingService<T>::GetData(std::string key)
 {
-    return priceStreams[key];
+    return priceStreams.Get(key);
 }
 
 template<typename T>
 void StreamingService<T>::OnMessage(PriceStream<T>& dataObj)
 {
-    std::string prodId = dataObj.GetProduct().GetProductId();
-    priceStreams[prodId] = dataObj;
+    priceStreams[dataObj.GetProduct().GetProductIndex()] = dataObj;
 }
 
 template<typename T>
@@ -103,6 +105,15 @@ void StreamingService<T>::PublishPrice(PriceStream<T>& priceStreamObj)
     }
 }
 
+template<typename T>
+void StreamingService<T>::PublishPriceBatch(Span<PriceStream<T>> priceStreamBatch)
+{
+    for (auto& ls : listeners)
+    {
+        ls->ProcessAddBatch(priceStreamBatch);
+    }
+}
+
 // -------------------------------------------------------------------------
 // CLASS: StreamingServiceListener<T>
 /**
@@ -124,9 +135,11 @@ public:
     void ProcessAdd(AlgoStream<T>& dataObj) override;
     void ProcessRemove(AlgoStream<T>& dataObj) override;
     void ProcessUpdate(AlgoStream<T>& dataObj) override;
+    void ProcessAddBatch(Span<AlgoStream<T>> batch) override;
 
 private:
     StreamingService<T>* service;
+    std::vector<PriceStream<T>> streamBatch;
 };
 
 // -------------------- Implementation of StreamingServiceListener<T> --------------------
@@ -156,6 +169,20 @@ void StreamingServiceListener<T>::ProcessAdd(AlgoStream<T>& dataObj)
     service->PublishPrice(*priceStreamPtr);
 }
 
+template<typename T>
+void StreamingServiceListener<T>::ProcessAddBatch(Span<AlgoStream<T>> batch)
+{
+    // Store each PriceStream, then publish them together
+    streamBatch.clear();
+    for (AlgoStream<T>& dataObj : batch)
+    {
+        PriceStream<T>* priceStreamPtr = dataObj.GetPriceStream();
+        service->OnMessage(*priceStreamPtr);
+        streamBatch.push_back(*priceStreamPtr);
+    }
+    service->PublishPriceBatch(Span<PriceStream<T>>(streamBatch));
+}
+
 template<typename T>
 void StreamingServiceListener<T>::ProcessRemove(AlgoStream<T>& /*dataObj*/)
 {
@@ -0,0 +1,164 @@
+/**
+ * threadedruntime.hpp
+ * Defines ThreadedRuntime, which runs the trading system's independent
+ * listener chains concurrently: one thread per input feed plus one per
+ * stage that drains queued EventBus edges (see eventbus.hpp).
+ *
+ * A service is only ever called from one thread. Where two chains feed the
+ * same service (e.g. TradeBookingService, fed by trades.txt and by
+ * ExecutionService), each producer reaches it through a queued edge and a
+ * stage thread owns the shared service and everything downstream of it.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef THREADED_RUNTIME_HPP
+#define THREADED_RUNTIME_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include "eventbus.hpp"
+
+using namespace std;
+
+// How a stage thread chooses between its inputs
+enum class StageOrder
+{
+    INTERLEAVED,  // drain whatever is ready, from any input
+    IN_ORDER      // drain input i+1 only once inputs 0..i are finished
+};
+
+/**
+ * ThreadedRuntime
+ * Collects feeds (a callable that pushes one input through its chain) and
+ * stages (a set of hand-offs to drain), then runs each on its own thread.
+ * A feed closes its output hand-offs when it returns; a stage exits once
+ * all its inputs are finished. Optionally pins thread i to core
+ * i % hardware_concurrency.
+ */
+class ThreadedRuntime
+{
+public:
+    explicit ThreadedRuntime(bool _pinThreads = false);
+
+    // A feed thread; the listed hand-offs are closed when the feed returns
+    void AddFeed(const string& name, function<void()> feed,
+                 vector<HandoffInput*> outputs = {});
+
+    // A stage thread draining the listed hand-offs
+    void AddStage(const string& name, vector<HandoffInput*> inputs,
+                  StageOrder order = StageOrder::INTERLEAVED);
+
+    // Start every thread and wait for all of them to finish
+    void Run();
+
+    // Wall-clock seconds each thread ran, in registration order
+    const vector<pair<string, double>>& GetTimings() const;
+
+private:
+    static void RunStage(const vector<HandoffInput*>& inputs, StageOrder order);
+    static void PinToCore(thread& worker, size_t core);
+
+    bool pinThreads;
+    vector<pair<string, function<void()>>> tasks;
+    vector<pair<string, double>> timings;
+};
+
+// -------------------- Implementation of ThreadedRuntime --------------------
+
+ThreadedRuntime::ThreadedRuntime(bool _pinThreads)
+    : pinThreads(_pinThreads)
+{
+}
+
+void ThreadedRuntime::AddFeed(const string& name, function<void()> feed,
+                              vector<HandoffInput*> outputs)
+{
+    tasks.emplace_back(name, [feed, outputs]() {
+        feed();
+        for (auto* output : outputs) output->Close();
+    });
+}
+
+void ThreadedRuntime::AddStage(const string& name, vector<HandoffInput*> inputs,
+                               StageOrder order)
+{
+    tasks.emplace_back(name, [inputs, order]() { RunStage(inputs, order); });
+}
+
+void ThreadedRuntime::Run()
+{
+    timings.assign(tasks.size(), {});
+    vector<thread> workers;
+    workers.reserve(tasks.size());
+    size_t cores = max(1u, thread::hardware_concurrency());
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        timings[i].first = tasks[i].first;
+        workers.emplace_back([this, i]() {
+            auto start = chrono::steady_clock::now();
+            tasks[i].second();
+            timings[i].second = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        });
+        if (pinThreads) PinToCore(workers.back(), i % cores);
+    }
+    for (auto& worker : workers) worker.join();
+}
+
+const vector<pair<string, double>>& ThreadedRuntime::GetTimings() const
+{
+    return timings;
+}
+
+void ThreadedRuntime::RunStage(const vector<HandoffInput*>& inputs, StageOrder order)
+{
+    int idleSpins = 0;
+    while (true)
+    {
+        size_t forwarded = 0;
+        bool finished = true;
+        for (auto* input : inputs)
+        {
+            if (input->IsFinished()) continue;
+            forwarded += input->Drain();
+            if (input->IsFinished()) continue;
+            finished = false;
+            if (order == StageOrder::IN_ORDER) break;
+        }
+        if (finished) break;
+
+        if (forwarded > 0)
+        {
+            idleSpins = 0;
+            continue;
+        }
+
+        // Nothing ready: back off as the async writers do
+        if (++idleSpins < 64)
+        {
+            this_thread::yield();
+            continue;
+        }
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+}
+
+void ThreadedRuntime::PinToCore(thread& worker, size_t core)
+{
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    if (pthread_setaffinity_np(worker.native_handle(), sizeof(cpus), &cpus) != 0)
+    {
+        cerr << "Error: unable to pin thread to core " << core << endl;
+    }
+}
+
+#endif // THREADED_RUNTIME_HPP
@@ -0,0 +1,170 @@
+/**
+ * throttle.hpp
+ * Defines a token-bucket rate limiter on steady_clock. A TokenBucket earns
+ * one token per refill interval up to a burst size, and a value is accepted
+ * only if a token is available; a Throttle keeps one bucket per product, or
+ * one for all products, and counts what it accepts and suppresses. Unlike
+ * a Conflator, a Throttle never holds a value back: suppressed values are
+ * dropped.
+ *
+ * @author Zixiuji Wang
+ */
+#ifndef THROTTLE_HPP
+#define THROTTLE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include "conflation.hpp"
+#include "productregistry.hpp"
+
+using namespace std;
+
+/**
+ * How a Throttle limits its values. A zero interval accepts every value.
+ * The scope is shared with ConflationPolicy.
+ */
+struct ThrottlePolicy
+{
+    chrono::nanoseconds interval = chrono::nanoseconds(0);
+    size_t burst = 1;
+    ConflationScope scope = ConflationScope::GLOBAL;
+
+    // At most maxPerSecond values per second (per product, or in total)
+    static ThrottlePolicy MaxRate(double maxPerSecond, size_t burst = 1,
+                                  ConflationScope scope = ConflationScope::GLOBAL);
+};
+
+/**
+ * Counters of a Throttle.
+ */
+struct ThrottleStats
+{
+    size_t accepted = 0;    // values let through
+    size_t suppressed = 0;  // values dropped for lack of a token
+};
+
+/**
+ * TokenBucket
+ * Earns one token per interval, holding at most burst of them. Tokens are
+ * kept as nanoseconds of credit, so refilling is one subtraction and no
+ * rounding accumulates. A new bucket starts full.
+ */
+class TokenBucket
+{
+public:
+    using Clock = chrono::steady_clock;
+
+    // Take a token now if one is available
+    bool TryAcquire(chrono::nanoseconds interval, size_t burst, Clock::time_point now);
+
+private:
+    bool started = false;
+    Clock::time_point lastRefill;
+    chrono::nanoseconds credit = chrono::nanoseconds(0);
+};
+
+/**
+ * Throttle
+ * Token-bucket limiter for values of type V, keyed on V::GetProduct() under
+ * ConflationScope::PER_PRODUCT. Not thread-safe.
+ */
+template <typename V>
+class Throttle
+{
+public:
+    using Clock = TokenBucket::Clock;
+
+    explicit Throttle(ThrottlePolicy _policy = ThrottlePolicy());
+
+    const ThrottlePolicy& GetPolicy() const;
+
+    // Whether data may be published now; counts it either way
+    bool Accept(const V& data, Clock::time_point now = Clock::now());
+
+    ThrottleStats GetStats() const;
+
+private:
+    TokenBucket& GetBucket(const V& data);
+
+    ThrottlePolicy policy;
+    ProductStore<TokenBucket> productBuckets;
+    TokenBucket globalBucket;
+    ThrottleStats stats;
+};
+
+// -------------------- Implementation of ThrottlePolicy --------------------
+
+ThrottlePolicy ThrottlePolicy::MaxRate(double maxPerSecond, size_t burst, ConflationScope scope)
+{
+    ThrottlePolicy policy;
+    policy.burst = burst;
+    policy.scope = scope;
+    if (maxPerSecond > 0.0)
+    {
+        policy.interval = chrono::duration_cast<chrono::nanoseconds>(
+            chrono::duration<double>(1.0 / maxPerSecond));
+    }
+    return policy;
+}
+
+// -------------------- Implementation of TokenBucket --------------------
+
+bool TokenBucket::TryAcquire(chrono::nanoseconds interval, size_t burst, Clock::time_point now)
+{
+    chrono::nanoseconds capacity = interval * static_cast<long>(max<size_t>(burst, 1));
+    if (!started)
+    {
+        started = true;
+        credit = capacity;
+    }
+    else
+    {
+        credit = min(capacity, credit + chrono::duration_cast<chrono::nanoseconds>(now - lastRefill));
+    }
+    lastRefill = now;
+
+    if (credit < interval) return false;
+    credit -= interval;
+    return true;
+}
+
+// -------------------- Implementation of Throttle<V> --------------------
+
+template <typename V>
+Throttle<V>::Throttle(ThrottlePolicy _policy)
+    : policy(_policy)
+{
+}
+
+template <typename V>
+const ThrottlePolicy& Throttle<V>::GetPolicy() const
+{
+    return policy;
+}
+
+template <typename V>
+bool Throttle<V>::Accept(const V& data, Clock::time_point now)
+{
+    if (policy.interval.count() <= 0 || GetBucket(data).TryAcquire(policy.interval, policy.burst, now))
+    {
+        ++stats.accepted;
+        return true;
+    }
+    ++stats.suppressed;
+    return false;
+}
+
+template <typename V>
+ThrottleStats Throttle<V>::GetStats() const
+{
+    return stats;
+}
+
+template <typename V>
+TokenBucket& Throttle<V>::GetBucket(const V& data)
+{
+    if (policy.scope == ConflationScope::GLOBAL) return globalBucket;
+    return productBuckets[data.GetProduct().GetProductIndex()];
+}
+
+#endif // THROTTLE_HPP
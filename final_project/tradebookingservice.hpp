@@ -14,9 +14,15 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <memory_resource>
 #include <sstream>
 #include <fstream>
 #include <iostream>
+#include "bookregistry.hpp"
+#include "execution.hpp"
+#include "mappedfile.hpp"
+#include "productfactory.hpp"
+#include "soa.hpp"
 #include "utility.hpp"
 
 // ============================================================================
@@ -44,30 +50,30 @@ class Trade
 public:
     // Constructors
     Trade() = default;
-    Trade(const T& _product, std::string _tradeId, double _price, std::string _book,
+    Trade(const T& _product, std::string_view _tradeId, Tick256 _price, std::string_view _book,
           long _quantity, Side _side);
 
     // Accessors
     const T& GetProduct() const;
-    const std::string& GetTradeId() const;
-    double GetPrice() const;
-    const std::string& GetBook() const;
+    std::string_view GetTradeId() const;
+    Tick256 GetPrice() const;
+    std::string_view GetBook() const;
     long GetQuantity() const;
     Side GetSide() const;
 
 private:
-    T product;
-    std::string tradeId;
-    double price;
-    std::string book;
+    ProductRef<T> product;
+    OrderId tradeId;
+    Tick256 price;
+    BookName book;
     long quantity;
     Side side;
 };
 
 // -------------------- Implementation of Trade<T> --------------------
 template <typename T>
-Trade<T>::Trade(const T& _product, std::string _tradeId, double _price,
-                std::string _book, long _quantity, Side _side)
+Trade<T>::Trade(const T& _product, std::string_view _tradeId, Tick256 _price,
+                std::string_view _book, long _quantity, Side _side)
     : product(_product), tradeId(_tradeId), price(_price), book(_book),
       quantity(_quantity), side(_side)
 {
@@ -76,25 +82,25 @@ Trade<T>::Trade(const T& _product, std::string _tradeId, double _price,
 template <typename T>
 const T& Trade<T>::GetProduct() const
 {
-    return product;
+    return product.Get();
 }
 
 template <typename T>
-const std::string& Trade<T>::GetTradeId() const
+std::string_view Trade<T>::GetTradeId() const
 {
-    return tradeId;
+    return tradeId.View();
 }
 
 template <typename T>
-double Trade<T>::GetPrice() const
+Tick256 Trade<T>::GetPrice() const
 {
     return price;
 }
 
 template <typename T>
-const std::string& Trade<T>::GetBook() const
+std::string_view Trade<T>::GetBook() const
 {
-    return book;
+    return book.View();
 }
 
 template <typename T>
@@ -125,6 +131,10 @@ class TradeBookingServiceListener;
  * TradeBookingService is responsible for booking trades for a given product.
  * Keyed by trade ID.
  * Type T is the product type.
+ *
+ * Trade nodes come from a pool owned by the service, which takes memory
+ * from the heap in growing chunks, so booking a steady stream of trades
+ * allocates only when the pool doubles.
  */
 template <typename T>
 class TradeBookingService : public Service<std::string, Trade<T>>
@@ -139,6 +149,10 @@ public:
     // Connector callback for new or updated trade data
     void OnMessage(Trade<T>& _data) override;
 
+    // Store a trade and pass it to sink(Trade<T>&) instead of the listeners
+    template <typename Sink>
+    void OnMessage(Trade<T>& _data, Sink&& sink);
+
     // Add a listener to the service
     void AddListener(ServiceListener<Trade<T>>* _listener) override;
 
@@ -154,8 +168,17 @@ public:
     // Book a trade
     void BookTrade(Trade<T>& tradeObj);
 
+    // Book a trade, passing it to sink(Trade<T>&) instead of the listeners
+    template <typename Sink>
+    void BookTrade(Trade<T>& tradeObj, Sink&& sink);
+
+    // Store a batch of trades, then notify each listener once with the whole batch
+    void OnMessageBatch(Span<Trade<T>> _batch) override;
+
 private:
-    std::map<std::string, Trade<T>> trades;
+    std::pmr::unsynchronized_pool_resource tradePool;
+    std::pmr::map<OrderId, Trade<T>> trades;
+    Trade<T> emptyTrade;
     std::vector<ServiceListener<Trade<T>>*> listeners;
     TradeBookingConnector<T>* connector;
     TradeBookingServiceListener<T>* listener;
@@ -164,9 +187,8 @@ private:
 // -------------------- Implementation of TradeBookingService<T> --------------------
 template <typename T>
 TradeBookingService<T>::TradeBookingService()
-    : trades(), listeners(), connector(nullptr), listener(nullptr)
+    : tradePool(), trades(&tradePool), emptyTrade(), listeners(), connector(nullptr), listener(nullptr)
 {
-    trades = std::map<std::string, Trade<T>>();
     listeners = std::vector<ServiceListener<Trade<T>>*>();
 
     // Create connector and a specialized service listener
@@ -177,21 +199,43 @@ TradeBookingService<T>::TradeBookingService()
 template <typename T>
 Trade<T>& TradeBookingService<T>::GetData(std::string _key)
 {
+    // No trade has an ID too long to store; hand out a fresh empty one
+    if (!OrderId::Fits(_key))
+    {
+        emptyTrade = Trade<T>();
+        return emptyTrade;
+    }
+
     // Return reference to the trade object in the map
-    return trades[_key];
+    return trades[OrderId(_key)];
 }
 
 template <typename T>
 void TradeBookingService<T>::OnMessage(Trade<T>& _data)
+{
+    // Notify all listeners
+    OnMessage(_data, ListenerSink<Trade<T>>(listeners));
+}
+
+template <typename T>
+template <typename Sink>
+void TradeBookingService<T>::OnMessage(Trade<T>& _data, Sink&& sink)
 {
     // Add or update trade in the map
-    trades[_data.GetTradeId()] = _data;
+    trades[OrderId(_data.GetTradeId())] = _data;
 
-    // Notify all listeners
-    for (auto& ls : listeners)
+    sink(_data);
+}
+
+template <typename T>
+void TradeBookingService<T>::OnMessageBatch(Span<Trade<T>> _batch)
+{
+    for (Trade<T>& tradeObj : _batch)
     {
-        ls->ProcessAdd(_data);
+        trades[OrderId(tradeObj.GetTradeId())] = tradeObj;
     }
+
+    for (auto* ls : listeners) ls->ProcessAddBatch(_batch);
 }
 
 template <typename T>
@@ -222,10 +266,14 @@ template <typename T>
 void TradeBookingService<T>::BookTrade(Trade<T>& tradeObj)
 {
     // Notify all listeners about this trade booking
-    for (auto& ls : listeners)
-    {
-        ls->ProcessAdd(tradeObj);
-    }
+    BookTrade(tradeObj, ListenerSink<Trade<T>>(listeners));
+}
+
+template <typename T>
+template <typename Sink>
+void TradeBookingService<T>::BookTrade(Trade<T>& tradeObj, Sink&& sink)
+{
+    sink(tradeObj);
 }
 
 // ============================================================================
@@ -249,14 +297,39 @@ public:
     // Subscribe data from an input stream
     void Subscribe(std::ifstream& _data) override;
 
+    // Subscribe data from a memory-mapped file, scanning it in place
+    void Subscribe(MappedFile& _data);
+
+    // Parse one trade record and pass it to the service
+    void ProcessLine(std::string_view line);
+
+    // Parse one trade record and pass it to deliver(Trade<T>&)
+    template <typename Deliver>
+    void ProcessLine(std::string_view line, Deliver&& deliver);
+
+    // Records per OnMessageBatch call (1 = one OnMessage per record)
+    void SetBatchSize(size_t batchSize);
+
+    // Count and sample the calls into the service (see InstrumentInput)
+    void SetMetrics(ListenerMetrics* metrics);
+
+    // Pass any records still held for a batch to the service
+    void Flush();
+
 private:
+    // Groups parsed records into batches for the service
+    MessageBatcher<std::string, Trade<T>> batcher;
+
     TradeBookingService<T>* bookingService;
+
+    // Scratch field storage reused across lines
+    LineFields fields;
 };
 
 // -------------------- Implementation of TradeBookingConnector<T> --------------------
 template <typename T>
 TradeBookingConnector<T>::TradeBookingConnector(TradeBookingService<T>* _service)
-    : bookingService(_service)
+    : batcher(_service), bookingService(_service)
 {
 }
 
@@ -270,40 +343,77 @@ template <typename T>
 void TradeBookingConnector<T>::Subscribe(std::ifstream& inputStream)
 {
     // Read lines from "trades.txt" (or another file) and create Trade objects
-    std::string lineData;
-    while (std::getline(inputStream, lineData))
+    LineReader reader(inputStream);
+    std::string_view lineData;
+    while (reader.NextLine(lineData))
+    {
+        ProcessLine(lineData);
+    }
+    Flush();
+}
+
+template <typename T>
+void TradeBookingConnector<T>::Subscribe(MappedFile& _data)
+{
+    _data.ForEachLine([this](std::string_view line) { ProcessLine(line); });
+    Flush();
+}
+
+template <typename T>
+void TradeBookingConnector<T>::ProcessLine(std::string_view lineData)
+{
+    ProcessLine(lineData, [this](Trade<T>& trade) { batcher.Add(trade); });
+}
+
+template <typename T>
+void TradeBookingConnector<T>::SetBatchSize(size_t batchSize)
+{
+    batcher.SetBatchSize(batchSize);
+}
+
+template <typename T>
+void TradeBookingConnector<T>::SetMetrics(ListenerMetrics* metrics)
+{
+    batcher.SetMetrics(metrics);
+}
+
+template <typename T>
+void TradeBookingConnector<T>::Flush()
+{
+    batcher.Flush();
+}
+
+template <typename T>
+template <typename Deliver>
+void TradeBookingConnector<T>::ProcessLine(std::string_view lineData, Deliver&& deliver)
+{
+    if (lineData.empty()) return;
+    if (SplitFields(lineData, fields) < 6) return;
+    if (!OrderId::Fits(fields[1]) || !BookName::Fits(fields[3]))
     {
-        if (lineData.empty()) continue;
-
-        std::stringstream lineStream(lineData);
-        std::string token;
-        std::vector<std::string> fields;
-
-        // Split line by commas
-        while (std::getline(lineStream, token, ','))
-        {
-            fields.push_back(token);
-        }
-        if (fields.size() < 6) continue;
-
-        // Extract data from fields
-        std::string productIdStr = fields[0];
-        std::string tradeIdStr = fields[1];
-        double parsedPrice = string2price(fields[2]);
-        std::string bookStr = fields[3];
-        long parsedQty = stol(fields[4]);
-        Side tradeSide = (fields[5] == "BUY") ? BUY : SELL;
-
-        // Convert productId to product, e.g., Bond
-        T bondProduct = GetBond(productIdStr);
-
-        // Create a Trade object
-        Trade<T> newTrade(bondProduct, tradeIdStr, parsedPrice, bookStr,
-                          parsedQty, tradeSide);
-
-        // Notify the service
-        bookingService->OnMessage(newTrade);
+        std::cerr << "Error: trade ID or book too long: " << lineData << std::endl;
+        return;
     }
+    if (BookRegistry::Instance().Intern(fields[3]) == INVALID_BOOK_INDEX)
+    {
+        std::cerr << "Error: more than " << MAX_BOOKS << " books, trade rejected: " << lineData << std::endl;
+        return;
+    }
+
+    // Extract data from fields
+    Tick256 parsedPrice = Tick256::FromString(fields[2]);
+    long parsedQty = ParseLong(fields[4]);
+    Side tradeSide = (fields[5] == "BUY") ? BUY : SELL;
+
+    // Convert productId to product, e.g., Bond
+    const T& productObj = GetProduct<T>(fields[0]);
+
+    // Create a Trade object
+    Trade<T> newTrade(productObj, fields[1], parsedPrice,
+                      fields[3], parsedQty, tradeSide);
+
+    // Pass the trade on
+    deliver(newTrade);
 }
 
 // ============================================================================
@@ -324,6 +434,10 @@ public:
     // Listener callback to process an add event
     void ProcessAdd(ExecutionOrder<T>& execOrder) override;
 
+    // Turn an execution into a trade and pass it to book(Trade<T>&)
+    template <typename Book>
+    void BookExecution(ExecutionOrder<T>& execOrder, Book&& book);
+
     // Listener callbacks (not used here)
     void ProcessRemove(ExecutionOrder<T>& execOrder) override;
     void ProcessUpdate(ExecutionOrder<T>& execOrder) override;
@@ -342,15 +456,27 @@ TradeBookingServiceListener<T>::TradeBookingServiceListener(TradeBookingService<
 
 template <typename T>
 void TradeBookingServiceListener<T>::ProcessAdd(ExecutionOrder<T>& execOrder)
+{
+    // Pass the trade to the booking service
+    TradeBookingService<T>* service = bookingService;
+    BookExecution(execOrder, [service](Trade<T>& trade) {
+        service->OnMessage(trade);
+        service->BookTrade(trade);
+    });
+}
+
+template <typename T>
+template <typename Book>
+void TradeBookingServiceListener<T>::BookExecution(ExecutionOrder<T>& execOrder, Book&& book)
 {
     // We maintain a small vector of possible book names
-    static std::vector<std::string> marketBooks = { "TRSY1", "TRSY2", "TRSY3" };
+    static const BookName marketBooks[] = { BookName("TRSY1"), BookName("TRSY2"), BookName("TRSY3") };
     ++bookedCount;
 
-    T productObj = execOrder.GetProduct();
+    const T& productObj = execOrder.GetProduct();
     PricingSide pSide = execOrder.GetPricingSide();
-    std::string orderIdStr = execOrder.GetOrderId();
-    double orderPrice = execOrder.GetPrice();
+    std::string_view orderIdStr = execOrder.GetOrderId();
+    Tick256 orderPrice = execOrder.GetPrice();
     long visibleQty = execOrder.GetVisibleQuantity();
     long hiddenQty = execOrder.GetHiddenQuantity();
 
@@ -360,16 +486,14 @@ void TradeBookingServiceListener<T>::ProcessAdd(ExecutionOrder<T>& execOrder)
     else tradeSide = BUY;
 
     // Determine which book in round-robin style
-    std::string chosenBook = marketBooks[bookedCount % 3];
+    std::string_view chosenBook = marketBooks[bookedCount % 3].View();
     long totalQty = visibleQty + hiddenQty;
 
     // Create a Trade object
     Trade<T> generatedTrade(productObj, orderIdStr, orderPrice,
                             chosenBook, totalQty, tradeSide);
 
-    // Pass the trade to the booking service
-    bookingService->OnMessage(generatedTrade);
-    bookingService->BookTrade(generatedTrade);
+    book(generatedTrade);
 }
 
 template <typename T>
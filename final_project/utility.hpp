@@ -4,14 +4,21 @@
 #include "boost/date_time/posix_time/posix_time.hpp"
 #include "products.hpp"
 #include <boost/date_time/gregorian/gregorian.hpp>
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <random>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <time.h>
 
 using boost::posix_time::microsec_clock;
@@ -38,7 +45,7 @@ const map<int, pair<string, date>> bondMap({
  * Associates each CUSIP string with an integer maturity in years.
  * E.g., "912828V23" -> 2.
  */
-const map<string, int> bondId({
+const map<string, int, less<>> bondId({
     {"912828V23", 2},
     {"912828W22", 3},
     {"912828X21", 5},
@@ -62,28 +69,134 @@ const map<string, double> bondCoupon({
 });
 
 /**
- * Converts a fractional price string (e.g., "99-16+") into a decimal price.
- * The format is "basePrice-XYz" where:
- *   - basePrice: integer part
- *   - XY: two-digit fraction (0..31)
- *   - z: extra fraction in 256ths (0..7 or '+', which represents 4)
+ * Vanilla USD swaps, one per bond maturity: maps a term in years to the
+ * swap identifier. All start on the same effective date.
  */
-double string2price(const std::string& fractional) {
-    size_t dashPos = fractional.find('-');
-    if (dashPos == std::string::npos) {
-        throw std::invalid_argument("Invalid fractional notation");
+const map<int, string> swapMap({
+    {2,  "USSW2"},
+    {3,  "USSW3"},
+    {5,  "USSW5"},
+    {7,  "USSW7"},
+    {10, "USSW10"},
+    {20, "USSW20"},
+    {30, "USSW30"}
+});
+
+const date swapEffectiveDate(2024, Dec, 15);
+
+// ============================================================================
+// FRACTIONAL PRICE CODEC
+// ============================================================================
+
+// Treasury prices are quoted in 32nds with a 1/256 sub-tick
+constexpr long TICKS_PER_POINT = 256;
+constexpr long TICKS_PER_32ND = 8;
+
+// Large enough for any "base-XYz" price of a long tick count
+constexpr size_t PRICE_BUFFER_SIZE = 32;
+
+// Two-digit 32nds, indexed by XY (0..31)
+constexpr char FRACTION_32ND_DIGITS[32][2] = {
+    {'0','0'},{'0','1'},{'0','2'},{'0','3'},{'0','4'},{'0','5'},{'0','6'},{'0','7'},
+    {'0','8'},{'0','9'},{'1','0'},{'1','1'},{'1','2'},{'1','3'},{'1','4'},{'1','5'},
+    {'1','6'},{'1','7'},{'1','8'},{'1','9'},{'2','0'},{'2','1'},{'2','2'},{'2','3'},
+    {'2','4'},{'2','5'},{'2','6'},{'2','7'},{'2','8'},{'2','9'},{'3','0'},{'3','1'}
+};
+
+// Sub-tick character indexed by z (0..7), with 4 written as '+'
+constexpr char FRACTION_256TH_CHARS[8] = {'0','1','2','3','+','5','6','7'};
+
+/**
+ * Parses a fractional price "base-XYz" in [first, last) into a count of 1/256
+ * ticks without allocating. Returns false on malformed input.
+ */
+bool ParsePriceTicks(const char* first, const char* last, long& ticks) {
+    const char* cursor = first;
+    long basePrice = 0;
+    if (cursor == last || *cursor < '0' || *cursor > '9') return false;
+    while (cursor != last && *cursor >= '0' && *cursor <= '9') {
+        basePrice = basePrice * 10 + (*cursor - '0');
+        ++cursor;
     }
 
-    double basePrice = std::stod(fractional.substr(0, dashPos));
-    int xy = std::stoi(fractional.substr(dashPos + 1, 2));
-    char zChar = fractional[dashPos + 3];
-    int z = (zChar == '+') ? 4 : zChar - '0';
+    // Need exactly '-', two digits and the sub-tick character
+    if (last - cursor < 4 || cursor[0] != '-') return false;
+    unsigned tens = static_cast<unsigned>(cursor[1] - '0');
+    unsigned units = static_cast<unsigned>(cursor[2] - '0');
+    if (tens > 3 || units > 9) return false;
+    unsigned xy = tens * 10 + units;
+    if (xy > 31) return false;
 
-    if (xy < 0 || xy > 31 || z < 0 || z > 7) {
-        throw std::invalid_argument("Invalid fractional components");
+    char zChar = cursor[3];
+    unsigned z = (zChar == '+') ? 4u : static_cast<unsigned>(zChar - '0');
+    if (z > 7) return false;
+
+    ticks = basePrice * TICKS_PER_POINT + static_cast<long>(xy) * TICKS_PER_32ND + z;
+    return true;
+}
+
+/**
+ * Converts a fractional price string (e.g., "99-16+") into 1/256 ticks.
+ * Throws std::invalid_argument on malformed input.
+ */
+long string2ticks(std::string_view fractional) {
+    long ticks = 0;
+    if (!ParsePriceTicks(fractional.data(), fractional.data() + fractional.size(), ticks)) {
+        throw std::invalid_argument("Invalid fractional notation");
+    }
+    return ticks;
+}
+
+/**
+ * Formats a tick count as "base-XYz" into a caller-supplied buffer of at
+ * least PRICE_BUFFER_SIZE chars. Returns the number of chars written; the
+ * output is not null-terminated.
+ */
+size_t FormatPriceTicks(long ticks, char* out) {
+    char* cursor = out;
+    unsigned long magnitude = static_cast<unsigned long>(ticks);
+    if (ticks < 0) {
+        *cursor++ = '-';
+        magnitude = 0 - magnitude;
     }
 
-    return basePrice + (xy / 32.0) + (z / 256.0);
+    // Base digits are produced back to front
+    unsigned long basePrice = magnitude / TICKS_PER_POINT;
+    char digits[20];
+    int digitCount = 0;
+    do {
+        digits[digitCount++] = static_cast<char>('0' + basePrice % 10);
+        basePrice /= 10;
+    } while (basePrice != 0);
+    while (digitCount > 0) *cursor++ = digits[--digitCount];
+
+    unsigned long remainder = magnitude % TICKS_PER_POINT;
+    const char* xy = FRACTION_32ND_DIGITS[remainder / TICKS_PER_32ND];
+    *cursor++ = '-';
+    *cursor++ = xy[0];
+    *cursor++ = xy[1];
+    *cursor++ = FRACTION_256TH_CHARS[remainder % TICKS_PER_32ND];
+    return static_cast<size_t>(cursor - out);
+}
+
+// Convert between a decimal price and 1/256 ticks (truncating partial ticks)
+long price2ticks(double decimal) {
+    return static_cast<long>(decimal * TICKS_PER_POINT);
+}
+
+double ticks2price(long ticks) {
+    return static_cast<double>(ticks) / TICKS_PER_POINT;
+}
+
+/**
+ * Converts a fractional price string (e.g., "99-16+") into a decimal price.
+ * The format is "basePrice-XYz" where:
+ *   - basePrice: integer part
+ *   - XY: two-digit fraction (0..31)
+ *   - z: extra fraction in 256ths (0..7 or '+', which represents 4)
+ */
+double string2price(std::string_view fractional) {
+    return ticks2price(string2ticks(fractional));
 }
 
 /**
@@ -93,33 +206,306 @@ double string2price(const std::string& fractional) {
  *   - z: fraction in 256ths (0..7), with 4 replaced by '+'
  */
 std::string price2string(double decimal) {
-    int basePrice = static_cast<int>(decimal);
-    double fractionalPart = decimal - basePrice;
-    int xy = static_cast<int>(fractionalPart * 32);
-    int z = static_cast<int>((fractionalPart * 256)) % 8;
-    char zChar = (z == 4) ? '+' : '0' + z;
-    return std::to_string(basePrice) + "-" + (xy < 10 ? "0" : "") +
-           std::to_string(xy) + zChar;
+    char buffer[PRICE_BUFFER_SIZE];
+    size_t length = FormatPriceTicks(price2ticks(decimal), buffer);
+    return std::string(buffer, length);
 }
 
+// ============================================================================
+// TICK PRICE TYPE
+// ============================================================================
+
+/**
+ * A price as a whole number of 1/256 ticks, the resolution of every price
+ * in the system. Comparisons and arithmetic are exact integer operations,
+ * and the 32-bit count keeps price-carrying structs small. Converting to
+ * or from double or the fractional notation is always explicit.
+ */
+class Tick256 {
+public:
+    using Rep = int32_t;
+
+    constexpr Tick256() : ticks(0) {}
+    constexpr explicit Tick256(long _ticks) : ticks(static_cast<Rep>(_ticks)) {}
+
+    // From fractional notation, e.g. "99-16+"; throws std::invalid_argument
+    static Tick256 FromString(std::string_view fractional) { return Tick256(string2ticks(fractional)); }
+
+    // From a decimal price, truncating partial ticks as price2ticks does
+    static Tick256 FromDecimal(double decimal) { return Tick256(price2ticks(decimal)); }
+
+    constexpr long Ticks() const { return ticks; }
+    double ToDecimal() const { return ticks2price(ticks); }
+
+    // Fractional notation into a buffer of PRICE_BUFFER_SIZE chars; returns the length
+    size_t Format(char* out) const { return FormatPriceTicks(ticks, out); }
+    std::string ToString() const {
+        char buffer[PRICE_BUFFER_SIZE];
+        return std::string(buffer, Format(buffer));
+    }
+
+    constexpr bool operator==(Tick256 other) const { return ticks == other.ticks; }
+    constexpr bool operator!=(Tick256 other) const { return ticks != other.ticks; }
+    constexpr bool operator<(Tick256 other) const { return ticks < other.ticks; }
+    constexpr bool operator<=(Tick256 other) const { return ticks <= other.ticks; }
+    constexpr bool operator>(Tick256 other) const { return ticks > other.ticks; }
+    constexpr bool operator>=(Tick256 other) const { return ticks >= other.ticks; }
+
+    constexpr Tick256 operator+(Tick256 other) const { return Tick256(ticks + other.ticks); }
+    constexpr Tick256 operator-(Tick256 other) const { return Tick256(ticks - other.ticks); }
+    Tick256& operator+=(Tick256 other) { ticks += other.ticks; return *this; }
+    Tick256& operator-=(Tick256 other) { ticks -= other.ticks; return *this; }
+
+private:
+    Rep ticks;
+};
+
 /**
- * Retrieves a Bond object given an integer maturity.
+ * Constructs the Bond for an integer maturity.
  * Looks up the (CUSIP, date) from bondMap and the coupon rate from bondCoupon,
  * then constructs a Bond. Ticker is "US<Maturity>Y" (e.g., "US2Y").
  */
-Bond GetBond(int maturity) {
+Bond MakeBond(int maturity) {
     string id = bondMap.at(maturity).first;
     string ticker = "US" + to_string(maturity) + "Y";
     return Bond(id, CUSIP, ticker, bondCoupon.at(id), bondMap.at(maturity).second);
 }
 
 /**
- * Retrieves a Bond object given its CUSIP string.
- * Uses bondId to find the integer maturity, then calls GetBond(int).
+ * Every Bond in bondMap, built once on first use (thread-safe static
+ * initialisation) and never modified afterwards, so lookups need no lock.
+ * Messages keep references into it instead of their own Bond copies.
+ */
+struct BondCache {
+    map<int, Bond> byMaturity;
+    map<string_view, const Bond*> byCusip;  // views into the cached Bonds' ids
+
+    BondCache() {
+        for (const auto& entry : bondMap) {
+            const Bond& bond = byMaturity.emplace(entry.first, MakeBond(entry.first)).first->second;
+            byCusip.emplace(bond.GetProductId(), &bond);
+        }
+    }
+
+    static const BondCache& Instance() {
+        static const BondCache cache;
+        return cache;
+    }
+};
+
+/**
+ * Retrieves the cached Bond for an integer maturity.
+ * Throws std::out_of_range for a maturity not in bondMap.
+ */
+const Bond& GetBond(int maturity) {
+    return BondCache::Instance().byMaturity.at(maturity);
+}
+
+/**
+ * Retrieves the cached Bond for a CUSIP string.
+ * Throws std::out_of_range for an unknown CUSIP.
+ */
+const Bond& GetBond(std::string_view _id) {
+    const auto& byCusip = BondCache::Instance().byCusip;
+    auto it = byCusip.find(_id);
+    if (it == byCusip.end()) {
+        throw std::out_of_range("Unknown CUSIP: " + std::string(_id));
+    }
+    return *it->second;
+}
+
+/**
+ * Constructs the IRSwap for an integer term from swapMap: pay fixed
+ * semi-annual 30/360 against 3M LIBOR Act/360, from swapEffectiveDate.
+ */
+IRSwap MakeSwap(int termYears) {
+    date termination(swapEffectiveDate.year() + termYears, swapEffectiveDate.month(), swapEffectiveDate.day());
+    return IRSwap(swapMap.at(termYears), THIRTY_THREE_SIXTY, ACT_THREE_SIXTY, SEMI_ANNUAL, LIBOR, TENOR_3M,
+                  swapEffectiveDate, termination, USD, termYears, STANDARD, OUTRIGHT);
+}
+
+/**
+ * Every IRSwap in swapMap, built once on first use like BondCache.
+ */
+struct SwapCache {
+    map<int, IRSwap> byTerm;
+    map<string_view, const IRSwap*> byId;  // views into the cached swaps' ids
+
+    SwapCache() {
+        for (const auto& entry : swapMap) {
+            const IRSwap& swap = byTerm.emplace(entry.first, MakeSwap(entry.first)).first->second;
+            byId.emplace(swap.GetProductId(), &swap);
+        }
+    }
+
+    static const SwapCache& Instance() {
+        static const SwapCache cache;
+        return cache;
+    }
+};
+
+/**
+ * Retrieves the cached IRSwap for an integer term.
+ * Throws std::out_of_range for a term not in swapMap.
+ */
+const IRSwap& GetSwap(int termYears) {
+    return SwapCache::Instance().byTerm.at(termYears);
+}
+
+/**
+ * Retrieves the cached IRSwap for a swap identifier.
+ * Throws std::out_of_range for an unknown identifier.
+ */
+const IRSwap& GetSwap(std::string_view _id) {
+    const auto& byId = SwapCache::Instance().byId;
+    auto it = byId.find(_id);
+    if (it == byId.end()) {
+        throw std::out_of_range("Unknown swap: " + std::string(_id));
+    }
+    return *it->second;
+}
+
+// ============================================================================
+// FIXED-CAPACITY STRING
+// ============================================================================
+
+/**
+ * An inline, trivially copyable string of at most N chars, padded with '\0'.
+ * Used for identifiers inside fixed-width records and message types, so
+ * copying a message never allocates. A default-constructed one is empty,
+ * all '\0', so default messages compare and hash deterministically.
+ */
+template <size_t N>
+struct FixedString {
+    char chars[N] = {};
+
+    FixedString() = default;
+    FixedString(std::string_view text) { Assign(text); }
+
+    // Whether text fits; parsers check this, so malformed input is
+    // rejected at the boundary instead of throwing from Assign
+    static bool Fits(std::string_view text) { return text.size() <= N; }
+
+    // Copy text in, throwing std::length_error if it does not fit
+    void Assign(std::string_view text) {
+        if (text.size() > N) {
+            throw std::length_error("FixedString capacity exceeded: " + std::string(text));
+        }
+        std::memset(chars, 0, N);
+        std::memcpy(chars, text.data(), text.size());
+    }
+
+    std::string_view View() const {
+        size_t length = 0;
+        while (length < N && chars[length] != '\0') ++length;
+        return std::string_view(chars, length);
+    }
+
+    // The padding is always '\0', so whole-buffer compares order by text
+    bool operator==(const FixedString& other) const { return std::memcmp(chars, other.chars, N) == 0; }
+    bool operator!=(const FixedString& other) const { return !(*this == other); }
+    bool operator<(const FixedString& other) const { return std::memcmp(chars, other.chars, N) < 0; }
+};
+
+template <size_t N>
+std::ostream& operator<<(std::ostream& out, const FixedString<N>& text) {
+    return out << text.View();
+}
+
+// Order, trade and parent order identifiers carried by message types
+using OrderId = FixedString<24>;
+
+// Trading book names such as "TRSY1"
+using BookName = FixedString<8>;
+
+/**
+ * Formats prefix followed by a decimal number, e.g. "AlgoExec" + 42, into a
+ * FixedString without going through std::string. The prefix is cut short
+ * if need be so the whole number always fits.
+ */
+template <size_t N>
+FixedString<N> MakeNumberedId(std::string_view prefix, long number) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    size_t digitCount = std::min(static_cast<size_t>(result.ptr - digits), N);
+    size_t length = std::min(prefix.size(), N - digitCount);
+
+    char buffer[N];
+    std::memcpy(buffer, prefix.data(), length);
+    std::memcpy(buffer + length, digits, digitCount);
+    return FixedString<N>(std::string_view(buffer, length + digitCount));
+}
+
+// ============================================================================
+// LINE TOKENIZER
+// ============================================================================
+
+// Maximum number of delimited fields kept per input record
+constexpr size_t MAX_LINE_FIELDS = 8;
+
+/**
+ * Fields of one delimited record, as views into the line they were split from.
+ * The views are only valid while the underlying line buffer is unchanged.
+ */
+struct LineFields {
+    std::string_view fields[MAX_LINE_FIELDS];
+    size_t count = 0;
+
+    size_t size() const { return count; }
+    std::string_view operator[](size_t i) const { return fields[i]; }
+};
+
+/**
+ * Splits a line on the delimiter into string_view fields without allocating.
+ * Fields past MAX_LINE_FIELDS are ignored. Returns the number of fields found.
+ */
+size_t SplitFields(std::string_view line, LineFields& out, char delim = ',') {
+    out.count = 0;
+    size_t start = 0;
+    while (out.count < MAX_LINE_FIELDS) {
+        size_t end = line.find(delim, start);
+        if (end == std::string_view::npos) {
+            out.fields[out.count++] = line.substr(start);
+            break;
+        }
+        out.fields[out.count++] = line.substr(start, end - start);
+        start = end + 1;
+    }
+    return out.count;
+}
+
+/**
+ * Parses a base-10 integer field, throwing on malformed input like stol does.
  */
-Bond GetBond(string _id) {
-    int _mat = bondId.at(_id);
-    return GetBond(_mat);
+long ParseLong(std::string_view field) {
+    long value = 0;
+    auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (result.ec != std::errc()) {
+        throw std::invalid_argument("Invalid integer field: " + std::string(field));
+    }
+    return value;
 }
 
+/**
+ * Reads lines from an input stream into one reusable buffer, so that once the
+ * buffer has grown to the longest line no further allocation takes place.
+ * Trailing carriage returns are stripped.
+ */
+class LineReader {
+public:
+    explicit LineReader(std::istream& _input) : input(_input) { buffer.reserve(256); }
+
+    // Advance to the next line; the view stays valid until the next call
+    bool NextLine(std::string_view& line) {
+        if (!std::getline(input, buffer)) return false;
+        line = buffer;
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        return true;
+    }
+
+private:
+    std::istream& input;
+    std::string buffer;
+};
+
 #endif /* UTILITY_HPP */